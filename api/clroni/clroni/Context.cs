@@ -444,6 +444,41 @@ namespace oni
             return new Frame(data);
         }
 
+        /// <summary>
+        /// Read up to <paramref name="maxCount"/> device data frames from the
+        /// high-bandwidth data input channel in a single call. This call blocks
+        /// in the same way as <see cref="ReadFrame"/> until at least one frame is
+        /// available and then returns the frames that are already buffered.
+        /// The returned frames share a single native allocation that is freed
+        /// once all of them have been disposed. This function is zero-copy.
+        /// </summary>
+        /// <param name="maxCount">The maximum number of frames to read.</param>
+        /// <returns>An array containing between 1 and <paramref name="maxCount"/>
+        /// device data frames.</returns>
+        /// <exception cref="ONIException"> Thrown if there is an error reading
+        /// frames.</exception>
+        public Frame[] ReadFrames(int maxCount)
+        {
+            if (maxCount <= 0) { throw new ArgumentOutOfRangeException(nameof(maxCount)); }
+
+            var handles = new IntPtr[maxCount];
+            int rc = NativeMethods.oni_read_frames(ctx, handles, (UIntPtr)maxCount);
+            if (rc < 0) { throw new ONIException(rc); }
+
+            // Each frame holds a reference to the batch. The batch's own
+            // reference is released when it is disposed here.
+            using (var batch = new FrameBatch(handles[0]))
+            {
+                var frames = new Frame[rc];
+                for (int i = 0; i < rc; i++)
+                {
+                    frames[i] = new Frame(handles[i], batch);
+                }
+
+                return frames;
+            }
+        }
+
         /// <summary>
         /// Write a single value to a particular device within the
         /// <see cref="Context.DeviceTable"/> using the high-bandwidth
@@ -29,6 +29,9 @@ namespace oni
             public readonly byte* data; // Multi-device raw data block
         }
 
+        // Non-null when this frame is part of a batch produced by Context.ReadFrames
+        readonly FrameBatch batch;
+
         internal Frame(IntPtr handle)
         : base(true)
         {
@@ -36,6 +39,16 @@ namespace oni
             GC.AddMemoryPressure(((frame_t*)handle.ToPointer())->data_sz);
         }
 
+        internal Frame(IntPtr handle, FrameBatch batch)
+        : base(true)
+        {
+            bool success = false;
+            batch.DangerousAddRef(ref success);
+            this.batch = batch;
+            SetHandle(handle);
+            GC.AddMemoryPressure(((frame_t*)handle.ToPointer())->data_sz);
+        }
+
         /// <summary>
         /// Executes the code required to free native resources held by the <see cref="Frame"/>.
         /// </summary>
@@ -49,7 +62,10 @@ namespace oni
 #endif
         {
             GC.RemoveMemoryPressure(((frame_t*)handle.ToPointer())->data_sz);
-            NativeMethods.oni_destroy_frame(handle);
+            if (batch != null)
+                batch.DangerousRelease();
+            else
+                NativeMethods.oni_destroy_frame(handle);
             return true;
         }
 
@@ -0,0 +1,39 @@
+﻿using Microsoft.Win32.SafeHandles;
+using System;
+using System.Runtime.ConstrainedExecution;
+using System.Security.Permissions;
+
+
+namespace oni
+{
+    /// <summary>
+    /// Owns the native allocation shared by the frames returned from a single
+    /// call to <see cref="Context.ReadFrames"/>. Each <see cref="Frame"/> in the
+    /// batch holds a reference to this handle.
+    /// </summary>
+#if NET7_0_OR_GREATER
+    internal class FrameBatch : SafeHandleZeroOrMinusOneIsInvalid
+#else
+    [SecurityPermission(SecurityAction.InheritanceDemand, UnmanagedCode = true)]
+    [SecurityPermission(SecurityAction.Demand, UnmanagedCode = true)]
+    internal class FrameBatch : SafeHandleZeroOrMinusOneIsInvalid
+#endif
+    {
+        internal FrameBatch(IntPtr firstFrame)
+        : base(true)
+        {
+            SetHandle(firstFrame);
+        }
+
+#if NET7_0_OR_GREATER
+        protected override bool ReleaseHandle()
+#else
+        [ReliabilityContract(Consistency.WillNotCorruptState, Cer.Success)]
+        protected override bool ReleaseHandle()
+#endif
+        {
+            NativeMethods.oni_destroy_frames(ref handle);
+            return true;
+        }
+    }
+}
@@ -64,6 +64,9 @@ namespace oni
         [DllImport(LibraryName, CallingConvention = CCCdecl, SetLastError = true)]
         internal static extern int oni_read_frame(ContextHandle ctx, out IntPtr frame);
 
+        [DllImport(LibraryName, CallingConvention = CCCdecl, SetLastError = true)]
+        internal static extern int oni_read_frames(ContextHandle ctx, [Out] IntPtr[] frames, UIntPtr max_n);
+
         //[DllImport(LibraryName, CallingConvention = CCCdecl, SetLastError = true)]
         //internal static extern int oni_create_frame(ContextHandle ctx, out Frame frame, uint dev_idx, IntPtr data, uint data_sz);
 
@@ -80,6 +83,10 @@ namespace oni
         [ReliabilityContract(Consistency.WillNotCorruptState, Cer.Success)]
         internal static extern void oni_destroy_frame(IntPtr frame);
 
+        [DllImport(LibraryName, CallingConvention = CCCdecl)]
+        [ReliabilityContract(Consistency.WillNotCorruptState, Cer.Success)]
+        internal static extern void oni_destroy_frames(ref IntPtr frames);
+
         [DllImport(LibraryName, CallingConvention = CCCdecl)]
         internal static extern IntPtr oni_error_str(int err);
     }
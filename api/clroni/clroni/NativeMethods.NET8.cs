@@ -71,6 +71,10 @@ namespace oni
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         internal static partial int oni_read_frame(ContextHandle ctx, out IntPtr frame);
 
+        [LibraryImport(LibraryName, SetLastError = true)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        internal static partial int oni_read_frames(ContextHandle ctx, [Out] IntPtr[] frames, nuint max_n);
+
         //[DllImport(LibraryName, CallingConvention = CCCdecl, SetLastError = true)]
         //internal static extern int oni_create_frame(ContextHandle ctx, out Frame frame, uint dev_idx, IntPtr data, uint data_sz);
 
@@ -89,6 +93,10 @@ namespace oni
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         internal static partial void oni_destroy_frame(IntPtr frame);
 
+        [LibraryImport(LibraryName)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        internal static partial void oni_destroy_frames(ref IntPtr frames);
+
         [LibraryImport(LibraryName)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         internal static partial IntPtr oni_error_str(int err);
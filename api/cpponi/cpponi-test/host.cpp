@@ -227,6 +227,7 @@ int main(int argc, char *argv[])
                     std::cout << "Paused\n";
             } else if (cmd == "x") {
                 ctx->set_opt(ONI_OPT_RESET, 1);
+                ctx->refresh_device_map();
             } else if (cmd == "d") {
                 display = (display == 0) ? 1 : 0;
             } else if (cmd == "r") {
@@ -97,6 +97,14 @@ namespace oni {
             // Nothing
         }
 
+        // NB: Used for frames that share a batch allocation (see
+        // context_t::read_frames)
+        inline frame_t(std::shared_ptr<const oni_frame_t> frame)
+        : frame_ptr_{std::move(frame)}
+        {
+            // Nothing
+        }
+
     public:
         uint64_t time() const { return frame_ptr_->time; }
         oni_dev_idx_t device_index() const { return frame_ptr_->dev_idx; }
@@ -139,19 +147,7 @@ namespace oni {
             auto rc = oni_init_ctx(ctx_, host_idx);
             if (rc != 0) throw error_t(rc);
 
-            // Populate device map
-            auto num_devs = get_opt<oni_size_t>(ONI_OPT_NUMDEVICES);
-
-            size_t devices_sz = sizeof(oni_device_t) * num_devs;
-            device_map_.reserve(num_devs);
-
-            std::vector<device_t> devs;
-            devs.resize(num_devs);
-            get_opt_(ONI_OPT_DEVICETABLE, devs.data(), &devices_sz);
-
-            // Convert to unordered_map
-            for (const auto &d : devs)
-                device_map_.insert({d.idx, d});
+            refresh_device_map();
         }
 
         // No copies
@@ -228,8 +224,37 @@ namespace oni {
             if (rc != 0) throw error_t(rc);
         }
 
+        // Device table keyed by device index, as of construction or the last
+        // call to refresh_device_map
         inline device_map_t device_map() const noexcept { return device_map_; }
 
+        // Reloads the device map from the context's device table, e.g. after
+        // a reset (ONI_OPT_RESET)
+        inline void refresh_device_map()
+        {
+            auto num_devs = get_opt<oni_size_t>(ONI_OPT_NUMDEVICES);
+
+            size_t devices_sz = sizeof(oni_device_t) * num_devs;
+            std::vector<device_t> devs;
+            devs.resize(num_devs);
+            get_opt_(ONI_OPT_DEVICETABLE, devs.data(), &devices_sz);
+
+            // Convert to unordered_map
+            device_map_t device_map;
+            device_map.reserve(num_devs);
+            for (const auto &d : devs)
+                device_map.insert({d.idx, d});
+
+            device_map_ = std::move(device_map);
+        }
+
+        // Device lookup without a copy. Returns nullptr if there is no device
+        // with index dev_idx. The device is valid until the next reset.
+        inline const device_t *get_device(oni_dev_idx_t dev_idx) const noexcept
+        {
+            return oni_get_device(ctx_, dev_idx);
+        }
+
         inline frame_t read_frame() const
         {
             oni_frame_t *fp;
@@ -240,6 +265,26 @@ namespace oni {
             return frame_t(fp);
         }
 
+        // Read up to max_n frames that are already buffered in a single call.
+        // The frames share one allocation that is freed when the last of them
+        // is destroyed.
+        inline std::vector<frame_t> read_frames(size_t max_n) const
+        {
+            std::vector<oni_frame_t *> fps(max_n);
+            auto rc = oni_read_frames(ctx_, fps.data(), max_n);
+            if (rc < 0) throw error_t(rc);
+
+            std::shared_ptr<oni_frame_t> batch{
+                fps[0], [](oni_frame_t *fp) { oni_destroy_frames(&fp); }};
+
+            std::vector<frame_t> frames;
+            frames.reserve(rc);
+            for (int i = 0; i < rc; i++)
+                frames.push_back(frame_t(std::shared_ptr<const oni_frame_t>(batch, fps[i])));
+
+            return frames;
+        }
+
 #ifdef CPPONI_USE_SPAN
         template <typename data_t>
         inline void write(size_t dev_idx, std::span<const data_t> data) const
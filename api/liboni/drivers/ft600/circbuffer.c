@@ -22,11 +22,14 @@ int circBufferCanWrite(circ_buffer_t* buffer, size_t size)
 	return (rem > size) ? 1 : 0;
 }
 int circBufferCanRead(circ_buffer_t* buffer, size_t size)
+{
+	return (circBufferReadable(buffer) >= size) ? 1 : 0;
+}
+size_t circBufferReadable(circ_buffer_t* buffer)
 {
 	size_t wpointer = buffer->write;
 	size_t rpointer = buffer->read;
-	size_t num = (wpointer >= rpointer) ? wpointer - rpointer : buffer->size - (rpointer - wpointer);
-	return (num >= size) ? 1 : 0;
+	return (wpointer >= rpointer) ? wpointer - rpointer : buffer->size - (rpointer - wpointer);
 }
 //These do not check. Check before calling them
 void circBufferWrite(circ_buffer_t* buffer, uint8_t* src, size_t size)
@@ -16,6 +16,7 @@ int circBufferInit(circ_buffer_t* buffer);
 void circBufferRelease(circ_buffer_t* buffer);
 int circBufferCanWrite(circ_buffer_t* buffer, size_t size);
 int circBufferCanRead(circ_buffer_t* buffer, size_t size);
+size_t circBufferReadable(circ_buffer_t* buffer);
 
 //These do not check. Check before calling them
 void circBufferWrite(circ_buffer_t* buffer, uint8_t* src, size_t size);
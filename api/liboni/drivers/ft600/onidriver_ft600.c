@@ -170,6 +170,8 @@ enum ft600_pipeid
 };
 #endif
 
+// The control reader yields while a consumer frees space in the signal and
+// register buffers
 static void fill_control_buffers(oni_ft600_ctx ctx, ULONG transferred)
 {
 	size_t index = 0;
@@ -189,14 +191,16 @@ static void fill_control_buffers(oni_ft600_ctx ctx, ULONG transferred)
 			lastIndex = index;
 			while (index < transferred && ctx->auxBuffer[index] != 0) { index++; }
 			if (index >= transferred) index--;
-			while (!circBufferCanWrite(&ctx->signalBuffer, index - lastIndex + 1));
+			while (!circBufferCanWrite(&ctx->signalBuffer, index - lastIndex + 1))
+				Sleep(1);
 			circBufferWrite(&ctx->signalBuffer, ctx->auxBuffer + lastIndex, index - lastIndex + 1);
 			if (index < transferred && ctx->auxBuffer[index] == 0) ctx->sigState = SIG_CMD;
 			index++;
 			break;
 		case SIG_REG:
 			toWrite = MIN(sizeof(oni_reg_val_t), transferred - index);
-			while (!circBufferCanWrite(&ctx->regBuffer, toWrite));
+			while (!circBufferCanWrite(&ctx->regBuffer, toWrite))
+				Sleep(1);
 			circBufferWrite(&ctx->regBuffer, ctx->auxBuffer + index, toWrite);
 			ctx->sigOffset = (ctx->sigOffset + toWrite) % sizeof(oni_reg_val_t);
 			index += toWrite;
@@ -288,6 +292,26 @@ static void oni_ft600_update_control(oni_ft600_ctx ctx)
 }
 #endif
 
+// Wait until size bytes can be read from a control buffer. Sleep between
+// polls so that a caller waiting on the control pipe does not hold a core.
+static int oni_ft600_wait_control(oni_ft600_ctx ctx, circ_buffer_t *buffer, size_t size)
+{
+	while (!circBufferCanRead(buffer, size))
+	{
+#ifdef POLL_CONTROL
+		oni_ft600_update_control(ctx);
+#endif
+		if (ctx->sigError)
+		{
+			ctx->sigError = 0;
+			return ONI_ESEEKFAILURE;
+		}
+		if (!circBufferCanRead(buffer, size))
+			Sleep(1);
+	}
+	return ONI_ESUCCESS;
+}
+
 static inline oni_conf_off_t _oni_register_offset(oni_config_t reg);
 
 static inline void oni_ft600_restart_acq(oni_ft600_ctx ctx)
@@ -589,24 +613,17 @@ int oni_driver_read_stream(oni_driver_ctx driver_ctx,
 	CTX_CAST;
 	if (stream == ONI_READ_STREAM_SIGNAL)
 	{
-		while (!circBufferCanRead(&ctx->signalBuffer, size))
-		{
-#ifdef POLL_CONTROL
-			oni_ft600_update_control(ctx);
-#endif
-			if (ctx->sigError)
-			{
-				ctx->sigError = 0;
-				return ONI_ESEEKFAILURE;
-			}
-		}
+		int res = oni_ft600_wait_control(ctx, &ctx->signalBuffer, size);
+		if (res != ONI_ESUCCESS) return res;
 		circBufferRead(&ctx->signalBuffer, data, size);
 		return size;
 	}
 	else if (stream == ONI_READ_STREAM_DATA)
 	{
+        // Acquisition is started from another thread. Yield rather than spin
+        // so that a waiting reader does not hold a core.
         while (ctx->state != STATE_RUNNING)
-            ;
+            Sleep(1);
 		size_t remaining = ((size >> 2) << 2);//round to 32bit boundaries;
 		FT_STATUS ftStatus;
 		int read = 0;
@@ -690,6 +707,23 @@ int oni_driver_read_stream(oni_driver_ctx driver_ctx,
 	else return ONI_EPATHINVALID;
 }
 
+int oni_driver_stream_readable(oni_driver_ctx driver_ctx, oni_read_stream_t stream)
+{
+	CTX_CAST;
+	if (stream == ONI_READ_STREAM_SIGNAL)
+	{
+#ifdef POLL_CONTROL
+		oni_ft600_update_control(ctx);
+#endif
+		return (int)circBufferReadable(&ctx->signalBuffer);
+	}
+	else if (stream == ONI_READ_STREAM_DATA)
+	{
+		return ONI_EUNIMPL;
+	}
+	else return ONI_EPATHINVALID;
+}
+
 int oni_driver_write_stream(oni_driver_ctx driver_ctx,
 	oni_write_stream_t stream,
 	const char* data,
@@ -807,17 +841,8 @@ int oni_driver_read_config(oni_driver_ctx driver_ctx, oni_config_t reg, oni_reg_
 	int res = oni_ft600_sendcmd(ctx, buffer, 5);
 	if (res != ONI_ESUCCESS) return res;
 
-	while (!circBufferCanRead(&ctx->regBuffer, sizeof(oni_reg_val_t)))
-	{
-#ifdef POLL_CONTROL
-		oni_ft600_update_control(ctx);
-#endif
-		if (ctx->sigError)
-		{
-			ctx->sigError = 0;
-			return ONI_ESEEKFAILURE;
-		}
-	}
+	res = oni_ft600_wait_control(ctx, &ctx->regBuffer, sizeof(oni_reg_val_t));
+	if (res != ONI_ESUCCESS) return res;
 	circBufferRead(&ctx->regBuffer, (uint8_t*)value, sizeof(oni_reg_val_t));
 	return ONI_ESUCCESS;
 }
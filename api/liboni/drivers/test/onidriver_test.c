@@ -3,7 +3,8 @@
 //
 // 1. ONI_OPT_RUNNING does not enable/disable data. To make it work, data would need to be
 //    produced on a separate thread and passed through a blocking FIFO
-// 2. Writing data to the device does nothing (data is just ignored)
+// 2. Writing data to the device does nothing (data is just ignored) unless
+//    loopback is enabled
 
 #include <assert.h>
 #include <errno.h>
@@ -14,6 +15,7 @@
 
 #include "../../onidefs.h"
 #include "../../oni.h"
+#include "../../onicobs.h"
 #include "../../onidriver.h"
 #include "../../onix.h"
 #include "../../test/testfunc.h"
@@ -21,7 +23,21 @@
 
 #define NUMTESTDEVICESPERHUB 4
 #define NUMTESTHUBS 4
-#define NUMTESTDEVICES (NUMTESTDEVICESPERHUB * NUMTESTHUBS)
+#define MAXTESTHUBS 64
+#define MAXTESTDEVICES (NUMTESTDEVICESPERHUB * MAXTESTHUBS)
+
+// Driver options
+#define TESTOPT_NUMHUBS 0 // Number of hubs, 1 to MAXTESTHUBS, applied on the next reset (int)
+#define TESTOPT_EVENT 1 // Raise a hardware event at the current acquisition time (oni_event_t, write-only)
+#define TESTOPT_LASTWRITETIME 2 // Acquisition time at which data was last written (uint64_t, read-only)
+#define TESTOPT_LOOPBACK 3 // Non-zero to read back written frames from the device they were written to (int)
+
+// Written frames waiting to be read back, and the largest read frame data
+#define LOOPBACKDEPTH 64
+#define MAXREADSIZE (8 + 2 + 2 * (2 * MAXTESTHUBS - 1))
+
+// Signal queue holds a full device table
+#define SIGQUEUESIZE (MAXTESTDEVICES * 32)
 
 #define UNUSED(x) (void)(x)
 
@@ -57,6 +73,12 @@ typedef struct {
     uint32_t hubdelayns;
 } test_dev_t;
 
+// Written frame waiting to be read back
+typedef struct {
+    int dev; // Device table position
+    uint8_t data[MAXREADSIZE];
+} loopback_frame_t;
+
 struct oni_test_ctx_impl {
 
     // Block read size during buffer update in liboni
@@ -70,8 +92,19 @@ struct oni_test_ctx_impl {
     // Counters
     uint64_t frame_num;
 
-    // Signal queue
+    // Acquisition time of the last data stream write
+    uint64_t last_write_time;
+
+    // Loopback (TESTOPT_LOOPBACK). Written frames are queued in [loop_head,
+    // loop_tail) and take the place of the next generated frames.
+    int loopback;
+    size_t loop_head;
+    size_t loop_tail;
+    loopback_frame_t loop_queue[LOOPBACKDEPTH];
+
+    // Signal queue and packet encoder, selected for the host CPU
     queue_u8_t *sig_queue;
+    oni_cobs_fn_t cobs_encode;
 
     // Internal read stream buffer
     size_t max_frame_size; // Max single frame size including header
@@ -81,13 +114,15 @@ struct oni_test_ctx_impl {
     // Configuration registers
     struct conf_reg conf;
 
-    // Device table is a single device
+    // Device table, NUMTESTDEVICESPERHUB devices on each hub. The number of
+    // hubs set through TESTOPT_NUMHUBS takes effect on the next reset.
+    int num_hubs;
     int num_devs;
-    test_dev_t dev_table[NUMTESTDEVICES];
+    test_dev_t dev_table[MAXTESTDEVICES];
 
     // Enabled devices
     int num_enabled;
-    int enabled_idx[NUMTESTDEVICES];
+    int enabled_idx[MAXTESTDEVICES];
 };
 
 typedef struct oni_test_ctx_impl* oni_test_ctx;
@@ -100,6 +135,7 @@ typedef enum oni_signal {
     CONFIGRNACK         = (1u << 4), // Configuration no-read-acknowledgment
     DEVICEMAPACK        = (1u << 5), // Device map start acknowledgment
     DEVICEINST          = (1u << 6), // Device map instance
+    EVENT               = (1u << 7), // Asynchronous hardware event
 } oni_signal_t;
 
 static void _fill_read_buffer(oni_test_ctx ctx,
@@ -111,6 +147,7 @@ static int _send_data_signal(oni_test_ctx ctx,
                              void *data,
                              size_t n);
 static int _find_dev(oni_test_ctx ctx, oni_dev_idx_t idx);
+static void _create_devices(oni_test_ctx ctx, int num_hubs);
 static int _find_hub_mgr(oni_dev_idx_t idx);
 
 // TODO:
@@ -135,40 +172,8 @@ oni_driver_ctx oni_driver_create_ctx()
     ctx->frame_num = 0;
 
     // Create devices, with an equal number of devices per hub
-    ctx->num_devs = NUMTESTDEVICES;
-
-    // All devices default to enabled
-    ctx->num_enabled = ctx->num_devs;
-
-    // Start at zero and update in the loop below
-    ctx->max_frame_size = 0;
-
-    for (int i = 0; i < ctx->num_devs / NUMTESTDEVICESPERHUB; i++) {
-        for (int j = 0; j < NUMTESTDEVICESPERHUB; j++) {
-            int k = i * NUMTESTDEVICESPERHUB + j;
-
-            ctx->dev_table[k].dev.idx = (i << 8) + j; // All dev_idx 0 to n on different hubs
-            ctx->dev_table[k].dev.id = ONIX_TEST0;
-            ctx->dev_table[k].dev.version = 2;
-            ctx->dev_table[k].dev.read_size = 8 + 2 + 2 * (2 * i + 1); // [8: hub counter, 2: message word, 2 * (i + 1): dummy counter words]
-            ctx->dev_table[k].dev.write_size = 32;
-            ctx->dev_table[k].stream_enabled = 1;
-            ctx->dev_table[k].message = (uint16_t)(i * 42);
-            ctx->dev_table[k].dummy_words = 2 * i + 1; // This needs to be odd to enfornce 32-bit boundaries on frame data
-            ctx->dev_table[k].counter = 0;
-            ctx->dev_table[k].hubhwid = 5;
-            ctx->dev_table[k].hubfirmver = 1600;
-            ctx->dev_table[k].hubclkhz = (i + 1) * 50e6;
-            ctx->dev_table[k].hubdelayns = 628;
-
-            ctx->enabled_idx[k] = k;
-
-            ctx->max_frame_size
-                = ctx->max_frame_size < ctx->dev_table[k].dev.read_size ?
-                      ctx->dev_table[k].dev.read_size :
-                      ctx->max_frame_size;
-        }
-    }
+    ctx->num_hubs = NUMTESTHUBS;
+    _create_devices(ctx, ctx->num_hubs);
 
     // Configuration registers
     ctx->conf.dev_idx = 0;
@@ -181,10 +186,10 @@ oni_driver_ctx oni_driver_create_ctx()
     ctx->conf.hwaddress = 0;
 
     // Signal queue
-    ctx->sig_queue = queue_u8_create(1024);
+    ctx->sig_queue = queue_u8_create(SIGQUEUESIZE);
+    ctx->cobs_encode = oni_cobs_best_encoder();
 
     // Buffer for creating frames
-    ctx->max_frame_size += ONI_RFRAMEHEADERSZ;
     ctx->buff_pos = 0;
     ctx->read_buff = malloc(ctx->block_read_size + ctx->max_frame_size);
 
@@ -237,7 +242,7 @@ static int _send_data_signal(oni_test_ctx ctx,
         memcpy(src + sizeof(type), data, n);
 
     // Create COBs packet with overhead byte
-    cobs_stuff(dst, src, packet_size);
+    ctx->cobs_encode(dst, src, packet_size);
 
     // COBS data, 1 overhead byte + 0x0 delimiter
     size_t i;
@@ -281,19 +286,60 @@ int oni_driver_read_stream(oni_driver_ctx driver_ctx,
     else return ONI_EPATHINVALID;
 }
 
+int oni_driver_stream_readable(oni_driver_ctx driver_ctx,
+                               oni_read_stream_t stream)
+{
+    CTX_CAST;
+
+    if (stream == ONI_READ_STREAM_SIGNAL)
+        return (int)ctx->sig_queue->size;
+    else if (stream == ONI_READ_STREAM_DATA)
+        return ONI_EUNIMPL; // Frames are generated on demand
+    else return ONI_EPATHINVALID;
+}
+
 // Accept frame data and side effect frames in some way
 int oni_driver_write_stream(oni_driver_ctx driver_ctx,
                             oni_write_stream_t stream,
                             const char *data,
                             size_t size)
 {
-    UNUSED(driver_ctx);
+    CTX_CAST;
     size_t remaining = size >> 2; // bytes to 32 bit words
     size_t to_send, sent;
     uint32_t *ptr = (uint32_t *)data;
 
     if (stream != ONI_WRITE_STREAM_DATA) return ONI_EPATHINVALID;
 
+    // NB: When data arrived is recorded
+    ctx->last_write_time = ctx->frame_num;
+
+    // Queue frames [dev_idx, data_sz (32 bit words), data] to be read back.
+    // The first read_size bytes of the data are returned, zero padded. Frames
+    // that do not fit in the queue are lost.
+    if (ctx->loopback) {
+        size_t pos = 0;
+        while (pos + 8 <= size) {
+            uint32_t dev_idx, data_sz;
+            memcpy(&dev_idx, data + pos, 4);
+            memcpy(&data_sz, data + pos + 4, 4);
+            data_sz <<= 2;
+            if (pos + 8 + data_sz > size)
+                break;
+
+            int d = _find_dev(ctx, dev_idx);
+            if (d >= 0 && ctx->loop_tail - ctx->loop_head < LOOPBACKDEPTH) {
+                loopback_frame_t *frame = &ctx->loop_queue[ctx->loop_tail++ % LOOPBACKDEPTH];
+                size_t n = MIN(data_sz, ctx->dev_table[d].dev.read_size);
+                frame->dev = d;
+                memset(frame->data, 0, sizeof(frame->data));
+                memcpy(frame->data, data + pos + 8, n);
+            }
+
+            pos += 8 + data_sz;
+        }
+    }
+
     while (remaining > 0) {
         to_send = MIN(remaining, write_block_size);
         sent = to_send; // TODO: Some side effect instead of nothing
@@ -414,6 +460,22 @@ int oni_driver_write_config(oni_driver_ctx driver_ctx,
 
             if (value == 0) return ONI_ESUCCESS;
 
+            // Apply a new number of hubs. The read buffer must fit the
+            // largest frame of the new devices.
+            if (ctx->num_hubs != ctx->num_devs / NUMTESTDEVICESPERHUB) {
+
+                // NB: Queued frames refer to the old device table
+                ctx->loop_head = ctx->loop_tail = 0;
+                _create_devices(ctx, ctx->num_hubs);
+                char *buff = realloc(ctx->read_buff,
+                                     ctx->block_read_size + ctx->max_frame_size);
+                if (buff == NULL)
+                    return ONI_EBADALLOC;
+
+                ctx->read_buff = buff;
+                ctx->buff_pos = 0;
+            }
+
             // Put the device map onto the signal stream fifo
             _send_data_signal(ctx, DEVICEMAPACK, &ctx->num_devs, sizeof(ctx->num_devs));
 
@@ -442,6 +504,29 @@ int oni_driver_write_config(oni_driver_ctx driver_ctx,
     return ONI_ESUCCESS;
 }
 
+// Perform register writes one after another as if each were triggered in turn
+int oni_driver_config_batch(oni_driver_ctx driver_ctx,
+                            const oni_reg_write_t *writes,
+                            size_t num_writes)
+{
+    size_t i;
+    for (i = 0; i < num_writes; i++) {
+
+        int rc = oni_driver_write_config(driver_ctx, ONI_CONFIG_DEV_IDX, writes[i].dev_idx);
+        if (rc) return rc;
+        rc = oni_driver_write_config(driver_ctx, ONI_CONFIG_REG_ADDR, writes[i].addr);
+        if (rc) return rc;
+        rc = oni_driver_write_config(driver_ctx, ONI_CONFIG_REG_VALUE, writes[i].value);
+        if (rc) return rc;
+        rc = oni_driver_write_config(driver_ctx, ONI_CONFIG_RW, 1);
+        if (rc) return rc;
+        rc = oni_driver_write_config(driver_ctx, ONI_CONFIG_TRIG, 1);
+        if (rc) return rc;
+    }
+
+    return ONI_ESUCCESS;
+}
+
 int oni_driver_read_config(oni_driver_ctx driver_ctx,
                            oni_config_t reg,
                            oni_reg_val_t *value)
@@ -508,17 +593,60 @@ int oni_driver_set_opt_callback(oni_driver_ctx driver_ctx,
     return ONI_ESUCCESS;
 }
 
-// NB: This driver does not have custom options
 int oni_driver_set_opt(oni_driver_ctx driver_ctx,
                        int driver_option,
                        const void *value,
                        size_t option_len)
 {
-    UNUSED(driver_ctx);
-    UNUSED(driver_option);
-    UNUSED(value);
-    UNUSED(option_len);
-    return ONI_EINVALOPT;
+    CTX_CAST;
+
+    switch (driver_option) {
+        case TESTOPT_NUMHUBS: {
+
+            if (option_len != sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            int num_hubs = *(const int *)value;
+            if (num_hubs < 1 || num_hubs > MAXTESTHUBS)
+                return ONI_EINVALARG;
+
+            ctx->num_hubs = num_hubs;
+            break;
+        }
+        case TESTOPT_EVENT: {
+
+            if (option_len != sizeof(oni_event_t))
+                return ONI_EBUFFERSIZE;
+
+            // Payload is [time, dev_idx, code, value]
+            const oni_event_t *event = value;
+            uint8_t payload[sizeof(oni_fifo_time_t) + 3 * sizeof(uint32_t)];
+            memcpy(payload, &ctx->frame_num, sizeof(oni_fifo_time_t));
+            memcpy(payload + 8, &event->dev_idx, sizeof(uint32_t));
+            memcpy(payload + 12, &event->code, sizeof(uint32_t));
+            memcpy(payload + 16, &event->value, sizeof(uint32_t));
+
+            if (_send_data_signal(ctx, EVENT, payload, sizeof(payload)) < 0)
+                return ONI_EWRITEFAILURE;
+
+            break;
+        }
+        case TESTOPT_LASTWRITETIME:
+            return ONI_EREADONLY;
+        case TESTOPT_LOOPBACK: {
+
+            if (option_len != sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            ctx->loopback = *(const int *)value;
+            ctx->loop_head = ctx->loop_tail = 0;
+            break;
+        }
+        default:
+            return ONI_EINVALOPT;
+    }
+
+    return ONI_ESUCCESS;
 }
 
 int oni_driver_get_opt(oni_driver_ctx driver_ctx,
@@ -526,11 +654,43 @@ int oni_driver_get_opt(oni_driver_ctx driver_ctx,
                        void *value,
                        size_t *option_len)
 {
-    UNUSED(driver_ctx);
-    UNUSED(driver_option);
-    UNUSED(value);
-    UNUSED(option_len);
-    return ONI_EINVALOPT;
+    CTX_CAST;
+
+    switch (driver_option) {
+        case TESTOPT_NUMHUBS: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            *(int *)value = ctx->num_hubs;
+            *option_len = sizeof(int);
+            break;
+        }
+        case TESTOPT_LASTWRITETIME: {
+
+            if (*option_len < sizeof(uint64_t))
+                return ONI_EBUFFERSIZE;
+
+            *(uint64_t *)value = ctx->last_write_time;
+            *option_len = sizeof(uint64_t);
+            break;
+        }
+        case TESTOPT_LOOPBACK: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            *(int *)value = ctx->loopback;
+            *option_len = sizeof(int);
+            break;
+        }
+        case TESTOPT_EVENT:
+            return ONI_EWRITEONLY;
+        default:
+            return ONI_EINVALOPT;
+    }
+
+    return ONI_ESUCCESS;
 }
 
 const oni_driver_info_t *oni_driver_info()
@@ -545,13 +705,19 @@ static void _fill_read_buffer(oni_test_ctx ctx, void *data, size_t size)
     // 1. index (4)
     // 2. data_sz (4)
     // 3. timer (8)
-    // 4. Data ([8: counter, 2: message, 2: dummy counter])
-    int d = ctx->enabled_idx[rand() % ctx->num_enabled]; // Select a random device (that is generating data)
-    for (; // static i
-         ctx->buff_pos < size;
-         ctx->buff_pos
-         += (ONI_RFRAMEHEADERSZ + ctx->dev_table[d].dev.read_size),
-         d = ctx->enabled_idx[rand() % ctx->num_enabled]) {
+    // 4. Data ([8: counter, 2: message, 2: dummy counter], or looped back data)
+    while (ctx->buff_pos < size) {
+
+        // Select a random device (that is generating data), unless a written
+        // frame is waiting to be read back
+        const loopback_frame_t *loop = NULL;
+        int d;
+        if (ctx->loop_head != ctx->loop_tail) {
+            loop = &ctx->loop_queue[ctx->loop_head++ % LOOPBACKDEPTH];
+            d = loop->dev;
+        } else {
+            d = ctx->enabled_idx[rand() % ctx->num_enabled];
+        }
 
         // Header
         *((uint64_t *)(ctx->read_buff + ctx->buff_pos)) = ctx->frame_num++;
@@ -559,6 +725,14 @@ static void _fill_read_buffer(oni_test_ctx ctx, void *data, size_t size)
         *((uint32_t *)(ctx->read_buff + ctx->buff_pos + 12))
             = ctx->dev_table[d].dev.read_size;
 
+        if (loop != NULL) {
+            memcpy(ctx->read_buff + ctx->buff_pos + ONI_RFRAMEHEADERSZ,
+                   loop->data,
+                   ctx->dev_table[d].dev.read_size);
+            ctx->buff_pos += ONI_RFRAMEHEADERSZ + ctx->dev_table[d].dev.read_size;
+            continue;
+        }
+
         // Hub counter
         *((uint64_t *)(ctx->read_buff + ctx->buff_pos + 16))
             = ctx->dev_table[d].counter++;
@@ -570,6 +744,8 @@ static void _fill_read_buffer(oni_test_ctx ctx, void *data, size_t size)
         // Dummy Counter
         for (int16_t j = 0, k = 0; j < ctx->dev_table[d].dummy_words; j++, k+=2)
             *((int16_t *)(ctx->read_buff + ctx->buff_pos + 26 + k)) = j;
+
+        ctx->buff_pos += ONI_RFRAMEHEADERSZ + ctx->dev_table[d].dev.read_size;
     }
 
     // Copy buffer and store remainder
@@ -586,7 +762,7 @@ static int _send_msg_signal(oni_test_ctx ctx, oni_signal_t type)
     // COBS data, 1 overhead byte + 0x0 delimiter
     uint8_t dst[sizeof(oni_signal_t) + 2] = {0};
 
-    cobs_stuff(dst, (uint8_t *)&type, sizeof(type));
+    ctx->cobs_encode(dst, (uint8_t *)&type, sizeof(type));
 
     size_t i;
     for (i = 0; i < sizeof(dst); i++)
@@ -596,6 +772,48 @@ static int _send_msg_signal(oni_test_ctx ctx, oni_signal_t type)
     return sizeof(dst);
 }
 
+// Creates NUMTESTDEVICESPERHUB devices on each of num_hubs hubs, all of which
+// are enabled
+static void _create_devices(oni_test_ctx ctx, int num_hubs)
+{
+    ctx->num_devs = num_hubs * NUMTESTDEVICESPERHUB;
+
+    // All devices default to enabled
+    ctx->num_enabled = ctx->num_devs;
+
+    // Start at zero and update in the loop below
+    ctx->max_frame_size = 0;
+
+    for (int i = 0; i < num_hubs; i++) {
+        for (int j = 0; j < NUMTESTDEVICESPERHUB; j++) {
+            int k = i * NUMTESTDEVICESPERHUB + j;
+
+            ctx->dev_table[k].dev.idx = (i << 8) + j; // All dev_idx 0 to n on different hubs
+            ctx->dev_table[k].dev.id = ONIX_TEST0;
+            ctx->dev_table[k].dev.version = 2;
+            ctx->dev_table[k].dev.read_size = 8 + 2 + 2 * (2 * i + 1); // [8: hub counter, 2: message word, 2 * (i + 1): dummy counter words]
+            ctx->dev_table[k].dev.write_size = 32;
+            ctx->dev_table[k].stream_enabled = 1;
+            ctx->dev_table[k].message = (uint16_t)(i * 42);
+            ctx->dev_table[k].dummy_words = 2 * i + 1; // This needs to be odd to enfornce 32-bit boundaries on frame data
+            ctx->dev_table[k].counter = 0;
+            ctx->dev_table[k].hubhwid = 5;
+            ctx->dev_table[k].hubfirmver = 1600;
+            ctx->dev_table[k].hubclkhz = (i + 1) * 50e6;
+            ctx->dev_table[k].hubdelayns = 628;
+
+            ctx->enabled_idx[k] = k;
+
+            ctx->max_frame_size
+                = ctx->max_frame_size < ctx->dev_table[k].dev.read_size ?
+                      ctx->dev_table[k].dev.read_size :
+                      ctx->max_frame_size;
+        }
+    }
+
+    ctx->max_frame_size += ONI_RFRAMEHEADERSZ;
+}
+
 // Simple & slow device lookup
 static int _find_dev(oni_test_ctx ctx, oni_dev_idx_t idx)
 {
@@ -182,6 +182,28 @@ int oni_driver_read_stream(oni_driver_ctx driver_ctx,
     return received;
 }
 
+// Xillybus device files support poll(), so readiness comes straight from the
+// read streams
+int oni_driver_stream_fd(oni_driver_ctx driver_ctx, oni_read_stream_t stream)
+{
+#ifdef _WIN32
+    UNUSED(driver_ctx);
+    UNUSED(stream);
+    return ONI_EUNIMPL;
+#else
+    CTX_CAST;
+
+    switch (stream) {
+        case ONI_READ_STREAM_DATA:
+            return ctx->read.fid;
+        case ONI_READ_STREAM_SIGNAL:
+            return ctx->signal.fid;
+        default:
+            return ONI_EPATHINVALID;
+    }
+#endif
+}
+
 int oni_driver_write_stream(oni_driver_ctx driver_ctx,
                             oni_write_stream_t stream,
                             const char *data,
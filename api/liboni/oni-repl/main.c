@@ -94,9 +94,14 @@ int parse_reg_cmd(const char *cmd, long *values, int len)
 int write_reg_file(FILE *file) {
 
     char buf[1000];
+    oni_reg_op_t *ops = NULL;
+    size_t *lines = NULL; // Line of each op
+    size_t num_ops = 0, capacity = 0, line = 0;
 
     while (fgets(buf, 1000, file) != NULL) {
 
+        line++;
+
         // Parse the command string
         long values[3];
         int rc = parse_reg_cmd(buf, values, 3);
@@ -106,25 +111,61 @@ int write_reg_file(FILE *file) {
             continue;
         }
 
-        size_t dev_idx = (size_t)values[0];
-        oni_size_t addr = (oni_size_t)values[1];
-        oni_size_t val = (oni_size_t)values[2];
+        if (num_ops == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            oni_reg_op_t *temp = realloc(ops, capacity * sizeof(oni_reg_op_t));
+            size_t *temp_lines = temp ? realloc(lines, capacity * sizeof(size_t)) : NULL;
+            if (temp_lines == NULL) {
+                printf("Error: out of memory\n");
+                free(temp ? temp : ops);
+                free(lines);
+                return -1;
+            }
+            ops = temp;
+            lines = temp_lines;
+        }
+
+        lines[num_ops] = line;
 
-        rc = oni_write_reg(ctx, dev_idx, addr, val);
-        if (rc) printf("%s\n", oni_error_str(rc));
+        oni_reg_op_t *op = &ops[num_ops++];
+        memset(op, 0, sizeof(oni_reg_op_t));
+        op->dev_idx = (oni_dev_idx_t)values[0];
+        op->addr = (oni_reg_addr_t)values[1];
+        op->value = (oni_reg_val_t)values[2];
+        op->write = 1;
     }
 
+    // Write all registers at once so the driver can batch them. NB: Ops that
+    // are not written because of an earlier error keep their zeroed status.
+    int rc = oni_write_regs(ctx, ops, num_ops);
+
+    size_t i;
+    for (i = 0; i < num_ops; i++)
+        if (ops[i].status)
+            printf("Error: line %zu: %s\n", lines[i], oni_error_str(ops[i].status));
+
+    if (rc && rc != ONI_EWRITEFAILURE)
+        printf("Error: %s, later lines were not written\n", oni_error_str(rc));
+
+    free(lines);
+    free(ops);
+
     return 0;
 }
 
-// Simple & slow device lookup
-static int find_dev(oni_dev_idx_t idx)
+static int compare_dev_idx(const void *a, const void *b)
 {
-    for (size_t i = 0; i < num_devs; i++)
-        if (devices[i].idx == idx)
-            return i;
+    oni_dev_idx_t idx_a = ((const oni_device_t *)a)->idx;
+    oni_dev_idx_t idx_b = ((const oni_device_t *)b)->idx;
+    return (idx_a > idx_b) - (idx_a < idx_b);
+}
 
-    return -1;
+// Dump file of a device. NB: devices, like the context's device table, is
+// sorted by device index.
+static FILE *dump_file(const oni_device_t *dev)
+{
+    const oni_device_t *d = bsearch(dev, devices, num_devs, sizeof(oni_device_t), compare_dev_idx);
+    return d != NULL ? dump_files[d - devices] : NULL;
 }
 
 int16_t last_sample = 32767;
@@ -144,48 +185,54 @@ void *read_loop(void *vargp)
     unsigned long this_cnt = 0;
 
 #ifdef FEEDBACKLOOP
-    // Pre-allocate write frame
+    // Pre-allocate write frame, which is filled in place and resubmitted
     oni_frame_t *w_frame = NULL;
-    oni_create_frame(ctx, &w_frame, 8, 4);
+    int rc = oni_create_write_frame(ctx, &w_frame, 8, 4);
+    if (rc < 0) {
+        printf("Error: %s\n", oni_error_str(rc));
+        return NULL;
+    }
 #endif
 
     while (!quit)  {
 
         int rc = 0;
-        oni_frame_t *frame = NULL;
-        rc = oni_read_frame(ctx, &frame);
-        //printf("frame %d\n", frame->dev_idx);
+        // NB: Frames are only inspected until the next read, so they can be
+        // borrowed from the context rather than allocated
+        oni_frame_view_t frame;
+        rc = oni_next_frame_view(ctx, &frame);
+        //printf("frame %d\n", frame.dev_idx);
         if (rc < 0) {
             printf("Error: %s\n", oni_error_str(rc));
             quit = 1;
             break;
         }
 
-        int i = find_dev(frame->dev_idx);
-        if (i == -1) goto next;
+        const oni_device_t *dev = oni_get_device(ctx, frame.dev_idx);
+        if (dev == NULL) goto next;
 
-        if (dump && devices[i].id != ONIX_NULL) {
-            fwrite(frame->data, 1, frame->data_sz, dump_files[i]);
+        if (dump && dev->id != ONIX_NULL) {
+            fwrite(frame.data, 1, frame.data_sz, dump_file(dev));
         }
 
         if (display
             && (display_every_n <= 1 || counter % display_every_n == 0)
             && (num_frames_to_display == 0 || print_count < num_frames_to_display)
-            && (!device_idx_filter_en || devices[i].idx == device_idx_filter)
+            && (!device_idx_filter_en || dev->idx == device_idx_filter)
             ) {
 
-            oni_device_t this_dev = devices[i];
+            oni_device_t this_dev = *dev;
 
             this_cnt++;
             printf("\t[%" PRIu64 "] Dev: %u (%s) \n",
-                frame->time,
-                frame->dev_idx,
+                frame.time,
+                frame.dev_idx,
                 onix_device_str(this_dev.id));
 
             size_t i;
             printf("\tData: [");
-            for (i = 0; i < frame->data_sz; i += 2)
-                printf(print_fmt, *(uint16_t *)(frame->data + i));
+            for (i = 0; i < frame.data_sz; i += 2)
+                printf(print_fmt, *(uint16_t *)(frame.data + i));
             printf("]\n");
 
             print_count++;
@@ -193,9 +240,9 @@ void *read_loop(void *vargp)
 
 #ifdef FEEDBACKLOOP
         // Feedback loop test
-         if (frame->dev_idx == 7) {
+         if (frame.dev_idx == 7) {
 
-            int16_t sample = *(int16_t *)(frame->data + 10);
+            int16_t sample = *(int16_t *)(frame.data + 10);
 
             if (sample - last_sample > 500) {
 
@@ -214,7 +261,6 @@ void *read_loop(void *vargp)
 
 next:
         counter++;
-        oni_destroy_frame(frame);
     }
 
 #ifdef FEEDBACKLOOP
@@ -3,28 +3,114 @@
 // this top level driver. Or the loaded driver could import this number somehow
 // (e.g. via extern variable or context member)
 
+#ifdef __linux__
+#define _GNU_SOURCE // memfd_create
+#endif
+
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
 #include "oni.h"
+#include "onix.h"
+#include "onicobs.h"
 #include "onidriverloader.h"
+#include "oniindex.h"
+#include "onithread.h"
 
-// Device hash table overhead factor
-#define ONI_DEVHASHOVERHEAD 10
-
-// NB: 255 in sub-address is invalid in this implementation,
-// so we can use this to clear the hash table
-#define ONI_DEVIDXNULL 0xFFFFFFFF
+// Device index layout (rsv.rsv.hub.idx) used by the device lookup table
+#define ONI_NUMHUBS 256
+#define ONI_DEVSPERHUB 256
 
 // Consistent overhead bytestuffing buffer size
 #define ONI_COBSBUFFERSIZE 255
 
+// Signal stream read buffer size (bytes)
+#define ONI_SIGNALBUFFERSIZE 4096
+
+// Number of decoded packets held per signal queue
+#define ONI_SIGNALQUEUEDEPTH 32
+
+// Number of hardware events held until they are polled
+#define ONI_EVENTQUEUEDEPTH 256
+
+// Interval at which the control thread checks for hardware events while an
+// event callback is set (nanoseconds)
+#define ONI_EVENTPOLLNS 200000
+
+// Hardware event payload, [time, dev_idx, code, value]
+#define ONI_EVENTSZ sizeof(oni_fifo_time_t) + 3 * sizeof(oni_fifo_dat_t)
+
 // Frame constants
 #define ONI_RFRAMEHEADERSZ sizeof(oni_fifo_time_t) + 2 * sizeof(oni_fifo_dat_t) // [time, dev_idx, data_sz]
 #define ONI_WFRAMEHEADERSZ 2 * sizeof(oni_fifo_dat_t) // [dev_idx, data_sz]
 
+// Number of frame descriptors allocated at once when the frame pool is empty
+#define ONI_FRAMESLABSIZE 256
+
+// Data block alignment. Blocks of at least a page are page aligned. Smaller
+// blocks use the default allocator alignment so they do not each waste a page
+// and do not pay for the slower aligned allocator.
+#define ONI_BLOCKALIGN 4096
+
+// Initial capacity of the register transaction queue
+#define ONI_REGQUEUEDEPTH 64
+
+// Maximum number of register writes passed to the driver at once by
+// oni_write_regs. NB: Their acknowledgments must fit in a signal queue.
+#define ONI_REGBATCHSIZE ONI_SIGNALQUEUEDEPTH
+
+// Initial number of register cache slots
+#define ONI_REGCACHESIZE 64
+
+// Frames indexed at a time by oni_read_frames
+#define ONI_INDEXCHUNK 64
+
+// Alignment of columns allocated by oni_create_columns (bytes)
+#define ONI_COLUMNALIGN 64
+
+// Default maximum number of read blocks retained by the read block pool
+#define ONI_DEFAULTREADPOOLDEPTH 16
+
+// Default maximum number of write blocks retained for reuse
+#define ONI_DEFAULTWRITEPOOLDEPTH 4
+
+// Maximum number of queued frames taken by the asynchronous writer at once
+#define ONI_WRITERBATCH 64
+
+// Maximum number of due frames released by the output scheduler at once
+#define ONI_SCHEDBATCH 64
+
+// Initial capacity of the output scheduler's heap
+#define ONI_SCHEDCAPACITY 64
+
+// Sub-buckets per power of two of the trigger latency histogram, as a power of
+// two. Percentiles are reported within 1 / (1 << ONI_LATENCYSUBBITS).
+#define ONI_LATENCYSUBBITS 4
+#define ONI_LATENCYBUCKETS ((64 - ONI_LATENCYSUBBITS + 1) << ONI_LATENCYSUBBITS)
+
+// NB: Stolen from Linux kernel. Used to get the object holding a given
+// member (e.g. the buffer holding a reference count).
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+
 // Reference counter
 struct ref {
     void (*free)(const struct ref *);
@@ -39,32 +125,500 @@ struct oni_buf_impl {
     uint8_t *read_pos;
     uint8_t *end_pos;
 
+    // Read blocks only: space reserved in front of the block for the
+    // unconsumed tail of the previous block and the block size used to
+    // allocate the buffer
+    size_t headroom;
+    size_t block_size;
+
+    // Read blocks only: when the driver read of the block returned
+    // (nanoseconds, see _oni_clock_ns)
+    uint64_t read_ns;
+
+    // Pool that frames referencing this buffer are returned to
+    struct oni_pool_impl *pool;
+
+    // Free list link, only valid while the buffer is held by its pool
+    struct oni_buf_impl *next;
+
     // Reference count
     struct ref count;
 };
 
 // Frame with attached, automatically managed storage
-typedef union {
+typedef union oni_frame_impl {
     oni_frame_t public;
     struct {
         oni_frame_t f;
         struct oni_buf_impl *buffer;
     } private;
+
+    // Free list link, only valid while the frame is held by its pool
+    union oni_frame_impl *next;
 } oni_frame_impl_t;
 
+// Frame produced by oni_read_frames. NB: private.buffer is NULL, which tells
+// it apart from frames that are released individually.
+struct oni_batch_frame {
+    oni_frame_impl_t frame;
+    struct oni_frame_batch *batch;
+};
+
+// Frames produced by a single call to oni_read_frames. The frames share one
+// allocation and one reference to the buffer they view.
+struct oni_frame_batch {
+    struct oni_buf_impl *buffer;
+    struct oni_batch_frame frames[];
+};
+
+// Frame descriptors obtained from a single allocation
+struct oni_frame_slab {
+    struct oni_frame_slab *next;
+    oni_frame_impl_t frames[ONI_FRAMESLABSIZE];
+};
+
+// Free list that is private to one side of the context. The read side is only
+// used by the thread reading frames and the write side is serialized by the
+// context's write_mutex. hits counts descriptors taken from free lists and
+// misses counts slab allocations. They are only written by the side that owns
+// the cache but can be read from any thread.
+struct oni_frame_cache {
+    oni_frame_impl_t *free;
+    volatile uint64_t hits;
+    volatile uint64_t misses;
+};
+
+// Per-context frame descriptor and read block pool. Frames can be destroyed on
+// any thread, so released descriptors and blocks are pushed onto lock-free
+// stacks. Each consumer pops from its private list and only claims the shared
+// stack, in its entirety and with a single atomic exchange, when that list
+// runs dry. Nothing is ever popped individually from a shared stack, so they
+// are not subject to ABA.
+// NB: Every buffer holds a reference to the pool, so the pool outlives the
+// context until all frames have been destroyed.
+struct oni_pool_impl {
+
+    // Descriptors released by oni_destroy_frame
+    oni_frame_impl_t *volatile returned;
+
+    // Every slab allocated by the pool
+    struct oni_frame_slab *volatile slabs;
+
+    // Read and write side private free lists
+    struct oni_frame_cache rcache;
+    struct oni_frame_cache wcache;
+
+    // Read blocks released by their last reference and the read side's
+    // private list of blocks ready for reuse
+    struct oni_buf_impl *volatile rblocks_returned;
+    struct oni_buf_impl *rblocks_free;
+
+    // Number of pooled read blocks in existence and the maximum allowed
+    size_t rblocks_count;
+    size_t rblocks_depth;
+
+    // Number of read blocks allocated outside the pool because it was
+    // exhausted
+    uint64_t rblocks_exhausted;
+
+    // Write blocks released by their last reference, the write side's
+    // private list of blocks ready for reuse, and the number of pooled write
+    // blocks in existence and the maximum allowed
+    struct oni_buf_impl *volatile wblocks_returned;
+    struct oni_buf_impl *wblocks_free;
+    size_t wblocks_count;
+    size_t wblocks_depth;
+
+    // Reference count
+    struct ref count;
+};
+
+#ifdef __linux__
+// Portion of a mirrored ring buffer produced by a single block read. Frames
+// that start within a segment reference it. NB: The carried over tail of the
+// previous segment belongs to the next segment.
+struct oni_ring_seg {
+    struct oni_buf_impl buf;
+    struct oni_ring_impl *ring;
+    uint64_t start; // Absolute stream position of the first byte
+    volatile int released; // Set once the last reference has been dropped
+};
+
+// Mirrored read ring buffer. The same memory is mapped twice, back to back, so
+// that any span of up to size bytes starting within the first mapping is
+// contiguous. Segments are tracked in a FIFO and ring memory is only
+// overwritten once every segment that references it has been released.
+// NB: Every live segment holds a reference to the ring
+struct oni_ring_impl {
+
+    // Start of the first mapping and the size of each mapping
+    uint8_t *base;
+    size_t size;
+
+    // Geometry the ring was created for
+    size_t block_size;
+    size_t frame_size;
+
+    // Absolute stream position of the next byte to be read from the driver
+    uint64_t write_pos;
+
+    // Segment FIFO. Segments between tail and head are live or released but
+    // not yet reclaimed.
+    struct oni_ring_seg *segs;
+    size_t num_segs;
+    size_t head;
+    size_t tail;
+
+    // Reference count
+    struct ref count;
+};
+#endif
+
+// Read-ahead producer. A thread owned by the context keeps up to depth filled
+// read blocks queued ahead of oni_read_frame. Blocks are handed over through a
+// lock-free, single producer, single consumer queue. The mutex and condition
+// variable are only used when one side has to sleep because the queue is full
+// or empty.
+struct oni_readahead_impl {
+
+    oni_ctx ctx;
+    oni_thread_t thread;
+
+    // Queue of filled blocks
+    struct oni_buf_impl **blocks;
+    size_t depth;
+    volatile size_t head; // Next block to be consumed
+    volatile size_t tail; // Next slot to be filled
+
+    // Sleeping producer or consumer
+    oni_mutex_t mutex;
+    oni_cond_t cond;
+    volatile size_t producer_waiting;
+    volatile size_t consumer_waiting;
+
+    // Block geometry
+    size_t headroom;
+    size_t block_size;
+
+    // Set to stop the producer, and by the producer when it exits
+    volatile size_t stop;
+    volatile size_t done;
+    int rc; // Reason the producer exited
+};
+
+// Slot of the asynchronous writer's queue. seq tells whether the slot is free
+// or holds a frame for a given lap of the queue.
+struct oni_writer_slot {
+    volatile size_t seq;
+    oni_frame_t *frame;
+    uint64_t queued_ns;
+};
+
+// Asynchronous writer. Frames passed to oni_queue_frame are written by a
+// thread owned by the context so that blocking driver writes do not stall the
+// caller. The queue is a lock-free, bounded, multi-producer, multi-consumer
+// ring of sequenced slots (D. Vyukov). Besides the writer, producers consume
+// from it when they drop the oldest frame. The mutex and condition variable
+// are only used when the writer or a producer has to sleep, and to protect the
+// statistics.
+struct oni_writer_impl {
+
+    oni_ctx ctx;
+    oni_thread_t thread;
+
+    // Queue of frames, capacity is a power of two
+    struct oni_writer_slot *slots;
+    size_t mask;
+    volatile size_t head; // Next slot to be consumed
+    volatile size_t tail; // Next slot to be filled
+
+    // Sleeping writer or producers
+    oni_mutex_t mutex;
+    oni_cond_t cond;
+    volatile size_t writer_waiting;
+    volatile size_t producers_waiting;
+
+    // Statistics
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t failed;
+    size_t max_queued;
+    uint64_t latency_sum_ns;
+    uint64_t max_latency_ns;
+
+    // Set to stop the writer once the queue has been drained
+    volatile size_t stop;
+};
+
+// Frame held by the output scheduler until the acquisition clock approaches
+// its target time. seq orders frames with the same target time by arrival.
+struct oni_sched_entry {
+    oni_fifo_time_t time;
+    uint64_t seq;
+    oni_frame_t *frame;
+};
+
+// Output scheduler. Frames passed to oni_schedule_frame are kept in a binary
+// min-heap ordered by target time. Whichever thread reads frames tracks the
+// acquisition clock from their times and releases the frames that are due,
+// i.e. whose target is at most lead ticks ahead. The reader keeps the time at
+// which the earliest frame is due and the version of the schedule it was
+// computed from, so that reads only take the mutex when something is due or
+// the schedule has changed.
+struct oni_sched_impl {
+
+    oni_mutex_t mutex;
+
+    // Pending frames, protected by mutex
+    struct oni_sched_entry *heap;
+    size_t count;
+    size_t capacity;
+    uint64_t next_seq;
+    uint64_t lead;
+
+    // Incremented under mutex whenever frames are added or the lead changes
+    volatile size_t version;
+
+    // Owned by the reader
+    size_t seen_version;
+    oni_fifo_time_t release_at;
+
+    // Latest acquisition time read
+    volatile uint64_t time;
+
+    // Statistics, protected by mutex
+    uint64_t released;
+    uint64_t late;
+    uint64_t failed;
+    size_t max_pending;
+};
+
+#ifdef __linux__
+// Readiness notification (ONI_OPT_EVENTFD). The application polls an epoll
+// descriptor that holds an eventfd, which is raised while a frame can be read
+// from liboni's buffers, and the driver's data stream descriptor while liboni
+// reads from the driver on the application's thread. With read-ahead, the
+// producer raises the eventfd for every block it publishes, so drivers without
+// a descriptor of their own are covered.
+struct oni_ready_impl {
+
+    int epoll_fd;
+    int event_fd;
+    int driver_fd; // -1 if the driver provides none
+    int driver_fd_watched;
+
+    // Guards event_fd transitions. raised can be read without the lock.
+    oni_mutex_t mutex;
+    volatile size_t raised;
+};
+#endif
+
+// Control plane call made by an application thread and carried out by the
+// control thread. The arguments of the public function are packed into opt,
+// value, cvalue, size and size_out.
+struct oni_control_call {
+
+    int (*func)(oni_ctx ctx, const struct oni_control_call *call);
+    int opt;
+    void *value;
+    const void *cvalue;
+    size_t size;
+    size_t *size_out;
+
+    int rc;
+    int done;
+    struct oni_control_call *next;
+};
+
+// Control thread. While it exists, it is the only thread that accesses the
+// configuration registers and the signal stream. Register and option calls
+// from other threads are queued and carried out in order, and transactions
+// submitted using oni_submit_reg_ops are completed in the background, as is
+// the delivery of hardware events to the event callback. The data path does
+// not interact with it.
+struct oni_control_impl {
+
+    oni_ctx ctx;
+    oni_thread_t thread;
+
+    // Queued calls, protected by mutex. cond is signaled when a call is
+    // queued or completed.
+    oni_mutex_t mutex;
+    oni_cond_t cond;
+    struct oni_control_call *head;
+    struct oni_control_call *tail;
+
+    int stop;
+};
+
+// Subscription to frames from a set of devices. Frames are handed from the
+// demultiplexer thread to the subscriber through a lock-free, single producer,
+// single consumer queue. The mutex and condition variable are only used when
+// the subscriber has to sleep because the queue is empty.
+struct oni_sub_impl {
+
+    oni_ctx ctx;
+    struct oni_sub_impl *next;
+
+    // Subscribed devices
+    oni_dev_idx_t *dev_idxs;
+    size_t num_devs;
+
+    // Queue of frames, capacity is a power of two
+    oni_frame_t **frames;
+    size_t mask;
+    volatile size_t head; // Next frame to be consumed
+    volatile size_t tail; // Next slot to be filled
+
+    // Sleeping subscriber
+    oni_mutex_t mutex;
+    oni_cond_t cond;
+    volatile size_t consumer_waiting;
+
+    // Set while the demultiplexer is delivering frames, otherwise rc holds
+    // the reason it is not
+    volatile size_t active;
+    int rc;
+
+    // Frames discarded because the queue was full
+    volatile size_t dropped;
+};
+
+// Demultiplexer. While RUNNING with at least one subscription, a thread owned
+// by the context reads all frames and delivers them to the subscription for
+// their device. Frames from other devices are skipped after reading their
+// header.
+struct oni_demux_impl {
+
+    oni_ctx ctx;
+    oni_thread_t thread;
+
+    // Subscription for each device table entry, or NULL
+    struct oni_sub_impl **routes;
+
+    // Set to stop the thread
+    volatile size_t stop;
+};
+
+// Closed-loop trigger. The predicate is evaluated on the reading thread for
+// every frame from dev_idx right after the block holding the frame has been
+// read, before the frames ahead of it are returned, and the frame is written
+// in place when it fires.
+struct oni_trigger_impl {
+
+    oni_ctx ctx;
+    oni_dev_idx_t dev_idx;
+    oni_trigger_fn_t predicate;
+    void *user;
+    oni_frame_t *frame;
+
+    struct oni_trigger_impl *next;
+};
+
+// Closed-loop trigger counters. Latencies are counted in a log-linear
+// histogram so that percentiles are available without storing samples.
+struct oni_trigger_counts {
+    uint64_t evaluated;
+    uint64_t fired;
+    uint64_t failed;
+    uint64_t latency_sum_ns;
+    uint64_t max_latency_ns;
+    uint64_t latency_hist[ONI_LATENCYBUCKETS];
+};
+
+// Closed-loop trigger statistics. counts is only updated by the reading
+// thread, without locking. It makes seq odd for the duration of each update,
+// so that oni_get_opt can take a consistent copy (seqlock). The mutex guards
+// that copy.
+struct oni_trigger_stats_impl {
+
+    volatile uint64_t seq;
+    struct oni_trigger_counts counts;
+
+    oni_mutex_t mutex;
+    struct oni_trigger_counts snapshot;
+};
+
+// Configuration registers used for register access, see oni_reg_queue
+enum {
+    REGSHADOW_DEVIDX = 0,
+    REGSHADOW_ADDR,
+    REGSHADOW_VALUE,
+    REGSHADOW_RW,
+    NUMREGSHADOW
+};
+
+// Register transactions submitted using oni_submit_reg_ops. ops is a ring:
+// [head, active) have completed but have not been returned, active is in
+// progress unless it equals tail and the remainder are waiting to start.
+struct oni_reg_queue {
+
+    oni_reg_op_t **ops;
+    size_t capacity; // Power of two
+    size_t head;
+    size_t active;
+    size_t tail;
+
+    // Last values of the configuration registers used for register access
+    // that are known (bit set in shadow_valid). Known values are not
+    // rewritten.
+    oni_reg_val_t shadow[NUMREGSHADOW];
+    int shadow_valid;
+
+    // A transaction was abandoned, so the trigger might still be set
+    int trig_unknown;
+};
+
+// Register cache entry. Entries are never removed so that modes survive
+// ONI_OPT_RESET, which only clears the valid flags.
+struct oni_reg_cache_entry {
+    oni_dev_idx_t dev_idx;
+    oni_reg_addr_t addr;
+    oni_reg_val_t value;
+    int mode; // ONI_REGCACHE_*
+    int valid; // value is known
+    int used; // Slot holds an entry
+};
+
+// Register values known without asking the hardware. entries is an open
+// addressed hash table keyed on (dev_idx, addr).
+struct oni_reg_cache {
+
+    struct oni_reg_cache_entry *entries;
+    size_t capacity; // Power of two
+    size_t count;
+    uint64_t hits;
+
+    // Global clock rates, which only change across a reset
+    oni_reg_val_t sys_clk_hz;
+    oni_reg_val_t acq_clk_hz;
+    int sys_clk_valid;
+    int acq_clk_valid;
+};
+
 // Acquisition context
 struct oni_ctx_impl {
 
     // Hardware translation driver
     oni_driver_t driver;
 
-    // Device array
+    // Device array, with room for dev_table_capacity devices
     oni_size_t num_dev;
     oni_device_t *dev_table;
+    oni_size_t dev_table_capacity;
+
+    // oni_read_columns column for each device table position, or -1. Entries
+    // are only set during a call, and grown along with dev_table.
+    int *col_routes;
 
-    // oni_device_t.idx addressable device hash table
-    oni_size_t dev_hash_len;
-    oni_device_t *dev_hash_table;
+    // oni_device_t.idx addressable device lookup. Hub byte selects a table
+    // holding the device table position + 1 of each device on that hub (0 if
+    // there is no device). Hubs that never had devices share an empty table.
+    // Tables are cleared rather than freed on reset.
+    const oni_size_t *dev_hubs[ONI_NUMHUBS];
+
+    // Duration of the last reset (nanoseconds)
+    uint64_t reset_ns;
 
     // Maximum frame size (bytes, includes header)
     oni_size_t max_read_frame_size;
@@ -74,10 +628,90 @@ struct oni_ctx_impl {
     oni_size_t block_read_size;
     oni_size_t block_write_size;
 
+    // Signal stream bytes that have been read from the driver but not yet
+    // parsed into packets, in [sig_pos, sig_end)
+    uint8_t sig_buffer[ONI_SIGNALBUFFERSIZE];
+    size_t sig_pos;
+    size_t sig_end;
+
+    // Signal stream bytes that are known to follow, which can be read at once
+    // even if the driver cannot tell how many bytes are readable
+    size_t sig_pending;
+
+    // Decoded signals, one queue per group of signal types (see
+    // _oni_signal_queue)
+    struct oni_signal_queue *sig_queues;
+
+    // Hardware events
+    struct oni_event_queue *events;
+
     // Current, attached buffers
     struct oni_buf_impl *shared_rbuf;
     struct oni_buf_impl *shared_wbuf;
 
+    // Serializes write frame creation, which takes space from shared_wbuf and
+    // descriptors from the write side of the pool, so that frames can be
+    // created on any thread
+    oni_mutex_t write_mutex;
+
+    // Frame descriptor pool
+    struct oni_pool_impl *pool;
+
+    // Register transactions
+    struct oni_reg_queue regs;
+
+    // Cached register values
+    struct oni_reg_cache reg_cache;
+
+    // Read block header indexer, selected for the host CPU
+    oni_index_fn_t index_block;
+
+    // Signal packet decoder, selected for the host CPU
+    oni_cobs_fn_t cobs_decode;
+
+    // Number of blocks kept in flight by the read-ahead thread (0 disables
+    // read-ahead), the CPU it is pinned to (-1 for none) and the thread
+    // itself, which only exists while RUNNING
+    oni_size_t read_ahead_depth;
+    int read_ahead_cpu;
+    struct oni_readahead_impl *reader;
+
+    // Asynchronous writer queue capacity (0 disables the writer), full queue
+    // policy and the writer itself
+    oni_size_t writer_depth;
+    int writer_policy;
+    struct oni_writer_impl *writer;
+
+    // Output scheduler
+    struct oni_sched_impl *sched;
+
+    // Closed-loop triggers, number of bytes at the end of the current read
+    // block that have not been passed to them yet and their statistics
+    struct oni_trigger_impl *triggers;
+    size_t trig_unscanned;
+    struct oni_trigger_stats_impl *trig_stats;
+
+    // Control thread, which only exists while ONI_OPT_CONTROLTHREAD is set
+    struct oni_control_impl *control;
+
+    // Frame subscriptions, the CPU the demultiplexer is pinned to (-1 for
+    // none) and the demultiplexer itself, which only exists while RUNNING
+    struct oni_sub_impl *subs;
+    int demux_cpu;
+    struct oni_demux_impl *demux;
+
+    // Mirrored read ring size (bytes, 0 selects the block read path)
+    oni_size_t read_ring_size;
+#ifdef __linux__
+    struct oni_ring_impl *ring;
+#endif
+
+#ifdef __linux__
+    // Readiness notification, which only exists once ONI_OPT_EVENTFD has been
+    // read
+    struct oni_ready_impl *ready;
+#endif
+
     // Acquisition state
     enum {
         CTXNULL = 0,
@@ -96,27 +730,149 @@ typedef enum {
     CONFIGRNACK         = (1u << 4), // Configuration no-read-acknowledgment
     DEVICETABLEACK      = (1u << 5), // Device table start acknowledgment
     DEVICEINST          = (1u << 6), // Device table instance
+    EVENT               = (1u << 7), // Asynchronous hardware event
 } oni_signal_t;
 
+// Signal queues, see _oni_signal_queue
+enum {
+    SIGQ_CONFIGW = 0,   // Configuration write (n)acknowledgments
+    SIGQ_CONFIGR,       // Configuration read (n)acknowledgments
+    SIGQ_DEVICETABLE,   // Device table start and instances
+    SIGQ_OTHER,         // Everything else
+    NUMSIGQ
+};
+
+// Decoded signal packet
+struct oni_signal_packet {
+    oni_signal_t type;
+    size_t size; // Payload size (bytes)
+    uint8_t data[ONI_COBSBUFFERSIZE];
+};
+
+// Signals that have been received but not yet waited for
+struct oni_signal_queue {
+    struct oni_signal_packet packets[ONI_SIGNALQUEUEDEPTH];
+    size_t head;
+    size_t tail;
+};
+
+// Receives hardware events instead of the event queue, see
+// oni_set_event_callback
+struct oni_event_handler {
+    oni_event_cb_t callback;
+    void *user;
+};
+
+// Hardware events that have been received but not yet polled. If the queue
+// is full, its oldest event is discarded.
+struct oni_event_queue {
+    oni_event_t events[ONI_EVENTQUEUEDEPTH];
+    size_t head;
+    size_t tail;
+    uint64_t dropped;
+    struct oni_event_handler handler;
+};
+
 // Helpers
-static inline oni_dev_idx_t _oni_hash32(oni_dev_idx_t x);
-static inline int _oni_hash32_find(oni_ctx ctx, oni_dev_idx_t x);
+static inline int _oni_dev_find(oni_ctx ctx, oni_dev_idx_t x);
+static void _oni_clear_col_routes(oni_ctx ctx, const oni_column_t *cols, size_t num_cols);
+// Shared by all hubs that have no devices
+static const oni_size_t _oni_empty_hub[ONI_DEVSPERHUB];
+
+static void _oni_clear_dev_hubs(oni_ctx ctx);
+static void _oni_free_dev_hubs(oni_ctx ctx);
 static int _oni_reset_routine(oni_ctx ctx);
 static inline int _oni_read(oni_ctx ctx, oni_read_stream_t stream, void *data, size_t size);
 static inline int _oni_write(oni_ctx ctx, oni_write_stream_t stream, const char* data, size_t size);
+static int _oni_fill_signal_buffer(oni_ctx ctx);
 static int _oni_read_signal_packet(oni_ctx ctx, uint8_t *buffer);
-static int _oni_read_signal_data(oni_ctx ctx, oni_signal_t *type, void *data, size_t size);
-static int _oni_pump_signal_type(oni_ctx ctx, int flags, oni_signal_t *type);
-static int _oni_pump_signal_data(oni_ctx ctx, int flags, oni_signal_t *type, void *data, int size);
-static int _oni_cobs_unstuff(uint8_t *dst, const uint8_t *src, size_t size);
+static inline int _oni_signal_queue(int types);
+static int _oni_dispatch_signal(oni_ctx ctx);
+static void _oni_push_event(oni_ctx ctx, const uint8_t *data, size_t size);
+static int _oni_pump_signals(oni_ctx ctx);
+static int _oni_wait_signal(oni_ctx ctx, int types, oni_signal_t *type, void *data, size_t size);
+static int _oni_signal_ready(oni_ctx ctx, int types);
+static int _oni_write_reg_config(oni_ctx ctx, oni_config_t reg, int shadow, oni_reg_val_t value);
+static inline int _oni_reg_op_signals(const oni_reg_op_t *op);
+static int _oni_check_reg_trig(oni_ctx ctx);
+static int _oni_start_reg_op(oni_ctx ctx, const oni_reg_op_t *op);
+static int _oni_finish_reg_op(oni_ctx ctx, oni_reg_op_t *op);
+static void _oni_start_queued_reg_op(oni_ctx ctx);
+static void _oni_progress_reg_ops(oni_ctx ctx);
+static int _oni_run_reg_op(oni_ctx ctx, oni_reg_op_t *op);
+static int _oni_write_regs_batch(oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops);
+static struct oni_reg_cache_entry *_oni_reg_cache_find(oni_ctx ctx, oni_dev_idx_t dev_idx, oni_reg_addr_t addr, int add);
+static int _oni_reg_cache_lookup(oni_ctx ctx, oni_reg_op_t *op);
+static void _oni_reg_cache_update(oni_ctx ctx, const oni_reg_op_t *op, int rc);
+static void _oni_reg_cache_invalidate(oni_ctx ctx);
 static inline int _oni_write_config(oni_ctx ctx, oni_config_t reg, oni_reg_val_t value);
 static inline int _oni_read_config(oni_ctx, oni_config_t reg, oni_reg_val_t *value);
 static int _oni_alloc_write_buffer(oni_ctx ctx, void **data, size_t size);
+static int _oni_create_write_frame(oni_ctx ctx, oni_frame_impl_t **frame, oni_dev_idx_t dev_idx, size_t data_sz);
 static int _oni_ensure_read_buffer(oni_ctx ctx);
+static int _oni_refill_block(oni_ctx ctx, size_t remaining);
 static void _oni_dump_buffers(oni_ctx ctx);
 static void _oni_destroy_buffer(const struct ref *ref);
+static struct oni_buf_impl *_oni_acquire_read_block(oni_ctx ctx, size_t headroom);
+static void _oni_recycle_read_block(const struct ref *ref);
+static struct oni_buf_impl *_oni_acquire_write_block(oni_ctx ctx);
+static void _oni_recycle_write_block(const struct ref *ref);
+#ifdef __linux__
+static int _oni_ensure_ring_buffer(oni_ctx ctx);
+static struct oni_ring_impl *_oni_create_ring(oni_ctx ctx);
+static void _oni_release_ring_segment(const struct ref *ref);
+static void _oni_destroy_ring(const struct ref *ref);
+#endif
+static size_t _oni_read_headroom(oni_ctx ctx);
+static int _oni_start_control(oni_ctx ctx);
+static void _oni_stop_control(oni_ctx ctx);
+static void _oni_control_loop(void *arg);
+static int _oni_control_call(oni_ctx ctx, int (*func)(oni_ctx, const struct oni_control_call *), int opt, void *value, const void *cvalue, size_t size, size_t *size_out);
+static int _oni_start_readahead(oni_ctx ctx);
+static void _oni_stop_readahead(oni_ctx ctx);
+static void _oni_readahead_loop(void *arg);
+static int _oni_ensure_readahead_buffer(oni_ctx ctx);
+#ifdef __linux__
+static int _oni_create_ready(oni_ctx ctx);
+static void _oni_destroy_ready(struct oni_ready_impl *rd);
+static void _oni_ready_raise(struct oni_ready_impl *rd);
+static void _oni_ready_refresh(oni_ctx ctx, struct oni_ready_impl *rd);
+static void _oni_ready_watch_driver(oni_ctx ctx, int watch);
+#endif
+static inline void _oni_ready_update(oni_ctx ctx);
+static int _oni_next_frame_view(oni_ctx ctx, oni_frame_view_t *view);
+static int _oni_write_frames(oni_ctx ctx, const oni_frame_t **frames, size_t num_frames);
+static int _oni_start_writer(oni_ctx ctx);
+static void _oni_stop_writer(oni_ctx ctx);
+static void _oni_writer_loop(void *arg);
+static int _oni_writer_push(struct oni_writer_impl *w, oni_frame_t *frame);
+static oni_frame_t *_oni_writer_pop(struct oni_writer_impl *w, uint64_t *queued_ns);
+static int _oni_writer_full(struct oni_writer_impl *w);
+static int _oni_writer_empty(struct oni_writer_impl *w);
+static inline void _oni_sched_advance(oni_ctx ctx, oni_fifo_time_t time);
+static void _oni_sched_release(oni_ctx ctx, oni_fifo_time_t time);
+static void _oni_sched_pop(struct oni_sched_impl *s);
+static void _oni_sched_clear(oni_ctx ctx);
+static int _oni_start_demux(oni_ctx ctx);
+static void _oni_stop_demux(oni_ctx ctx);
+static void _oni_demux_loop(void *arg);
+static void _oni_destroy_sub(struct oni_sub_impl *sub);
+static void _oni_trig_scan(oni_ctx ctx, size_t remaining, uint64_t read_ns);
+static inline size_t _oni_latency_bucket(uint64_t ns);
+static inline uint64_t _oni_latency_bucket_max(size_t bucket);
+static uint64_t _oni_latency_percentile(const struct oni_trigger_counts *c, double p);
+static void _oni_trig_snapshot(struct oni_trigger_stats_impl *st);
+static void *_oni_alloc_block(size_t size, size_t block_size);
+static void *_oni_alloc_aligned(size_t size, size_t align);
+static void _oni_free_block(void *ptr);
+static oni_frame_impl_t *_oni_acquire_frame(struct oni_pool_impl *pool, struct oni_frame_cache *cache);
+static inline void _oni_release_frame(struct oni_pool_impl *pool, oni_frame_impl_t *iframe);
+static void _oni_destroy_pool(const struct ref *ref);
 static inline void _ref_inc(struct ref *ref);
 static inline void _ref_dec(struct ref *ref);
+static inline int _oni_cas_ptr(void *volatile *ptr, void *expected, void *desired);
+static inline void *_oni_xchg_ptr(void *volatile *ptr, void *value);
+static inline void *_oni_load_ptr(void *volatile *ptr);
 
 oni_ctx oni_create_ctx(const char* drv_name)
 {
@@ -127,14 +883,64 @@ oni_ctx oni_create_ctx(const char* drv_name)
         return NULL;
     }
 
+    ctx->pool = calloc(1, sizeof(struct oni_pool_impl));
+
+    if (ctx->pool == NULL) {
+        errno = EAGAIN;
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->sig_queues = calloc(NUMSIGQ, sizeof(struct oni_signal_queue));
+    ctx->events = calloc(1, sizeof(struct oni_event_queue));
+    ctx->sched = calloc(1, sizeof(struct oni_sched_impl));
+    ctx->trig_stats = calloc(1, sizeof(struct oni_trigger_stats_impl));
+
+    if (ctx->sig_queues == NULL || ctx->events == NULL || ctx->sched == NULL
+        || ctx->trig_stats == NULL) {
+        errno = EAGAIN;
+        free(ctx->trig_stats);
+        free(ctx->sched);
+        free(ctx->events);
+        free(ctx->sig_queues);
+        free(ctx->pool);
+        free(ctx);
+        return NULL;
+    }
+
+    // Context holds the initial reference to the pool
+    ctx->pool->count = (struct ref){_oni_destroy_pool, 1};
+    ctx->pool->rblocks_depth = ONI_DEFAULTREADPOOLDEPTH;
+    ctx->pool->wblocks_depth = ONI_DEFAULTWRITEPOOLDEPTH;
+
+    _oni_mutex_init(&ctx->sched->mutex);
+    ctx->sched->release_at = UINT64_MAX;
+    _oni_mutex_init(&ctx->trig_stats->mutex);
+    _oni_mutex_init(&ctx->write_mutex);
+
     if (oni_create_driver(drv_name, &ctx->driver)) {
         errno = EINVAL;
+        _oni_mutex_destroy(&ctx->write_mutex);
+        _oni_mutex_destroy(&ctx->trig_stats->mutex);
+        _oni_mutex_destroy(&ctx->sched->mutex);
+        free(ctx->trig_stats);
+        free(ctx->sched);
+        free(ctx->events);
+        free(ctx->sig_queues);
+        free(ctx->pool);
         free(ctx);
         return NULL;
     }
 
     ctx->num_dev = 0;
-    ctx->dev_hash_table = NULL;
+    for (size_t i = 0; i < ONI_NUMHUBS; i++)
+        ctx->dev_hubs[i] = _oni_empty_hub;
+    ctx->index_block = oni_index_best();
+    ctx->cobs_decode = oni_cobs_best_decoder();
+    ctx->read_ahead_cpu = -1;
+    ctx->demux_cpu = -1;
+    ctx->trig_unscanned = SIZE_MAX;
+    ctx->regs.trig_unknown = 1;
     ctx->run_state = UNINITIALIZED;
 
     return ctx;
@@ -155,6 +961,7 @@ int oni_init_ctx(oni_ctx ctx, int host_idx)
     // parameters) Success will set ctx->run_state to IDLE
 
     // Set the reset register
+    uint64_t start = _oni_clock_ns();
     rc = _oni_write_config(ctx, ONI_CONFIG_RESET, 1);
     if (rc) return rc;
 
@@ -162,6 +969,8 @@ int oni_init_ctx(oni_ctx ctx, int host_idx)
     rc = _oni_reset_routine(ctx);
     if (rc) return rc;
 
+    ctx->reset_ns = _oni_clock_ns() - start;
+
     // Run state is now IDLE
     ctx->run_state = IDLE;
 
@@ -171,9 +980,22 @@ int oni_init_ctx(oni_ctx ctx, int host_idx)
 int oni_destroy_ctx(oni_ctx ctx)
 {
     assert(ctx != NULL && "Context is NULL");
+
+    // NB: Must be stopped before the driver is destroyed
+    _oni_stop_control(ctx);
+    _oni_stop_demux(ctx);
+    _oni_stop_readahead(ctx);
+    _oni_stop_writer(ctx);
+
     int rc = oni_destroy_driver(&ctx->driver);
     if (rc) return rc;
 
+    // NB: Frames that are still scheduled are never written
+    _oni_sched_clear(ctx);
+    _oni_mutex_destroy(&ctx->sched->mutex);
+    free(ctx->sched->heap);
+    free(ctx->sched);
+
     // NB: _ref_dec is only called when a new shared buffer is created. We must
     // therefore explicitly decrement the active shared buffers here to balance
     // the initial _ref_inc from their creation.
@@ -183,21 +1005,130 @@ int oni_destroy_ctx(oni_ctx ctx)
     if (ctx->shared_wbuf != NULL)
         _ref_dec(&(ctx->shared_wbuf->count));
 
+    _oni_mutex_destroy(&ctx->write_mutex);
+
+#ifdef __linux__
+    // NB: The ring is unmapped once all outstanding frames have been destroyed
+    if (ctx->ring != NULL)
+        _ref_dec(&(ctx->ring->count));
+
+    if (ctx->ready != NULL)
+        _oni_destroy_ready(ctx->ready);
+#endif
+
     if (ctx->dev_table != NULL)
         free(ctx->dev_table);
 
-    if (ctx->dev_hash_table != NULL)
-        free(ctx->dev_hash_table);
+    free(ctx->col_routes);
+
+    _oni_free_dev_hubs(ctx);
+
+    // NB: Queued frames are destroyed along with the subscriptions
+    while (ctx->subs != NULL) {
+        struct oni_sub_impl *sub = ctx->subs;
+        ctx->subs = sub->next;
+        _oni_destroy_sub(sub);
+    }
+
+    while (ctx->triggers != NULL) {
+        struct oni_trigger_impl *trigger = ctx->triggers;
+        ctx->triggers = trigger->next;
+        oni_destroy_frame(trigger->frame);
+        free(trigger);
+    }
+
+    _oni_mutex_destroy(&ctx->trig_stats->mutex);
+    free(ctx->trig_stats);
+    free(ctx->events);
+    free(ctx->sig_queues);
+    free(ctx->regs.ops);
+    free(ctx->reg_cache.entries);
+
+    // NB: The pool is freed once all outstanding frames have been destroyed
+    _ref_dec(&(ctx->pool->count));
 
     free(ctx);
 
     return ONI_ESUCCESS;
 }
 
+// Returns non-zero if a control plane call must be handed to the control
+// thread
+static inline int _oni_control_redirect(oni_ctx ctx)
+{
+    return ctx->control != NULL && !_oni_thread_is_current(ctx->control->thread);
+}
+
+// Control thread side of the public control plane functions
+static int _oni_call_get_opt(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_get_opt(ctx, call->opt, call->value, call->size_out);
+}
+
+static int _oni_call_set_opt(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_set_opt(ctx, call->opt, call->cvalue, call->size);
+}
+
+static int _oni_call_get_driver_opt(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_get_driver_opt(ctx, call->opt, call->value, call->size_out);
+}
+
+static int _oni_call_set_driver_opt(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_set_driver_opt(ctx, call->opt, call->cvalue, call->size);
+}
+
+static int _oni_call_run_reg_op(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return _oni_run_reg_op(ctx, call->value);
+}
+
+static int _oni_call_write_regs(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_write_regs(ctx, call->value, call->size);
+}
+
+static int _oni_call_read_regs(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_read_regs(ctx, call->value, call->size);
+}
+
+static int _oni_call_set_reg_cache(oni_ctx ctx, const struct oni_control_call *call)
+{
+    const oni_reg_op_t *op = call->cvalue;
+    return oni_set_reg_cache(ctx, op->dev_idx, op->addr, call->opt);
+}
+
+static int _oni_call_submit_reg_ops(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_submit_reg_ops(ctx, call->value, call->size);
+}
+
+static int _oni_call_poll_reg_completions(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_poll_reg_completions(ctx, call->value, call->size, call->opt);
+}
+
+static int _oni_call_poll_event(oni_ctx ctx, const struct oni_control_call *call)
+{
+    return oni_poll_event(ctx, call->value, call->size);
+}
+
+static int _oni_call_set_event_callback(oni_ctx ctx, const struct oni_control_call *call)
+{
+    const struct oni_event_handler *handler = call->cvalue;
+    return oni_set_event_callback(ctx, handler->callback, handler->user);
+}
+
 int oni_get_opt(const oni_ctx ctx, int ctx_opt, void *value, size_t *option_len)
 {
     assert(ctx != NULL && "Context is NULL");
 
+    if (ctx_opt != ONI_OPT_CONTROLTHREAD && _oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_get_opt, ctx_opt, value, NULL, 0, option_len);
+
     switch (ctx_opt) {
         case ONI_OPT_DEVICETABLE: {
 
@@ -251,9 +1182,15 @@ int oni_get_opt(const oni_ctx ctx, int ctx_opt, void *value, size_t *option_len)
             if (*option_len < ONI_REGSZ)
                 return ONI_EBUFFERSIZE;
 
-            int rc = _oni_read_config(ctx, ONI_CONFIG_SYSCLKHZ, value);
-            if (rc) return rc;
+            if (ctx->reg_cache.sys_clk_valid) {
+                ctx->reg_cache.hits++;
+            } else {
+                int rc = _oni_read_config(ctx, ONI_CONFIG_SYSCLKHZ, &ctx->reg_cache.sys_clk_hz);
+                if (rc) return rc;
+                ctx->reg_cache.sys_clk_valid = 1;
+            }
 
+            *(oni_reg_val_t *)value = ctx->reg_cache.sys_clk_hz;
             *option_len = ONI_REGSZ;
             break;
         }
@@ -266,9 +1203,15 @@ int oni_get_opt(const oni_ctx ctx, int ctx_opt, void *value, size_t *option_len)
             if (*option_len < ONI_REGSZ)
                 return ONI_EBUFFERSIZE;
 
-            int rc = _oni_read_config(ctx, ONI_CONFIG_ACQCLKHZ, value);
-            if (rc) return rc;
+            if (ctx->reg_cache.acq_clk_valid) {
+                ctx->reg_cache.hits++;
+            } else {
+                int rc = _oni_read_config(ctx, ONI_CONFIG_ACQCLKHZ, &ctx->reg_cache.acq_clk_hz);
+                if (rc) return rc;
+                ctx->reg_cache.acq_clk_valid = 1;
+            }
 
+            *(oni_reg_val_t *)value = ctx->reg_cache.acq_clk_hz;
             *option_len = ONI_REGSZ;
             break;
         }
@@ -341,54 +1284,334 @@ int oni_get_opt(const oni_ctx ctx, int ctx_opt, void *value, size_t *option_len)
             *option_len = ONI_REGSZ;
             break;
         }
-        case ONI_OPT_RESET:
-        case ONI_OPT_RESETACQCOUNTER:
-            return ONI_EWRITEONLY;
-        default: {
+        case ONI_OPT_FRAMEPOOLHITS: {
 
-            // Attempt to read to custom (outside ONI spec) configuration
-            // option
-            assert(ctx_opt >= ONI_OPT_CUSTOMBEGIN && "Invalid custom configuration register.");
-            if (ctx_opt < ONI_OPT_CUSTOMBEGIN)
-                return ONI_EPROTCONFIG;
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
 
-            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
-            if (ctx->run_state < IDLE)
-                return ONI_EINVALSTATE;
+            *(uint64_t *)value = _oni_atomic_load64(&ctx->pool->rcache.hits)
+                + _oni_atomic_load64(&ctx->pool->wcache.hits);
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_FRAMEPOOLMISSES: {
 
-            if (*option_len < ONI_REGSZ)
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
                 return ONI_EBUFFERSIZE;
 
-            int rc = _oni_read_config(ctx,
-                                      ONI_CONFIG_CUSTOMBEGIN + (ctx_opt - ONI_OPT_CUSTOMBEGIN),
-                                      value);
-            if (rc) return rc;
+            *(uint64_t *)value = _oni_atomic_load64(&ctx->pool->rcache.misses)
+                + _oni_atomic_load64(&ctx->pool->wcache.misses);
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_REGCACHEHITS: {
 
-            *option_len = ONI_REGSZ;
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
 
+            *(uint64_t *)value = ctx->reg_cache.hits;
+            *option_len = required_bytes;
             break;
         }
-    }
-    return ONI_ESUCCESS;
-}
+        case ONI_OPT_RESETTIMENS: {
 
-int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
-{
-    assert(ctx != NULL && "Context is NULL");
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
 
-    switch (ctx_opt) {
-        case ONI_OPT_RUNNING: {
-            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
-            if (ctx->run_state < IDLE)
-                return ONI_EINVALSTATE;
+            *(uint64_t *)value = ctx->reset_ns;
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_EVENTSDROPPED: {
 
-            if (option_len != ONI_REGSZ)
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
                 return ONI_EBUFFERSIZE;
 
-            int rc = _oni_write_config(
-                ctx, ONI_CONFIG_RUNNING, *(oni_reg_val_t*)value);
-            if (rc) return rc;
-
+            *(uint64_t *)value = ctx->events->dropped;
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_EVENTFD: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            // NB: The descriptor is level triggered. It follows frames taken
+            // by oni_read_frame(s), oni_next_frame_view and oni_read_columns,
+            // so it is not raised for frames delivered to subscriptions.
+            // Drivers without a descriptor of their own require read-ahead
+            // (ONI_OPT_READAHEADDEPTH, with a block size large enough for the
+            // thread hand-off to pay off) to be selected first and the read
+            // ring, which bypasses read-ahead, to be deselected.
+#ifdef __linux__
+            if (ctx->ready == NULL) {
+                int rc = _oni_create_ready(ctx);
+                if (rc) return rc;
+            }
+
+            *(int *)value = ctx->ready->epoll_fd;
+            *option_len = sizeof(int);
+            break;
+#else
+            return ONI_EUNIMPL;
+#endif
+        }
+        case ONI_OPT_READPOOLDEPTH: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = (oni_size_t)ctx->pool->rblocks_depth;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_WRITEPOOLDEPTH: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = (oni_size_t)ctx->pool->wblocks_depth;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_WRITERDEPTH: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = ctx->writer_depth;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_WRITERPOLICY: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            *(int *)value = ctx->writer_policy;
+            *option_len = sizeof(int);
+            break;
+        }
+        case ONI_OPT_WRITERSTATS: {
+
+            size_t required_bytes = sizeof(oni_writer_stats_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
+
+            oni_writer_stats_t *stats = value;
+            memset(stats, 0, required_bytes);
+
+            struct oni_writer_impl *w = ctx->writer;
+            if (w != NULL) {
+                _oni_mutex_lock(&w->mutex);
+                stats->written = w->written;
+                stats->dropped = w->dropped;
+                stats->failed = w->failed;
+                stats->max_queued = (oni_size_t)w->max_queued;
+                stats->mean_latency_ns = w->written + w->failed ?
+                    w->latency_sum_ns / (w->written + w->failed) : 0;
+                stats->max_latency_ns = w->max_latency_ns;
+                _oni_mutex_unlock(&w->mutex);
+
+                // NB: Producers reserve slots before filling them
+                size_t head = _oni_atomic_load(&w->head);
+                size_t tail = _oni_atomic_load(&w->tail);
+                stats->queued = tail > head ? (oni_size_t)(tail - head) : 0;
+            }
+
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_SCHEDLEAD: {
+
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
+
+            _oni_mutex_lock(&ctx->sched->mutex);
+            *(uint64_t *)value = ctx->sched->lead;
+            _oni_mutex_unlock(&ctx->sched->mutex);
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_SCHEDSTATS: {
+
+            size_t required_bytes = sizeof(oni_sched_stats_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
+
+            struct oni_sched_impl *s = ctx->sched;
+            oni_sched_stats_t *stats = value;
+            memset(stats, 0, required_bytes);
+
+            stats->time = _oni_atomic_load64(&s->time);
+            _oni_mutex_lock(&s->mutex);
+            stats->released = s->released;
+            stats->late = s->late;
+            stats->failed = s->failed;
+            stats->pending = (oni_size_t)s->count;
+            stats->max_pending = (oni_size_t)s->max_pending;
+            _oni_mutex_unlock(&s->mutex);
+
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_TRIGGERSTATS: {
+
+            size_t required_bytes = sizeof(oni_trigger_stats_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
+
+            struct oni_trigger_stats_impl *st = ctx->trig_stats;
+            oni_trigger_stats_t *stats = value;
+            memset(stats, 0, required_bytes);
+
+            _oni_mutex_lock(&st->mutex);
+            _oni_trig_snapshot(st);
+            const struct oni_trigger_counts *c = &st->snapshot;
+            stats->evaluated = c->evaluated;
+            stats->fired = c->fired;
+            stats->failed = c->failed;
+            if (c->fired > 0) {
+                stats->mean_latency_ns = c->latency_sum_ns / c->fired;
+                stats->p50_latency_ns = _oni_latency_percentile(c, 0.5);
+                stats->p90_latency_ns = _oni_latency_percentile(c, 0.9);
+                stats->p99_latency_ns = _oni_latency_percentile(c, 0.99);
+                stats->p999_latency_ns = _oni_latency_percentile(c, 0.999);
+            }
+            stats->max_latency_ns = c->max_latency_ns;
+            _oni_mutex_unlock(&st->mutex);
+
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_READPOOLEXHAUSTED: {
+
+            size_t required_bytes = sizeof(uint64_t);
+            if (*option_len < required_bytes)
+                return ONI_EBUFFERSIZE;
+
+            *(uint64_t *)value = ctx->pool->rblocks_exhausted;
+            *option_len = required_bytes;
+            break;
+        }
+        case ONI_OPT_READRINGSIZE: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = ctx->read_ring_size;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_READAHEADDEPTH: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = ctx->read_ahead_depth;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_READAHEADCPU: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            *(int *)value = ctx->read_ahead_cpu;
+            *option_len = sizeof(int);
+            break;
+        }
+        case ONI_OPT_READAHEADWAITING: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            struct oni_readahead_impl *ra = ctx->reader;
+            *(oni_size_t *)value = ra != NULL ?
+                (oni_size_t)(_oni_atomic_load(&ra->tail) - _oni_atomic_load(&ra->head)) : 0;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_DEMUXCPU: {
+
+            if (*option_len < sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+            *(int *)value = ctx->demux_cpu;
+            *option_len = sizeof(int);
+            break;
+        }
+        case ONI_OPT_CONTROLTHREAD: {
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            *(oni_size_t *)value = ctx->control != NULL;
+            *option_len = ONI_REGSZ;
+            break;
+        }
+        case ONI_OPT_RESET:
+        case ONI_OPT_RESETACQCOUNTER:
+            return ONI_EWRITEONLY;
+        default: {
+
+            // Attempt to read to custom (outside ONI spec) configuration
+            // option
+            assert(ctx_opt >= ONI_OPT_CUSTOMBEGIN && "Invalid custom configuration register.");
+            if (ctx_opt < ONI_OPT_CUSTOMBEGIN)
+                return ONI_EPROTCONFIG;
+
+            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
+            if (ctx->run_state < IDLE)
+                return ONI_EINVALSTATE;
+
+            if (*option_len < ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            int rc = _oni_read_config(ctx,
+                                      ONI_CONFIG_CUSTOMBEGIN + (ctx_opt - ONI_OPT_CUSTOMBEGIN),
+                                      value);
+            if (rc) return rc;
+
+            *option_len = ONI_REGSZ;
+
+            break;
+        }
+    }
+    return ONI_ESUCCESS;
+}
+
+int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (ctx_opt != ONI_OPT_CONTROLTHREAD && _oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_set_opt, ctx_opt, NULL, value, option_len, NULL);
+
+    switch (ctx_opt) {
+        case ONI_OPT_RUNNING: {
+            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
+            if (ctx->run_state < IDLE)
+                return ONI_EINVALSTATE;
+
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            // Reader threads are stopped while the hardware is still
+            // producing so that their in-flight reads can complete
+            _oni_stop_demux(ctx);
+            _oni_stop_readahead(ctx);
+
+            int rc = _oni_write_config(
+                ctx, ONI_CONFIG_RUNNING, *(oni_reg_val_t*)value);
+            if (rc) return rc;
+
             // Dump buffers
             // TODO: Is this always the right thing to do? In the case our
             // RIFFA implementation, yes. But other implementations may not
@@ -396,10 +1619,38 @@ int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
             // on restart is not the start of a frame.
             _oni_dump_buffers(ctx);
 
-            if (*(oni_reg_val_t *)value != 0)
+            if (*(oni_reg_val_t *)value != 0) {
+
+                // NB: The mirrored ring read path performs its own reads
+                if (ctx->read_ahead_depth != 0 && ctx->read_ring_size == 0) {
+                    rc = _oni_start_readahead(ctx);
+                    if (rc) {
+                        _oni_write_config(ctx, ONI_CONFIG_RUNNING, 0);
+                        ctx->run_state = IDLE;
+                        return rc;
+                    }
+                }
+
+                if (ctx->subs != NULL) {
+                    rc = _oni_start_demux(ctx);
+                    if (rc) {
+                        _oni_stop_readahead(ctx);
+                        _oni_write_config(ctx, ONI_CONFIG_RUNNING, 0);
+                        ctx->run_state = IDLE;
+                        return rc;
+                    }
+                }
+
                 ctx->run_state = RUNNING;
-            else
+            } else {
                 ctx->run_state = IDLE;
+            }
+
+#ifdef __linux__
+            // Buffers were dumped
+            if (ctx->ready != NULL)
+                _oni_ready_refresh(ctx, ctx->ready);
+#endif
             break;
         }
         case ONI_OPT_RESET: {
@@ -412,13 +1663,30 @@ int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
 
             if (*(oni_reg_val_t *)value != 0) {
 
+                // Finish submitted register transactions
+                while (ctx->regs.active != ctx->regs.tail)
+                    _oni_progress_reg_ops(ctx);
+
+                uint64_t start = _oni_clock_ns();
                 int rc = _oni_write_config(
                     ctx, ONI_CONFIG_RESET, *(oni_reg_val_t*)value);
                 if (rc) return rc;
 
+                // NB: Configuration registers might have been cleared
+                ctx->regs.shadow_valid = 0;
+                ctx->regs.trig_unknown = 1;
+
+                // Devices and hubs might have changed
+                _oni_reg_cache_invalidate(ctx);
+
+                // Target times refer to the previous acquisition clock
+                _oni_sched_clear(ctx);
+
                 // Get device table etc
                 rc = _oni_reset_routine(ctx);
                 if (rc) return rc;
+
+                ctx->reset_ns = _oni_clock_ns() - start;
             }
 
             break;
@@ -436,6 +1704,9 @@ int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
                 int rc = _oni_write_config(
                     ctx, ONI_CONFIG_RESETACQCOUNTER, *(oni_reg_val_t *)value);
                 if (rc) return rc;
+
+                // Target times refer to the previous acquisition clock
+                _oni_sched_clear(ctx);
             }
 
             break;
@@ -513,15 +1784,35 @@ int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
         case ONI_OPT_ACQCLKHZ:
         case ONI_OPT_MAXREADFRAMESIZE:
         case ONI_OPT_MAXWRITEFRAMESIZE:
+        case ONI_OPT_FRAMEPOOLHITS:
+        case ONI_OPT_FRAMEPOOLMISSES:
+        case ONI_OPT_READPOOLEXHAUSTED:
+        case ONI_OPT_REGCACHEHITS:
+        case ONI_OPT_RESETTIMENS:
+        case ONI_OPT_EVENTSDROPPED:
+        case ONI_OPT_EVENTFD:
             return ONI_EREADONLY;
-        default: {
+        case ONI_OPT_READPOOLDEPTH: {
 
-            // Attempt to write to custom (outside ONI spec) configuration
-            // option
-            assert(ctx_opt >= ONI_OPT_CUSTOMBEGIN && "Invalid custom configuration register.");
-            if (ctx_opt < ONI_OPT_CUSTOMBEGIN)
-                return ONI_EPROTCONFIG;
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            // NB: Surplus blocks are freed as they are returned to the pool
+            ctx->pool->rblocks_depth = *(oni_size_t *)value;
+            break;
+        }
+        case ONI_OPT_WRITEPOOLDEPTH: {
+
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            // NB: Surplus blocks are freed as they are returned to the pool
+            ctx->pool->wblocks_depth = *(oni_size_t *)value;
+            break;
+        }
+        case ONI_OPT_WRITERDEPTH: {
 
+            // NB: Must not be changed while other threads queue frames
             assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
             if (ctx->run_state < IDLE)
                 return ONI_EINVALSTATE;
@@ -529,67 +1820,197 @@ int oni_set_opt(oni_ctx ctx, int ctx_opt, const void *value, size_t option_len)
             if (option_len != ONI_REGSZ)
                 return ONI_EBUFFERSIZE;
 
-            int rc = _oni_write_config(ctx,
-                                       ONI_CONFIG_CUSTOMBEGIN + (ctx_opt - ONI_OPT_CUSTOMBEGIN),
-                                       *(oni_reg_val_t *)value);
-            if (rc) return rc;
+            // NB: Triggers write on the reading thread
+            if (*(oni_size_t *)value != 0 && ctx->triggers != NULL)
+                return ONI_EINVALSTATE;
 
+            // Frames that are already queued are written first
+            _oni_stop_writer(ctx);
+
+            ctx->writer_depth = *(oni_size_t *)value;
+            if (ctx->writer_depth != 0) {
+                int rc = _oni_start_writer(ctx);
+                if (rc) {
+                    ctx->writer_depth = 0;
+                    return rc;
+                }
+            }
             break;
         }
-    }
+        case ONI_OPT_WRITERPOLICY: {
 
-    return ctx->driver.set_opt_callback(ctx->driver.ctx, ctx_opt, value, option_len);
-}
+            if (option_len != sizeof(int))
+                return ONI_EBUFFERSIZE;
 
-int oni_get_driver_opt(const oni_ctx ctx, int drv_opt, void* value, size_t *option_len)
-{
-    return ctx->driver.get_opt(ctx->driver.ctx, drv_opt, value, option_len);
-}
+            int policy = *(int *)value;
+            if (policy != ONI_WRITER_BLOCK && policy != ONI_WRITER_DROPOLDEST
+                && policy != ONI_WRITER_FAIL)
+                return ONI_EINVALARG;
 
-int oni_set_driver_opt(oni_ctx ctx, int drv_opt, const void* value, size_t option_len)
-{
-    return ctx->driver.set_opt(ctx->driver.ctx, drv_opt, value, option_len);
-}
+            ctx->writer_policy = policy;
+            break;
+        }
+        case ONI_OPT_WRITERSTATS:
+            return ONI_EREADONLY;
+        case ONI_OPT_SCHEDLEAD: {
 
-int oni_write_reg(const oni_ctx ctx,
-                  oni_dev_idx_t dev_idx,
-                  oni_reg_addr_t addr,
-                  oni_reg_val_t value)
-{
-    assert(ctx != NULL && "Context is NULL");
-    assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
+            if (option_len != sizeof(uint64_t))
+                return ONI_EBUFFERSIZE;
 
-    // Make sure we are not already in config triggered state
-    oni_reg_val_t trig = 0;
-    int rc = _oni_read_config(ctx, ONI_CONFIG_TRIG, &trig);
-    if (rc) return rc;
+            struct oni_sched_impl *s = ctx->sched;
+            _oni_mutex_lock(&s->mutex);
+            s->lead = *(uint64_t *)value;
+            _oni_atomic_store(&s->version, s->version + 1);
+            _oni_mutex_unlock(&s->mutex);
+            break;
+        }
+        case ONI_OPT_SCHEDSTATS:
+        case ONI_OPT_TRIGGERSTATS:
+            return ONI_EREADONLY;
+        case ONI_OPT_READRINGSIZE: {
 
-    if (trig != 0) return ONI_ERETRIG;
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
 
-    // Set config registers and trigger a write
-    rc = _oni_write_config(ctx, ONI_CONFIG_DEV_IDX, dev_idx);
-    if (rc) return rc;
-    rc = _oni_write_config(ctx, ONI_CONFIG_REG_ADDR, addr);
-    if (rc) return rc;
-    rc = _oni_write_config(ctx, ONI_CONFIG_REG_VALUE, value);
-    if (rc) return rc;
+            // NB: The read-ahead thread would compete with the ring for reads
+            if (ctx->reader != NULL)
+                return ONI_EINVALSTATE;
 
-    oni_reg_val_t rw = 1;
-    rc = _oni_write_config(ctx, ONI_CONFIG_RW, rw);
-    if (rc) return rc;
+#ifdef __linux__
+            // NB: The ring bypasses read-ahead, which provides readiness for
+            // drivers without a descriptor once ONI_OPT_EVENTFD has been handed
+            // out
+            if (*(oni_size_t *)value != 0 && ctx->ready != NULL
+                && ctx->ready->driver_fd < 0)
+                return ONI_EINVALSTATE;
+#else
+            if (*(oni_size_t *)value != 0)
+                return ONI_EUNIMPL;
+#endif
+            // NB: The ring is (re)created, or the block path resumed, on the
+            // next buffer refill. Unread data is carried over.
+            ctx->read_ring_size = *(oni_size_t *)value;
+            break;
+        }
+        case ONI_OPT_READAHEADDEPTH: {
 
-    trig = 1;
-    rc = _oni_write_config(ctx, ONI_CONFIG_TRIG, trig);
-    if (rc) return rc;
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
 
-    // Wait for response from hardware
-    oni_signal_t type;
-    rc = _oni_pump_signal_type(ctx, CONFIGWACK | CONFIGWNACK, &type);
-    if (rc) return rc;
+#ifdef __linux__
+            // NB: Read-ahead provides readiness for drivers without a
+            // descriptor once ONI_OPT_EVENTFD has been handed out
+            if (*(oni_size_t *)value == 0 && ctx->ready != NULL
+                && ctx->ready->driver_fd < 0)
+                return ONI_EINVALSTATE;
+#endif
+            // NB: Takes effect the next time RUNNING is set
+            ctx->read_ahead_depth = *(oni_size_t *)value;
+            break;
+        }
+        case ONI_OPT_READAHEADCPU: {
 
-    if (type == CONFIGWNACK) return ONI_EWRITEFAILURE;
+            if (option_len != sizeof(int))
+                return ONI_EBUFFERSIZE;
 
-    return ONI_ESUCCESS;
+#if !defined(_WIN32) && !defined(__linux__)
+            if (*(int *)value >= 0)
+                return ONI_EUNIMPL;
+#endif
+            // NB: Takes effect the next time RUNNING is set
+            ctx->read_ahead_cpu = *(int *)value;
+            break;
+        }
+        case ONI_OPT_READAHEADWAITING:
+            return ONI_EREADONLY;
+        case ONI_OPT_DEMUXCPU: {
+
+            if (option_len != sizeof(int))
+                return ONI_EBUFFERSIZE;
+
+#if !defined(_WIN32) && !defined(__linux__)
+            if (*(int *)value >= 0)
+                return ONI_EUNIMPL;
+#endif
+            // NB: Takes effect the next time RUNNING is set
+            ctx->demux_cpu = *(int *)value;
+            break;
+        }
+        case ONI_OPT_CONTROLTHREAD: {
+
+            // NB: Must not be changed while other threads use the context
+            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
+            if (ctx->run_state < IDLE)
+                return ONI_EINVALSTATE;
+
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            if (*(oni_size_t *)value && ctx->control == NULL) {
+                int rc = _oni_start_control(ctx);
+                if (rc) return rc;
+            } else if (!*(oni_size_t *)value) {
+                _oni_stop_control(ctx);
+            }
+
+            break;
+        }
+        default: {
+
+            // Attempt to write to custom (outside ONI spec) configuration
+            // option
+            assert(ctx_opt >= ONI_OPT_CUSTOMBEGIN && "Invalid custom configuration register.");
+            if (ctx_opt < ONI_OPT_CUSTOMBEGIN)
+                return ONI_EPROTCONFIG;
+
+            assert(ctx->run_state > UNINITIALIZED && "Context state must be IDLE or RUNNING.");
+            if (ctx->run_state < IDLE)
+                return ONI_EINVALSTATE;
+
+            if (option_len != ONI_REGSZ)
+                return ONI_EBUFFERSIZE;
+
+            int rc = _oni_write_config(ctx,
+                                       ONI_CONFIG_CUSTOMBEGIN + (ctx_opt - ONI_OPT_CUSTOMBEGIN),
+                                       *(oni_reg_val_t *)value);
+            if (rc) return rc;
+
+            break;
+        }
+    }
+
+    return ctx->driver.set_opt_callback(ctx->driver.ctx, ctx_opt, value, option_len);
+}
+
+int oni_get_driver_opt(const oni_ctx ctx, int drv_opt, void* value, size_t *option_len)
+{
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_get_driver_opt, drv_opt, value, NULL, 0, option_len);
+
+    return ctx->driver.get_opt(ctx->driver.ctx, drv_opt, value, option_len);
+}
+
+int oni_set_driver_opt(oni_ctx ctx, int drv_opt, const void* value, size_t option_len)
+{
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_set_driver_opt, drv_opt, NULL, value, option_len, NULL);
+
+    return ctx->driver.set_opt(ctx->driver.ctx, drv_opt, value, option_len);
+}
+
+int oni_write_reg(const oni_ctx ctx,
+                  oni_dev_idx_t dev_idx,
+                  oni_reg_addr_t addr,
+                  oni_reg_val_t value)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
+
+    oni_reg_op_t op = {dev_idx, addr, value, 1, ONI_ESUCCESS, 0};
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_run_reg_op, 0, &op, NULL, 0, NULL);
+
+    return _oni_run_reg_op(ctx, &op);
 }
 
 int oni_read_reg(const oni_ctx ctx,
@@ -600,37 +2021,271 @@ int oni_read_reg(const oni_ctx ctx,
     assert(ctx != NULL && "Context is NULL");
     assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
 
-    // Make sure we are not already in config triggered state
-    oni_reg_val_t trig = 0;
-    int rc = _oni_read_config(ctx, ONI_CONFIG_TRIG, &trig);
+    oni_reg_op_t op = {dev_idx, addr, 0, 0, ONI_ESUCCESS, 0};
+    int rc = _oni_control_redirect(ctx)
+        ? _oni_control_call(ctx, _oni_call_run_reg_op, 0, &op, NULL, 0, NULL)
+        : _oni_run_reg_op(ctx, &op);
     if (rc) return rc;
 
-    if (trig != 0) return ONI_ERETRIG;
+    *value = op.value;
 
-    // Set configuration registers and trigger a write
-    rc = _oni_write_config(ctx, ONI_CONFIG_DEV_IDX, dev_idx);
-    if (rc) return rc;
-    rc = _oni_write_config(ctx, ONI_CONFIG_REG_ADDR, addr);
-    if (rc) return rc;
+    return ONI_ESUCCESS;
+}
 
-    oni_reg_val_t rw = 0;
-    rc = _oni_write_config(ctx, ONI_CONFIG_RW, rw);
-    if (rc) return rc;
+// Writes num_ops device registers in order. The status of each op is filled
+// in, and the write and latency_ns fields are ignored. If the driver supports
+// it, writes are handed to it in batches so that it can send them in a single
+// transfer. A rejected write does not prevent the remaining ones. Returns the
+// first error. NB: If the error is not ONI_EWRITEFAILURE, the ops that follow
+// the failing one are not written and their status is not set.
+int oni_write_regs(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
 
-    trig = 1;
-    rc = _oni_write_config(ctx, ONI_CONFIG_TRIG, trig);
-    if (rc) return rc;
+    if (ops == NULL && num_ops > 0)
+        return ONI_EINVALARG;
 
-    // Wait for response from hardware
-    oni_signal_t type;
-    rc = _oni_pump_signal_type(ctx, CONFIGRACK | CONFIGRNACK, &type);
-    if (rc) return rc;
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_write_regs, 0, ops, NULL, num_ops, NULL);
+
+    if (ctx->driver.config_batch != NULL)
+        return _oni_write_regs_batch(ctx, ops, num_ops);
+
+    int rc = ONI_ESUCCESS;
+    size_t i;
+    for (i = 0; i < num_ops; i++) {
+
+        oni_reg_op_t op = {ops[i].dev_idx, ops[i].addr, ops[i].value, 1, ONI_ESUCCESS, 0};
+        ops[i].status = _oni_run_reg_op(ctx, &op);
+        if (ops[i].status == ONI_EWRITEFAILURE) {
+            if (rc == ONI_ESUCCESS) rc = ops[i].status;
+        } else if (ops[i].status) {
+            return ops[i].status;
+        }
+    }
+
+    return rc;
+}
+
+// Reads num_ops device registers in order. The value and status of each op
+// are filled in, and the write and latency_ns fields are ignored. A rejected
+// read does not prevent the remaining ones. Returns the first error. NB: If the
+// error is not ONI_EREADFAILURE, the ops that follow the failing one are not
+// read and their status is not set.
+int oni_read_regs(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
+
+    if (ops == NULL && num_ops > 0)
+        return ONI_EINVALARG;
+
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_read_regs, 0, ops, NULL, num_ops, NULL);
+
+    int rc = ONI_ESUCCESS;
+    size_t i;
+    for (i = 0; i < num_ops; i++) {
+
+        ops[i].write = 0;
+        ops[i].latency_ns = 0;
+        ops[i].status = _oni_run_reg_op(ctx, &ops[i]);
+        if (ops[i].status == ONI_EREADFAILURE) {
+            if (rc == ONI_ESUCCESS) rc = ops[i].status;
+        } else if (ops[i].status) {
+            return ops[i].status;
+        }
+    }
+
+    return rc;
+}
+
+// Sets how accesses to a device register are cached (ONI_REGCACHE_*). Cached
+// values are discarded by ONI_OPT_RESET, but modes are kept. The hub
+// information registers (ONIX_HUB_DEV_IDX) are ONI_REGCACHE_IMMUTABLE unless
+// set otherwise. Only oni_read_reg(s) and oni_write_reg(s) use the cache;
+// transactions submitted using oni_submit_reg_ops always go to hardware but
+// keep it up to date.
+int oni_set_reg_cache(oni_ctx ctx, oni_dev_idx_t dev_idx, oni_reg_addr_t addr, int mode)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (mode < ONI_REGCACHE_NONE || mode > ONI_REGCACHE_HOSTOWNED)
+        return ONI_EINVALARG;
+
+    if (_oni_control_redirect(ctx)) {
+        oni_reg_op_t op = {dev_idx, addr, 0, 0, ONI_ESUCCESS, 0};
+        return _oni_control_call(ctx, _oni_call_set_reg_cache, mode, NULL, &op, 0, NULL);
+    }
+
+    struct oni_reg_cache_entry *entry = _oni_reg_cache_find(ctx, dev_idx, addr, 1);
+    if (entry == NULL)
+        return ONI_EBADALLOC;
+
+    if (entry->mode != mode) {
+        entry->mode = mode;
+        entry->valid = 0;
+    }
+
+    return ONI_ESUCCESS;
+}
+
+// Submits num_ops register transactions, which are carried out in order. Each
+// transaction is started as soon as the previous one is acknowledged, without
+// waiting for the caller. ops must remain valid until they are returned by
+// oni_poll_reg_completions.
+int oni_submit_reg_ops(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state > UNINITIALIZED && "Context must be INITIALIZED.");
+
+    if (ctx->run_state < IDLE)
+        return ONI_EINVALSTATE;
+
+    if (ops == NULL || num_ops == 0)
+        return ONI_EINVALARG;
+
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_submit_reg_ops, 0, ops, NULL, num_ops, NULL);
+
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    // Grow the ring, preserving the order of queued transactions
+    size_t count = rq->tail - rq->head;
+    if (count + num_ops > rq->capacity) {
+
+        size_t capacity = rq->capacity ? rq->capacity : ONI_REGQUEUEDEPTH;
+        while (capacity < count + num_ops)
+            capacity <<= 1;
+
+        oni_reg_op_t **temp = malloc(capacity * sizeof(oni_reg_op_t *));
+        if (!temp)
+            return ONI_EBADALLOC;
+
+        size_t i;
+        for (i = 0; i < count; i++)
+            temp[i] = rq->ops[(rq->head + i) & (rq->capacity - 1)];
+
+        free(rq->ops);
+        rq->ops = temp;
+        rq->capacity = capacity;
+        rq->active -= rq->head;
+        rq->tail = count;
+        rq->head = 0;
+    }
+
+    int idle = rq->active == rq->tail;
+
+    // NB: latency_ns holds the submission time until completion
+    uint64_t now = _oni_clock_ns();
+    size_t i;
+    for (i = 0; i < num_ops; i++) {
+        ops[i].status = ONI_ESUCCESS;
+        ops[i].latency_ns = now;
+        rq->ops[rq->tail++ & (rq->capacity - 1)] = &ops[i];
+    }
+
+    if (idle)
+        _oni_start_queued_reg_op(ctx);
+
+    return ONI_ESUCCESS;
+}
+
+// Returns up to max_n completed register transactions in submission order. If
+// block is non-zero, waits until at least one transaction has completed
+// unless none are outstanding. Otherwise, only transactions whose
+// acknowledgments have already been received are completed.
+int oni_poll_reg_completions(const oni_ctx ctx,
+                             oni_reg_op_t **ops,
+                             size_t max_n,
+                             int block)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (ops == NULL || max_n == 0 || max_n > INT_MAX)
+        return ONI_EINVALARG;
+
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_poll_reg_completions, block, ops, NULL, max_n, NULL);
+
+    struct oni_reg_queue *rq = &ctx->regs;
+    size_t n = 0;
+
+    while (n < max_n) {
+
+        if (rq->head != rq->active) {
+            ops[n++] = rq->ops[rq->head++ & (rq->capacity - 1)];
+            continue;
+        }
 
-    if (type == CONFIGRNACK) return ONI_EREADFAILURE;
+        // Nothing in progress
+        if (rq->active == rq->tail)
+            break;
+
+        oni_reg_op_t *op = rq->ops[rq->active & (rq->capacity - 1)];
+        if ((n > 0 || !block) && !_oni_signal_ready(ctx, _oni_reg_op_signals(op)))
+            break;
+
+        _oni_progress_reg_ops(ctx);
+    }
+
+    return (int)n;
+}
+
+// Copies up to max_n hardware events, oldest first, into events and returns
+// their number. Never blocks: only signals that have already been received
+// are examined, so events are best polled often or delivered to a callback
+// set with oni_set_event_callback. Returns ONI_EUNIMPL if the driver can
+// neither report readable signal bytes nor provide a signal stream
+// descriptor. With such drivers, events are only found while signals are read
+// for register access and resets, so use a callback instead.
+int oni_poll_event(const oni_ctx ctx, oni_event_t *events, size_t max_n)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (events == NULL || max_n == 0 || max_n > INT_MAX)
+        return ONI_EINVALARG;
 
-    rc = _oni_read_config(ctx, ONI_CONFIG_REG_VALUE, value);
+    if (_oni_control_redirect(ctx))
+        return _oni_control_call(ctx, _oni_call_poll_event, 0, events, NULL, max_n, NULL);
+
+    int rc = _oni_pump_signals(ctx);
     if (rc) return rc;
 
+    struct oni_event_queue *eq = ctx->events;
+    size_t n = 0;
+    while (n < max_n && eq->head != eq->tail)
+        events[n++] = eq->events[eq->head++ % ONI_EVENTQUEUEDEPTH];
+
+    return (int)n;
+}
+
+// Delivers hardware events to callback, or to the queue read by
+// oni_poll_event if callback is NULL. The callback is invoked by whichever
+// thread reads the signal stream, during register access, resets, or event
+// polling, or by the control thread within ONI_EVENTPOLLNS of arrival if it
+// is running and the driver can tell whether signals have been received (see
+// oni_poll_event). It must not call back into liboni.
+int oni_set_event_callback(oni_ctx ctx, oni_event_cb_t callback, void *user)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (_oni_control_redirect(ctx)) {
+        struct oni_event_handler handler = {callback, user};
+        return _oni_control_call(ctx, _oni_call_set_event_callback, 0, NULL, &handler, 0, NULL);
+    }
+
+    struct oni_event_queue *eq = ctx->events;
+    eq->handler.callback = callback;
+    eq->handler.user = user;
+
+    // Events that were queued before the callback was set
+    if (callback != NULL) {
+        while (eq->head != eq->tail)
+            callback(&eq->events[eq->head++ % ONI_EVENTQUEUEDEPTH], user);
+    }
+
     return ONI_ESUCCESS;
 }
 
@@ -648,6 +2303,10 @@ int oni_read_frame(const oni_ctx ctx, oni_frame_t **frame)
     // a different thread
     assert(ctx->run_state >= IDLE && "Context is not acquiring.");
 
+    // NB: Frames are being delivered to subscriptions instead
+    if (ctx->demux != NULL)
+        return ONI_EINVALSTATE;
+
     // Get the device index and data size from the buffer
     // TODO: what is the point of having an oni_fifo_t if we are hard coding the header size anyway?
     int rc = _oni_ensure_read_buffer(ctx);
@@ -659,8 +2318,8 @@ int oni_read_frame(const oni_ctx ctx, oni_frame_t **frame)
     uint8_t *header = ctx->shared_rbuf->read_pos;
     ctx->shared_rbuf->read_pos += ONI_RFRAMEHEADERSZ;
 
-    // Allocate frame and buffer
-    oni_frame_impl_t *iframe = malloc(sizeof(oni_frame_impl_t));
+    // Get frame descriptor from pool
+    oni_frame_impl_t *iframe = _oni_acquire_frame(ctx->pool, &ctx->pool->rcache);
     if (!iframe)
         return ONI_EBADALLOC;
 
@@ -678,8 +2337,13 @@ int oni_read_frame(const oni_ctx ctx, oni_frame_t **frame)
     // TODO: max_read_frame_size contains the header as well so the upper bound
     // check is too relaxed.
     if (iframe->private.f.data_sz == 0
-        || iframe->private.f.data_sz > ctx->max_read_frame_size)
+        || iframe->private.f.data_sz > ctx->max_read_frame_size) {
+
+        // Put the unused descriptor back
+        iframe->next = ctx->pool->rcache.free;
+        ctx->pool->rcache.free = iframe;
         return ONI_EBADFRAME;
+    }
 
     // Find read size (+ padding)
     // TODO:https://github.com/open-ephys/ONI/issues/3
@@ -700,591 +2364,3067 @@ int oni_read_frame(const oni_ctx ctx, oni_frame_t **frame)
     // Public portion of frame
     *frame = &iframe->public;
 
+    _oni_sched_advance(ctx, iframe->private.f.time);
+    _oni_ready_update(ctx);
+
     // Size of public portion of frame
     return total_size;
 }
 
-// NB : Multiframe writes are allowed as long as data_sz is a multiple of
-// a single write frame's size.
-int oni_create_frame(const oni_ctx ctx,
-                     oni_frame_t **frame,
-                     oni_dev_idx_t dev_idx,
-                     void *data,
-                     size_t data_sz)
+// Borrows the next frame without allocating a descriptor or taking a buffer
+// reference. The view is invalidated by the next read of any kind on ctx
+// unless it is first promoted using oni_promote_frame_view.
+int oni_next_frame_view(const oni_ctx ctx, oni_frame_view_t *view)
 {
     assert(ctx != NULL && "Context is NULL");
-
-    // NB: We don't need run_state == RUNNING because this could be changed in
-    // a different thread
     assert(ctx->run_state >= IDLE && "Context is not acquiring.");
 
-    // Get the device hash index
-    int i = _oni_hash32_find(ctx, dev_idx);
-    if (i < 0) return ONI_EDEVIDX;
-
-    // Check that the devices accepts data
-    if (ctx->dev_hash_table[i].write_size == 0)
-        return ONI_ENOTWRITEDEV;
-
-    // Check that data_sz is a multiple of write_size
-    if (data_sz % ctx->dev_hash_table[i].write_size != 0)
-        return ONI_EWRITESIZE;
+    if (view == NULL)
+        return ONI_EINVALARG;
 
-    // Allocate frame and buffer
-    oni_frame_impl_t *iframe = malloc(sizeof(oni_frame_impl_t));
-    if (!iframe)
-        return ONI_EBADALLOC;
+    if (ctx->demux != NULL)
+        return ONI_EINVALSTATE;
 
-    // Total frame size
-    int total_size = sizeof(oni_frame_t);
+    int rc = _oni_next_frame_view(ctx, view);
+    _oni_ready_update(ctx);
 
-    // Pad if needed
-    size_t asize = data_sz;
-    asize += asize % sizeof(oni_fifo_dat_t);
-    total_size += asize;
+    return rc;
+}
 
-    // Allocate data storage
-    char *buffer_start = NULL;
-    int rc = _oni_alloc_write_buffer(ctx, (void **)&buffer_start, ONI_WFRAMEHEADERSZ + asize);
-    if (rc) return rc;
+// Converts a view that is still valid into an owned frame that must be
+// released using oni_destroy_frame
+int oni_promote_frame_view(const oni_ctx ctx,
+                           const oni_frame_view_t *view,
+                           oni_frame_t **frame)
+{
+    assert(ctx != NULL && "Context is NULL");
 
-    // Fill out public fields
-    // NB: https://stackoverflow.com/questions/9691404/how-to-initialize-const-in-a-struct-in-c-with-malloc
-    *(oni_size_t *)&iframe->private.f.dev_idx = dev_idx;
-    *(oni_size_t *)&iframe->private.f.data_sz = data_sz;
-    iframe->private.f.data = buffer_start + ONI_WFRAMEHEADERSZ;
+    if (view == NULL || view->buffer == NULL || frame == NULL)
+        return ONI_EINVALARG;
 
-    // Copy frame header members into start of continuous buffer, before data
-    // 0. index (4)
-    // 1. data_sz (4)
-    *((oni_fifo_dat_t *)buffer_start + 0) = iframe->private.f.dev_idx;
-    *((oni_fifo_dat_t *)buffer_start + 1) = iframe->private.f.data_sz >> BYTE_TO_FIFO_SHIFT;
+    oni_frame_impl_t *iframe = _oni_acquire_frame(ctx->pool, &ctx->pool->rcache);
+    if (!iframe)
+        return ONI_EBADALLOC;
 
-    // Copy data into frame
-    memcpy(iframe->private.f.data, data, data_sz);
+    memcpy((void *)&iframe->private.f.time, &view->time, ONI_RFRAMEHEADERSZ);
+    iframe->private.f.data = (char *)view->data;
 
-    // Update buffer ref count and provide reference to frame
-    _ref_inc(&(ctx->shared_wbuf->count));
-    iframe->private.buffer = ctx->shared_wbuf;
+    // The view's buffer is kept alive by the context until the next read, so
+    // it is safe to take a reference to it here
+    iframe->private.buffer = view->buffer;
+    _ref_inc(&(iframe->private.buffer->count));
 
-    // Public portion of frame
     *frame = &iframe->public;
 
-    // Size of public portion of frame
-    return total_size;
+    return ONI_ESUCCESS;
 }
 
-int oni_write_frame(const oni_ctx ctx, const oni_frame_t *frame)
+// Reads as many as max_n frames that are already present in the current read
+// buffer. Only the first frame may block on the driver. The frames share one
+// descriptor allocation and one buffer reference and must be released
+// together using oni_destroy_frames.
+int oni_read_frames(const oni_ctx ctx, oni_frame_t **frames, size_t max_n)
 {
     assert(ctx != NULL && "Context is NULL");
-
-    // NB: We don't need run_state == RUNNING because this could be changed in
-    // a different thread
     assert(ctx->run_state >= IDLE && "Context is not acquiring.");
 
-    // Write the frame
-    oni_frame_impl_t *iframe = (oni_frame_impl_t *)frame;
+    if (frames == NULL || max_n == 0)
+        return ONI_EINVALARG;
 
-    // Continuous frame starts ONI_WFRAMEHEADERSZ back in shared buffer
-    size_t wsize = iframe->private.f.data_sz + ONI_WFRAMEHEADERSZ;
-    int rc = _oni_write(ctx, ONI_WRITE_STREAM_DATA, iframe->private.f.data - ONI_WFRAMEHEADERSZ, wsize);
-    if (rc != (int)wsize) return ONI_EWRITEFAILURE;
+    if (ctx->demux != NULL)
+        return ONI_EINVALSTATE;
+
+    int rc = _oni_ensure_read_buffer(ctx);
+    if (rc) return rc;
+
+    struct oni_buf_impl *buffer = ctx->shared_rbuf;
+
+    // Index the complete frames available in the current buffer in chunks
+    // and copy their headers into the batch
+    oni_frame_index_t index[ONI_INDEXCHUNK];
+    struct oni_frame_batch *batch = NULL;
+    uint8_t *pos = buffer->read_pos;
+    size_t n = 0;
+
+    while (n < max_n) {
+
+        size_t chunk = max_n - n < ONI_INDEXCHUNK ? max_n - n : ONI_INDEXCHUNK;
+        size_t k = ctx->index_block(
+            pos, buffer->end_pos, ctx->max_read_frame_size, index, chunk);
+        if (k == 0)
+            break;
+
+        struct oni_frame_batch *temp = realloc(
+            batch, sizeof(struct oni_frame_batch) + (n + k) * sizeof(struct oni_batch_frame));
+        if (!temp) {
+            free(batch);
+            return ONI_EBADALLOC;
+        }
+        batch = temp;
+
+        size_t i;
+        for (i = 0; i < k; i++) {
+            oni_frame_t *frame = &batch->frames[n + i].frame.private.f;
+
+            // Copy frame header members (continuous)
+            memcpy((void *)&frame->time, &index[i].time, ONI_RFRAMEHEADERSZ);
+
+            // Direct frame data's view into the pre-collected buffer
+            frame->data = (char *)pos + index[i].offset + ONI_RFRAMEHEADERSZ;
+        }
+
+        pos += index[k - 1].offset + index[k - 1].size;
+        n += k;
+
+        // Incomplete or malformed frame
+        if (k < chunk)
+            break;
+    }
+
+    // NB: Same behavior as oni_read_frame, the bad header is consumed
+    if (n == 0) {
+        buffer->read_pos += ONI_RFRAMEHEADERSZ;
+        return ONI_EBADFRAME;
+    }
+
+    buffer->read_pos = pos;
+
+    size_t i;
+    for (i = 0; i < n; i++) {
+        batch->frames[i].frame.private.buffer = NULL;
+        batch->frames[i].batch = batch;
+        frames[i] = &batch->frames[i].frame.public;
+    }
+
+    // One buffer reference for the whole batch
+    _ref_inc(&(buffer->count));
+    batch->buffer = buffer;
+
+    _oni_sched_advance(ctx, frames[n - 1]->time);
+    _oni_ready_update(ctx);
+
+    return (int)n;
+}
+
+// Allocates a column for each of num_devs devices that holds up to capacity
+// samples. The stride of each column is the device's read size and its
+// arrays are aligned for vector access. Columns must be released using
+// oni_destroy_columns.
+int oni_create_columns(const oni_ctx ctx,
+                       oni_column_t *cols,
+                       const oni_dev_idx_t *dev_idxs,
+                       size_t num_devs,
+                       size_t capacity)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (ctx->run_state < IDLE)
+        return ONI_EINVALSTATE;
+
+    if (cols == NULL || dev_idxs == NULL || num_devs == 0 || capacity == 0)
+        return ONI_EINVALARG;
+
+    memset(cols, 0, num_devs * sizeof(oni_column_t));
+
+    size_t i;
+    for (i = 0; i < num_devs; i++) {
+
+        int slot = _oni_dev_find(ctx, dev_idxs[i]);
+        if (slot < 0) {
+            oni_destroy_columns(cols, i);
+            return ONI_EDEVIDX;
+        }
+
+        oni_column_t *col = &cols[i];
+        col->dev_idx = dev_idxs[i];
+        col->stride = ctx->dev_table[slot].read_size;
+
+        if (col->stride == 0) {
+            oni_destroy_columns(cols, i);
+            return ONI_ENOREADDEV;
+        }
+
+        col->time = _oni_alloc_aligned(capacity * sizeof(oni_fifo_time_t), ONI_COLUMNALIGN);
+        col->data = _oni_alloc_aligned(capacity * col->stride, ONI_COLUMNALIGN);
+        if (!col->time || !col->data) {
+            oni_destroy_columns(cols, i + 1);
+            return ONI_EBADALLOC;
+        }
+
+        col->capacity = capacity;
+    }
+
+    return ONI_ESUCCESS;
+}
+
+// Reads up to max_n frames and stores the time and data of each frame from a
+// device in cols in the next row of that device's column. Frames from other
+// devices are discarded. Reading continues across read blocks, blocking if
+// required, and stops early, without consuming the frame, when a frame's
+// column is full. Columns may be provided by the caller or allocated using
+// oni_create_columns. On return, num_samples holds the number of samples
+// stored in each column. Returns the number of frames consumed.
+int oni_read_columns(const oni_ctx ctx,
+                     oni_column_t *cols,
+                     size_t num_cols,
+                     size_t max_n)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state >= IDLE && "Context is not acquiring.");
+
+    if (cols == NULL || num_cols == 0 || max_n == 0 || max_n > INT_MAX)
+        return ONI_EINVALARG;
+
+    if (ctx->demux != NULL)
+        return ONI_EINVALSTATE;
+
+    // Column for each device table entry, or -1
+    int *routes = ctx->col_routes;
+
+    size_t i;
+    for (i = 0; i < num_cols; i++) {
+
+        oni_column_t *col = &cols[i];
+        int slot = _oni_dev_find(ctx, col->dev_idx);
+        if (slot < 0 || routes[slot] >= 0
+            || (col->capacity > 0 && (col->time == NULL || col->data == NULL))) {
+            _oni_clear_col_routes(ctx, cols, i);
+            return slot < 0 ? ONI_EDEVIDX : ONI_EINVALARG;
+        }
+
+        routes[slot] = (int)i;
+        col->num_samples = 0;
+    }
+
+    oni_frame_index_t index[ONI_INDEXCHUNK];
+    oni_fifo_time_t last_time = 0;
+    size_t n = 0;
+    int rc = ONI_ESUCCESS;
+
+    while (n < max_n) {
+
+        rc = _oni_ensure_read_buffer(ctx);
+        if (rc) break;
+
+        // NB: The read buffer always holds at least one maximum size frame
+        // here, so finding no frame means that the header is malformed
+        struct oni_buf_impl *buffer = ctx->shared_rbuf;
+        size_t chunk = max_n - n < ONI_INDEXCHUNK ? max_n - n : ONI_INDEXCHUNK;
+        size_t k = ctx->index_block(
+            buffer->read_pos, buffer->end_pos, ctx->max_read_frame_size, index, chunk);
+        if (k == 0) {
+
+            // NB: Same behavior as oni_read_frame, the bad header is
+            // consumed, but only once the frames before it are returned
+            if (n == 0) {
+                buffer->read_pos += ONI_RFRAMEHEADERSZ;
+                rc = ONI_EBADFRAME;
+            }
+            break;
+        }
+
+        // Scatter frames into their columns
+        for (i = 0; i < k; i++) {
+
+            const oni_frame_index_t *entry = &index[i];
+            int slot = _oni_dev_find(ctx, entry->dev_idx);
+            if (slot < 0 || routes[slot] < 0)
+                continue;
+
+            oni_column_t *col = &cols[routes[slot]];
+            if (col->num_samples == col->capacity)
+                break;
+
+            if (entry->data_sz > col->stride) {
+                if (n + i == 0)
+                    rc = ONI_EBUFFERSIZE;
+                break;
+            }
+
+            col->time[col->num_samples] = entry->time;
+            memcpy(col->data + col->num_samples * col->stride,
+                   buffer->read_pos + entry->offset + ONI_RFRAMEHEADERSZ,
+                   entry->data_sz);
+            col->num_samples++;
+        }
+
+        buffer->read_pos += i < k ? index[i].offset
+                                  : index[k - 1].offset + index[k - 1].size;
+        n += i;
+        if (i > 0)
+            last_time = index[i - 1].time;
+
+        // Column is full or too narrow
+        if (i < k)
+            break;
+    }
+
+    _oni_clear_col_routes(ctx, cols, num_cols);
+
+    if (n > 0)
+        _oni_sched_advance(ctx, last_time);
+    _oni_ready_update(ctx);
+
+    if (n == 0 && rc)
+        return rc;
+
+    return (int)n;
+}
+
+// Restores the column routes set for the first num_cols columns
+static void _oni_clear_col_routes(oni_ctx ctx, const oni_column_t *cols, size_t num_cols)
+{
+    size_t i;
+    for (i = 0; i < num_cols; i++)
+        ctx->col_routes[_oni_dev_find(ctx, cols[i].dev_idx)] = -1;
+}
+
+// NB : Multiframe writes are allowed as long as data_sz is a multiple of
+// a single write frame's size. Write frames can be created on any thread.
+int oni_create_frame(const oni_ctx ctx,
+                     oni_frame_t **frame,
+                     oni_dev_idx_t dev_idx,
+                     void *data,
+                     size_t data_sz)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    // NB: We don't need run_state == RUNNING because this could be changed in
+    // a different thread
+    assert(ctx->run_state >= IDLE && "Context is not acquiring.");
+
+    oni_frame_impl_t *iframe = NULL;
+    int total_size = _oni_create_write_frame(ctx, &iframe, dev_idx, data_sz);
+    if (total_size < 0) return total_size;
+
+    // Copy data into frame
+    memcpy(iframe->private.f.data, data, data_sz);
+
+    // Public portion of frame
+    *frame = &iframe->public;
+
+    // Size of public portion of frame
+    return total_size;
+}
+
+// Creates a write frame whose data is zeroed so that it can be filled in
+// place. The header is written once, so the frame can be filled and passed
+// to oni_write_frame any number of times without any allocation, device
+// lookup or copy. It must be released using oni_destroy_frame.
+int oni_create_write_frame(const oni_ctx ctx,
+                           oni_frame_t **frame,
+                           oni_dev_idx_t dev_idx,
+                           size_t data_sz)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state >= IDLE && "Context is not acquiring.");
+
+    if (frame == NULL)
+        return ONI_EINVALARG;
+
+    oni_frame_impl_t *iframe = NULL;
+    int total_size = _oni_create_write_frame(ctx, &iframe, dev_idx, data_sz);
+    if (total_size < 0) return total_size;
+
+    memset(iframe->private.f.data, 0, data_sz);
+
+    *frame = &iframe->public;
+
+    return total_size;
+}
+
+// Writes num_frames frames in order. Frames that are contiguous in memory,
+// which is the case for frames created one after the other on the same
+// context, are coalesced into a single driver write of at most
+// block_write_size bytes. Returns the number of frames written. If a driver
+// write fails, the frames before it have been written and their number is
+// returned, or ONI_EWRITEFAILURE if there are none.
+int oni_write_frames(const oni_ctx ctx, const oni_frame_t **frames, size_t num_frames)
+{
+    assert(ctx != NULL && "Context is NULL");
+    assert(ctx->run_state >= IDLE && "Context is not acquiring.");
+
+    if (frames == NULL || num_frames == 0 || num_frames > INT_MAX)
+        return ONI_EINVALARG;
+
+    // NB: Frames are being written by the asynchronous writer instead
+    if (ctx->writer != NULL)
+        return ONI_EINVALSTATE;
+
+    return _oni_write_frames(ctx, frames, num_frames);
+}
+
+// Passes frame to the asynchronous writer (ONI_OPT_WRITERDEPTH), which writes
+// it and then destroys it. If the queue is full, the writer's policy
+// (ONI_OPT_WRITERPOLICY) applies. Unless ONI_EQUEUEFULL or another error is
+// returned, the frame is owned by the writer and must not be used by the
+// caller anymore. Any thread can queue frames.
+int oni_queue_frame(const oni_ctx ctx, oni_frame_t *frame)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (frame == NULL)
+        return ONI_EINVALARG;
+
+    struct oni_writer_impl *w = ctx->writer;
+    if (w == NULL)
+        return ONI_EINVALSTATE;
+
+    while (_oni_writer_push(w, frame)) {
+
+        switch (ctx->writer_policy) {
+            case ONI_WRITER_FAIL:
+                return ONI_EQUEUEFULL;
+            case ONI_WRITER_DROPOLDEST: {
+                uint64_t queued_ns;
+                oni_frame_t *oldest = _oni_writer_pop(w, &queued_ns);
+                if (oldest != NULL) {
+                    oni_destroy_frame(oldest);
+                    _oni_mutex_lock(&w->mutex);
+                    w->dropped++;
+                    _oni_mutex_unlock(&w->mutex);
+                }
+                break;
+            }
+            default: {
+                // Sleep until the writer has made room
+                _oni_mutex_lock(&w->mutex);
+                _oni_atomic_store(&w->producers_waiting, w->producers_waiting + 1);
+                while (_oni_writer_full(w) && !_oni_atomic_load(&w->stop))
+                    _oni_cond_wait(&w->cond, &w->mutex);
+                _oni_atomic_store(&w->producers_waiting, w->producers_waiting - 1);
+                _oni_mutex_unlock(&w->mutex);
+
+                if (_oni_atomic_load(&w->stop))
+                    return ONI_EINVALSTATE;
+                break;
+            }
+        }
+    }
+
+    if (_oni_atomic_load(&w->writer_waiting)) {
+        _oni_mutex_lock(&w->mutex);
+        _oni_cond_broadcast(&w->cond);
+        _oni_mutex_unlock(&w->mutex);
+    }
+
+    return ONI_ESUCCESS;
+}
+
+// Passes frame to the output scheduler, which writes it once the acquisition
+// time of the frames being read is within ONI_OPT_SCHEDLEAD ticks of time, and
+// then destroys it. Frames are written by the thread that reads frames (or the
+// demultiplexer), through the asynchronous writer if there is one. Without it,
+// no other thread may write frames at the same time. Unless an error is
+// returned, the frame is owned by the scheduler and must not be used by the
+// caller anymore. Any thread can create and schedule frames.
+int oni_schedule_frame(const oni_ctx ctx, oni_frame_t *frame, oni_fifo_time_t time)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (frame == NULL)
+        return ONI_EINVALARG;
+
+    struct oni_sched_impl *s = ctx->sched;
+    _oni_mutex_lock(&s->mutex);
+
+    if (s->count == s->capacity) {
+        size_t capacity = s->capacity ? 2 * s->capacity : ONI_SCHEDCAPACITY;
+        struct oni_sched_entry *heap
+            = realloc(s->heap, capacity * sizeof(struct oni_sched_entry));
+        if (!heap) {
+            _oni_mutex_unlock(&s->mutex);
+            return ONI_EBADALLOC;
+        }
+        s->heap = heap;
+        s->capacity = capacity;
+    }
+
+    // Sift up
+    struct oni_sched_entry entry = {time, s->next_seq++, frame};
+    size_t i = s->count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s->heap[parent].time <= time)
+            break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i] = entry;
+
+    if (s->count > s->max_pending)
+        s->max_pending = s->count;
+
+    _oni_atomic_store(&s->version, s->version + 1);
+    _oni_mutex_unlock(&s->mutex);
+
+    return ONI_ESUCCESS;
+}
+
+// Writes frames in order, coalescing contiguous frames, see oni_write_frames.
+// Returns the number of frames written, which is less than num_frames if a
+// driver write failed, or ONI_EWRITEFAILURE if none was written.
+static int _oni_write_frames(oni_ctx ctx, const oni_frame_t **frames, size_t num_frames)
+{
+    const char *run = NULL; // Start of the pending write
+    size_t run_size = 0;
+    size_t first = 0; // First frame of the pending write
+    size_t i;
+
+    for (i = 0; i <= num_frames; i++) {
+
+        const char *start = NULL;
+        size_t wsize = 0;
+        if (i < num_frames) {
+            start = frames[i]->data - ONI_WFRAMEHEADERSZ;
+            wsize = frames[i]->data_sz + ONI_WFRAMEHEADERSZ;
+        }
+
+        if (run != NULL && (i == num_frames || start != run + run_size
+                            || run_size + wsize > ctx->block_write_size)) {
+
+            int rc = _oni_write(ctx, ONI_WRITE_STREAM_DATA, run, run_size);
+            if (rc != (int)run_size) {
+
+                // Frames of the run that the driver took in full
+                size_t written = rc > 0 ? (size_t)rc : 0;
+                while (first < i
+                       && frames[first]->data_sz + ONI_WFRAMEHEADERSZ <= written) {
+                    written -= frames[first]->data_sz + ONI_WFRAMEHEADERSZ;
+                    first++;
+                }
+
+                return first > 0 ? (int)first : ONI_EWRITEFAILURE;
+            }
+
+            run = NULL;
+            first = i;
+        }
+
+        if (run == NULL) {
+            run = start;
+            run_size = 0;
+        }
+
+        run_size += wsize;
+    }
+
+    return (int)num_frames;
+}
+
+int oni_write_frame(const oni_ctx ctx, const oni_frame_t *frame)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    // NB: We don't need run_state == RUNNING because this could be changed in
+    // a different thread
+    assert(ctx->run_state >= IDLE && "Context is not acquiring.");
+
+    // NB: Frames are being written by the asynchronous writer instead
+    if (ctx->writer != NULL)
+        return ONI_EINVALSTATE;
+
+    // Write the frame
+    oni_frame_impl_t *iframe = (oni_frame_impl_t *)frame;
+
+    // Continuous frame starts ONI_WFRAMEHEADERSZ back in shared buffer
+    size_t wsize = iframe->private.f.data_sz + ONI_WFRAMEHEADERSZ;
+    int rc = _oni_write(ctx, ONI_WRITE_STREAM_DATA, iframe->private.f.data - ONI_WFRAMEHEADERSZ, wsize);
+    if (rc != (int)wsize) return ONI_EWRITEFAILURE;
+
+    return rc;
+}
+
+void oni_destroy_frame(oni_frame_t *frame)
+{
+    if (frame != NULL) {
+
+        oni_frame_impl_t* iframe = (oni_frame_impl_t*)frame;
+        struct oni_buf_impl *buffer = iframe->private.buffer;
+
+        // NB: Frames from oni_read_frames are released by oni_destroy_frames
+        assert(buffer != NULL && "Frame must be released using oni_destroy_frames.");
+        if (buffer == NULL)
+            return;
+
+        // Return the container to its pool. NB: This must happen before the
+        // buffer reference is released because the buffer keeps the pool alive
+        _oni_release_frame(buffer->pool, iframe);
+
+        // Decrement buffer reference count
+        _ref_dec(&(buffer->count));
+    }
+}
+
+// Subscribes to frames from num_devs devices. While RUNNING, frames from these
+// devices are delivered to a queue holding up to depth frames (rounded up to a
+// power of two) instead of being returned by oni_read_frame. Frames from
+// devices without a subscription are discarded. A device can belong to at
+// most one subscription. Subscriptions can only be changed while the context
+// is not RUNNING.
+int oni_subscribe(oni_ctx ctx,
+                  oni_sub *sub,
+                  const oni_dev_idx_t *dev_idxs,
+                  size_t num_devs,
+                  size_t depth)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (ctx->run_state < IDLE || ctx->demux != NULL)
+        return ONI_EINVALSTATE;
+
+    if (sub == NULL || dev_idxs == NULL || num_devs == 0 || depth == 0)
+        return ONI_EINVALARG;
+
+    size_t i, j;
+    for (i = 0; i < num_devs; i++) {
+
+        if (_oni_dev_find(ctx, dev_idxs[i]) < 0)
+            return ONI_EDEVIDX;
+
+        struct oni_sub_impl *other;
+        for (other = ctx->subs; other != NULL; other = other->next)
+            for (j = 0; j < other->num_devs; j++)
+                if (other->dev_idxs[j] == dev_idxs[i])
+                    return ONI_EINVALARG;
+    }
+
+    struct oni_sub_impl *s = calloc(1, sizeof(struct oni_sub_impl));
+    if (!s)
+        return ONI_EBADALLOC;
+
+    size_t capacity = 2;
+    while (capacity < depth)
+        capacity <<= 1;
+
+    s->frames = malloc(capacity * sizeof(oni_frame_t *));
+    s->dev_idxs = malloc(num_devs * sizeof(oni_dev_idx_t));
+    if (!s->frames || !s->dev_idxs) {
+        free(s->frames);
+        free(s->dev_idxs);
+        free(s);
+        return ONI_EBADALLOC;
+    }
+
+    memcpy(s->dev_idxs, dev_idxs, num_devs * sizeof(oni_dev_idx_t));
+    s->num_devs = num_devs;
+    s->mask = capacity - 1;
+    s->ctx = ctx;
+    s->rc = ONI_EINVALSTATE;
+    _oni_mutex_init(&s->mutex);
+    _oni_cond_init(&s->cond);
+
+    s->next = ctx->subs;
+    ctx->subs = s;
+
+    *sub = s;
+
+    return ONI_ESUCCESS;
+}
+
+int oni_unsubscribe(oni_sub sub)
+{
+    assert(sub != NULL && "Subscription is NULL");
+
+    oni_ctx ctx = sub->ctx;
+    if (ctx->demux != NULL)
+        return ONI_EINVALSTATE;
+
+    struct oni_sub_impl **link = &ctx->subs;
+    while (*link != sub)
+        link = &(*link)->next;
+    *link = sub->next;
+
+    _oni_destroy_sub(sub);
+
+    return ONI_ESUCCESS;
+}
+
+// Blocks until a frame is available from one of the subscribed devices. Once
+// the demultiplexer stops (e.g. RUNNING is cleared) the remaining queued
+// frames are returned followed by ONI_EINVALSTATE, or the error that stopped
+// the demultiplexer.
+int oni_sub_read_frame(oni_sub sub, oni_frame_t **frame)
+{
+    assert(sub != NULL && "Subscription is NULL");
+
+    // Queue is empty, sleep until a frame is delivered. NB: head is only
+    // written by this thread.
+    if (sub->head == _oni_atomic_load(&sub->tail)) {
+        _oni_mutex_lock(&sub->mutex);
+        _oni_atomic_store(&sub->consumer_waiting, 1);
+        while (sub->head == _oni_atomic_load(&sub->tail) && _oni_atomic_load(&sub->active))
+            _oni_cond_wait(&sub->cond, &sub->mutex);
+        _oni_atomic_store(&sub->consumer_waiting, 0);
+        _oni_mutex_unlock(&sub->mutex);
+
+        if (sub->head == _oni_atomic_load(&sub->tail))
+            return sub->rc;
+    }
+
+    *frame = sub->frames[sub->head & sub->mask];
+    _oni_atomic_store(&sub->head, sub->head + 1);
+
+    return ONI_ESUCCESS;
+}
+
+// Number of frames discarded because the subscription's queue was full
+uint64_t oni_sub_dropped(const oni_sub sub)
+{
+    assert(sub != NULL && "Subscription is NULL");
+
+    return _oni_atomic_load(&sub->dropped);
+}
+
+// Adds a closed-loop trigger that writes out each time predicate returns
+// non-zero for a frame from dev_idx. out must be a write frame (e.g. created
+// using oni_create_write_frame), which is owned by the trigger until it is
+// removed and is written without allocating. Predicates run and out is
+// written on the thread that reads frames (or the demultiplexer), so triggers
+// cannot be used with the asynchronous writer and no other thread may write
+// frames at the same time. Triggers can only be added or removed while the
+// context is not RUNNING.
+int oni_add_trigger(oni_ctx ctx,
+                    oni_trigger *trigger,
+                    oni_dev_idx_t dev_idx,
+                    oni_trigger_fn_t predicate,
+                    void *user,
+                    oni_frame_t *out)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    if (ctx->run_state != IDLE || ctx->writer != NULL)
+        return ONI_EINVALSTATE;
+
+    if (trigger == NULL || predicate == NULL || out == NULL)
+        return ONI_EINVALARG;
+
+    if (_oni_dev_find(ctx, dev_idx) < 0)
+        return ONI_EDEVIDX;
+
+    struct oni_trigger_impl *t = calloc(1, sizeof(struct oni_trigger_impl));
+    if (!t)
+        return ONI_EBADALLOC;
+
+    t->ctx = ctx;
+    t->dev_idx = dev_idx;
+    t->predicate = predicate;
+    t->user = user;
+    t->frame = out;
+
+    t->next = ctx->triggers;
+    ctx->triggers = t;
+
+    *trigger = t;
+
+    return ONI_ESUCCESS;
+}
+
+// Removes trigger and destroys its frame
+int oni_remove_trigger(oni_trigger trigger)
+{
+    assert(trigger != NULL && "Trigger is NULL");
+
+    oni_ctx ctx = trigger->ctx;
+    if (ctx->run_state == RUNNING)
+        return ONI_EINVALSTATE;
+
+    struct oni_trigger_impl **link = &ctx->triggers;
+    while (*link != trigger)
+        link = &(*link)->next;
+    *link = trigger->next;
+
+    oni_destroy_frame(trigger->frame);
+    free(trigger);
+
+    return ONI_ESUCCESS;
+}
+
+void oni_destroy_frames(oni_frame_t **frames)
+{
+    if (frames != NULL && frames[0] != NULL) {
+
+        // NB: frames must be the array filled by oni_read_frames, so its
+        // first element is the first frame of a batch
+        oni_frame_impl_t *iframe = (oni_frame_impl_t *)frames[0];
+        assert(iframe->private.buffer == NULL && "Frame was not produced by oni_read_frames.");
+        if (iframe->private.buffer != NULL)
+            return;
+
+        struct oni_frame_batch *batch
+            = container_of(iframe, struct oni_batch_frame, frame)->batch;
+        assert(iframe == &batch->frames[0].frame && "Frames must start with the first frame of the batch.");
+        if (iframe != &batch->frames[0].frame)
+            return;
+
+        struct oni_buf_impl *buffer = batch->buffer;
+
+        free(batch);
+
+        // Decrement buffer reference count
+        _ref_dec(&(buffer->count));
+    }
+}
+
+// Releases columns allocated using oni_create_columns
+void oni_destroy_columns(oni_column_t *cols, size_t num_cols)
+{
+    if (cols == NULL)
+        return;
+
+    size_t i;
+    for (i = 0; i < num_cols; i++) {
+        if (cols[i].time != NULL)
+            _oni_free_block(cols[i].time);
+        if (cols[i].data != NULL)
+            _oni_free_block(cols[i].data);
+        memset(&cols[i], 0, sizeof(oni_column_t));
+    }
+}
+
+// Returns the entry for dev_idx in the context's device table, which has the
+// same order as ONI_OPT_DEVICETABLE, or NULL if there is no such device. The
+// entry is valid until the next reset.
+const oni_device_t *oni_get_device(const oni_ctx ctx, oni_dev_idx_t dev_idx)
+{
+    assert(ctx != NULL && "Context is NULL");
+
+    int i = _oni_dev_find(ctx, dev_idx);
+    return i >= 0 ? &ctx->dev_table[i] : NULL;
+}
+
+void oni_version(int *major, int *minor, int *patch)
+{
+    *major = ONI_VERSION_MAJOR;
+    *minor = ONI_VERSION_MINOR;
+    *patch = ONI_VERSION_PATCH;
+}
+
+const oni_driver_info_t* oni_get_driver_info(const oni_ctx ctx)
+{
+    return ctx->driver.info();
+}
+
+const char *oni_error_str(int err)
+{
+    assert(err > ONI_MINERRORNUM && "Invalid error number.");
+    assert(err <= 0 && "Invalid error number.");
+
+    switch (err) {
+        case ONI_ESUCCESS: {
+            return "Success";
+        }
+        case ONI_EPATHINVALID: {
+            return "Invalid stream path";
+        }
+        case ONI_EDEVID: {
+            return "Invalid device ID";
+        }
+        case ONI_EDEVIDX: {
+            return "Invalid device index";
+        }
+        case ONI_EWRITESIZE: {
+            return "Data size is not an integer multiple of the write size for "
+                   "the designated device";
+        }
+        case ONI_EREADFAILURE: {
+            return "Failure to read from a stream or register";
+        }
+        case ONI_EWRITEFAILURE: {
+            return "Failure to write to a stream or register";
+        }
+        case ONI_ENULLCTX: {
+            return "Attempt to use a NULL context";
+        }
+        case ONI_ESEEKFAILURE: {
+            return "Failure to seek on stream";
+        }
+        case ONI_EINVALSTATE: {
+            return "Invalid operation for the current context run state";
+        }
+        case ONI_EINVALOPT: {
+            return "Invalid context option";
+        }
+        case ONI_EINVALARG: {
+            return "Invalid function arguments";
+        }
+        case ONI_ECOBSPACK: {
+            return "Invalid COBS packet";
+        }
+        case ONI_ERETRIG: {
+            return "Attempted to perform a hardware operation before a "
+                   "previous call to the same operation has completed";
+        }
+        case ONI_EBUFFERSIZE: {
+            return "Supplied buffer is too small";
+        }
+        case ONI_EBADDEVTABLE: {
+            return "Badly formatted device table supplied by firmware";
+        }
+        case ONI_EBADALLOC: {
+            return "A memory allocation failed";
+        }
+        case ONI_ECLOSEFAIL: {
+            return "File descriptor close failure (check errno)";
+        }
+        case ONI_EREADONLY: {
+            return "Attempted write to read only object (register, context "
+                   "option, etc)";
+        }
+        case ONI_EUNIMPL: {
+            return "Unimplemented API feature";
+        }
+        case ONI_EINVALREADSIZE: {
+            return "Block read size is smaller than the maximal frame size";
+        }
+        case ONI_ENOREADDEV: {
+            return "Frame read attempted when there are no readable devices in "
+                   "the device table";
+        }
+        case ONI_EWRITEONLY: {
+            return "Attempted to read from a write only object (register, context "
+                   "option, etc)";
+        }
+        case ONI_EINIT: {
+            return "Hardware initialization failed";
+        }
+        case ONI_EINVALWRITESIZE: {
+            return "Write buffer pre-allocation size is smaller than the "
+                   "maximal write frame size";
+        }
+        case ONI_ENOTWRITEDEV: {
+            return "Frame allocation attempted for a non-writable device";
+        }
+        case ONI_EDEVIDXREPEAT: {
+            return "Device table contains repeated device indices";
+        }
+        case ONI_EPROTCONFIG : {
+            return "Attempted to directly read or write a protected "
+                   "configuration option";
+        }
+        case ONI_EBADFRAME:
+        {
+            return "Received malformed frame";
+        }
+        case ONI_EBADCONTROLLER :
+        {
+            return "ONI Controller is not compatible with driver translator";
+        }
+        case ONI_EQUEUEFULL:
+        {
+            return "Queue is full";
+        }
+        default:
+            return "Unknown error";
+    }
+}
+
+// Returns the device table position of device x, or -1 if there is no such
+// device
+static inline int _oni_dev_find(oni_ctx ctx, oni_dev_idx_t x)
+{
+    // NB: Reserved bytes are always zero for a valid device
+    if (x >= ONI_NUMHUBS * ONI_DEVSPERHUB)
+        return -1;
+
+    return (int)ctx->dev_hubs[x / ONI_DEVSPERHUB][x % ONI_DEVSPERHUB] - 1;
+}
+
+static void _oni_clear_dev_hubs(oni_ctx ctx)
+{
+    size_t i;
+    for (i = 0; i < ONI_NUMHUBS; i++) {
+        if (ctx->dev_hubs[i] != _oni_empty_hub)
+            memset((void *)ctx->dev_hubs[i], 0, ONI_DEVSPERHUB * sizeof(oni_size_t));
+    }
+}
+
+static void _oni_free_dev_hubs(oni_ctx ctx)
+{
+    size_t i;
+    for (i = 0; i < ONI_NUMHUBS; i++) {
+        if (ctx->dev_hubs[i] != _oni_empty_hub)
+            free((void *)ctx->dev_hubs[i]);
+        ctx->dev_hubs[i] = _oni_empty_hub;
+    }
+}
+
+static int _oni_compare_dev_idx(const void *a, const void *b)
+{
+    oni_dev_idx_t x = ((const oni_device_t *)a)->idx;
+    oni_dev_idx_t y = ((const oni_device_t *)b)->idx;
+    return (x > y) - (x < y);
+}
+
+static int _oni_reset_routine(oni_ctx ctx)
+{
+    // NB: Lookups fail until the new device table is complete
+    _oni_clear_dev_hubs(ctx);
+    ctx->num_dev = 0;
+
+    // Get number of devices
+    oni_size_t num_dev = 0;
+    oni_signal_t sig_type = NULLSIG;
+    int rc = _oni_wait_signal(
+        ctx, DEVICETABLEACK, &sig_type, &num_dev, sizeof(num_dev));
+    if (rc) return rc;
+
+    // Device indices must be unique, so a larger table cannot be valid
+    if (num_dev > ONI_NUMHUBS * ONI_DEVSPERHUB)
+        return ONI_EBADDEVTABLE;
+
+    // Make space for the device table, which is only ever grown
+    if (num_dev > ctx->dev_table_capacity) {
+        oni_device_t *temp = realloc(ctx->dev_table, num_dev * sizeof(oni_device_t));
+        if (!temp)
+            return ONI_EBADALLOC;
+
+        ctx->dev_table = temp;
+
+        int *routes = realloc(ctx->col_routes, num_dev * sizeof(int));
+        if (!routes)
+            return ONI_EBADALLOC;
+
+        ctx->col_routes = routes;
+        ctx->dev_table_capacity = num_dev;
+
+        size_t j;
+        for (j = 0; j < num_dev; j++)
+            ctx->col_routes[j] = -1;
+    }
+
+    // Device instance packets all have the same size, so the signal stream
+    // can be read in bulk even if the driver cannot tell how much of it is
+    // readable. Overhead byte + type + device + delimiter, less what has been
+    // read already.
+    size_t table_bytes
+        = num_dev * (1 + sizeof(oni_signal_t) + sizeof(oni_device_t) + 1);
+    size_t buffered = ctx->sig_end - ctx->sig_pos;
+    ctx->sig_pending = table_bytes > buffered ? table_bytes - buffered : 0;
+
+    // Device instances are copied straight into the table. Hardware usually
+    // reports them in order, in which case sorting is skipped.
+    int sorted = 1;
+    size_t i;
+    for (i = 0; i < num_dev; i++) {
+
+        sig_type = NULLSIG;
+        rc = _oni_wait_signal(ctx,
+                              DEVICETABLEACK | DEVICEINST,
+                              &sig_type,
+                              ctx->dev_table + i,
+                              sizeof(oni_device_t));
+
+        // We should see num_dev device instances appear on the signal stream
+        if (!rc && sig_type != DEVICEINST)
+            rc = ONI_EBADDEVTABLE;
+
+        if (rc) {
+            ctx->sig_pending = 0;
+            return rc;
+        }
+
+        if (i > 0 && ctx->dev_table[i].idx <= ctx->dev_table[i - 1].idx)
+            sorted = 0;
+    }
+
+    ctx->sig_pending = 0;
+
+    // Sort device_table, which places repeated indices next to each other
+    if (!sorted)
+        qsort(ctx->dev_table, num_dev, sizeof(oni_device_t), _oni_compare_dev_idx);
+
+    // Check that dev_idx entries are unique (required for lookup), fill the
+    // lookup table and find the biggest frames in the table
+    ctx->max_read_frame_size = 0;
+    ctx->max_write_frame_size = 0;
+    for (i = 0; i < num_dev; i++) {
+
+        const oni_device_t *dev = ctx->dev_table + i;
+        if (i > 0 && dev->idx == dev[-1].idx)
+            return ONI_EDEVIDXREPEAT;
+
+        if (dev->idx >= ONI_NUMHUBS * ONI_DEVSPERHUB)
+            return ONI_EBADDEVTABLE;
+
+        oni_size_t *hub = (oni_size_t *)ctx->dev_hubs[dev->idx / ONI_DEVSPERHUB];
+        if (hub == _oni_empty_hub) {
+            hub = calloc(ONI_DEVSPERHUB, sizeof(oni_size_t));
+            if (!hub)
+                return ONI_EBADALLOC;
+            ctx->dev_hubs[dev->idx / ONI_DEVSPERHUB] = hub;
+        }
+
+        hub[dev->idx % ONI_DEVSPERHUB] = i + 1;
+
+        if (dev->read_size > ctx->max_read_frame_size)
+            ctx->max_read_frame_size = dev->read_size;
+
+        if (dev->write_size > ctx->max_write_frame_size)
+            ctx->max_write_frame_size = dev->write_size;
+    }
+
+    ctx->num_dev = num_dev;
+
+    // Add the header contents to the read size
+    ctx->max_read_frame_size += ONI_RFRAMEHEADERSZ;
+    ctx->max_write_frame_size += ONI_WFRAMEHEADERSZ;
+
+    // NB: Default the block read size to a single max sized frame. This is bad
+    // for high bandwidth performance and good for closed-loop delay. The opposite is true
+    // for write frames (to an extent) so this is defaulted to something large.
+    size_t align = sizeof(oni_fifo_dat_t);
+    ctx->block_read_size = (ctx->max_read_frame_size + align - 1) & ~(align - 1);
+    ctx->block_write_size = (ctx->max_write_frame_size + align - 1) & ~(align - 1);
+
+    // Set the block read size in the driver, in case it needs it
+    ctx->driver.set_opt_callback(ctx->driver.ctx,
+                                 ONI_OPT_BLOCKREADSIZE,
+                                 &(ctx->block_read_size),
+                                 sizeof(ctx->block_read_size));
+
+    return ONI_ESUCCESS;
+}
+
+static inline int _oni_read(oni_ctx ctx, oni_read_stream_t stream, void *data, size_t size)
+{
+    return ctx->driver.read_stream(ctx->driver.ctx, stream, data, size);
+}
+
+static inline int _oni_write(oni_ctx ctx, oni_write_stream_t stream, const char *data, size_t size)
+{
+    return ctx->driver.write_stream(ctx->driver.ctx, stream, data, size);
+}
+
+// Reads at least one byte from the signal stream into the empty signal
+// buffer. When the driver reports how many bytes are readable or more bytes
+// are known to follow (sig_pending), all of them are read at once. Otherwise,
+// reading more than one byte could block on bytes that will never arrive.
+static int _oni_fill_signal_buffer(oni_ctx ctx)
+{
+    assert(ctx->sig_pos == ctx->sig_end && "Signal buffer is not empty");
+
+    ctx->sig_pos = ctx->sig_end = 0;
+
+    size_t size = 1;
+    if (ctx->driver.stream_readable != NULL) {
+        int readable = ctx->driver.stream_readable(ctx->driver.ctx, ONI_READ_STREAM_SIGNAL);
+        if (readable > 1)
+            size = readable;
+    }
+
+    if (size < ctx->sig_pending)
+        size = ctx->sig_pending;
+    if (size > ONI_SIGNALBUFFERSIZE)
+        size = ONI_SIGNALBUFFERSIZE;
+
+    int rc = _oni_read(ctx, ONI_READ_STREAM_SIGNAL, ctx->sig_buffer, size);
+    if (rc != (int)size) return rc < 0 ? rc : ONI_EREADFAILURE;
+
+    ctx->sig_end = size;
+    ctx->sig_pending = ctx->sig_pending > size ? ctx->sig_pending - size : 0;
+
+    return ONI_ESUCCESS;
+}
+
+static int _oni_read_signal_packet(oni_ctx ctx, uint8_t *buffer)
+{
+    // Read the next zero-delimited packet
+    size_t i = 0;
+    int bad_delim = 0;
+    while (1) {
+
+        if (ctx->sig_pos == ctx->sig_end) {
+            int rc = _oni_fill_signal_buffer(ctx);
+            if (rc) return rc;
+        }
+
+        const uint8_t *start = ctx->sig_buffer + ctx->sig_pos;
+        size_t available = ctx->sig_end - ctx->sig_pos;
+        const uint8_t *delim = memchr(start, 0, available);
+        size_t n = delim != NULL ? (size_t)(delim - start) : available;
+
+        if (i + n <= ONI_COBSBUFFERSIZE)
+            memcpy(buffer + i, start, n);
+        else
+            bad_delim = 1;
+
+        i += n;
+        ctx->sig_pos += n;
+
+        if (delim != NULL) {
+            ctx->sig_pos++; // Consume the delimiter
+            break;
+        }
+    }
+
+    if (bad_delim)
+        return ONI_ECOBSPACK;
+    else
+        return (int)i; // Length of packet without 0 delimiter
+}
+
+// Queue that holds the signals of type(s) that are received while waiting for
+// a signal of a different type
+static inline int _oni_signal_queue(int types)
+{
+    if (types & (CONFIGWACK | CONFIGWNACK))
+        return SIGQ_CONFIGW;
+    if (types & (CONFIGRACK | CONFIGRNACK))
+        return SIGQ_CONFIGR;
+    if (types & (DEVICETABLEACK | DEVICEINST))
+        return SIGQ_DEVICETABLE;
+
+    return SIGQ_OTHER;
+}
+
+// Reads and decodes the next packet on the signal stream and appends it to
+// the queue for its type. Malformed packets are discarded. If the queue is
+// full, its oldest packet is discarded.
+static int _oni_dispatch_signal(oni_ctx ctx)
+{
+    uint8_t buffer[ONI_COBSBUFFERSIZE];
+
+    int pack_size = _oni_read_signal_packet(ctx, buffer);
+    if (pack_size == ONI_ECOBSPACK)
+        return ONI_ESUCCESS; // Something wrong with delimiter, try again
+    if (pack_size < 0)
+        return pack_size;
+
+    // Overhead byte + signal type
+    if (pack_size < 1 + (int)sizeof(oni_signal_t))
+        return ONI_ESUCCESS;
+
+    int rc = ctx->cobs_decode(buffer, buffer, pack_size);
+    if (rc < 0)
+        return ONI_ESUCCESS; // Something wrong with packet, try again
+
+    // Get the type, which occupies first 4 bytes of buffer
+    oni_signal_t type;
+    memcpy(&type, buffer, sizeof(oni_signal_t));
+
+    if (type == EVENT) {
+        _oni_push_event(ctx, buffer + sizeof(oni_signal_t), pack_size - 1 - sizeof(oni_signal_t));
+        return ONI_ESUCCESS;
+    }
+
+    struct oni_signal_queue *q = &ctx->sig_queues[_oni_signal_queue(type)];
+    if (q->tail - q->head == ONI_SIGNALQUEUEDEPTH)
+        q->head++;
+
+    struct oni_signal_packet *packet = &q->packets[q->tail % ONI_SIGNALQUEUEDEPTH];
+    packet->type = type;
+    packet->size = pack_size - 1 - sizeof(oni_signal_t);
+    memcpy(packet->data, buffer + sizeof(oni_signal_t), packet->size);
+    q->tail++;
+
+    return ONI_ESUCCESS;
+}
+
+// Delivers an event signal payload to the event callback or queue. Events
+// with a short payload are discarded.
+static void _oni_push_event(oni_ctx ctx, const uint8_t *data, size_t size)
+{
+    if (size < ONI_EVENTSZ)
+        return;
+
+    oni_event_t event;
+    memcpy(&event.time, data, sizeof(event.time));
+    data += sizeof(event.time);
+    memcpy(&event.dev_idx, data, sizeof(event.dev_idx));
+    data += sizeof(event.dev_idx);
+    memcpy(&event.code, data, sizeof(event.code));
+    data += sizeof(event.code);
+    memcpy(&event.value, data, sizeof(event.value));
+
+    struct oni_event_queue *eq = ctx->events;
+    if (eq->handler.callback != NULL) {
+        eq->handler.callback(&event, eq->handler.user);
+        return;
+    }
+
+    if (eq->tail - eq->head == ONI_EVENTQUEUEDEPTH) {
+        eq->head++;
+        eq->dropped++;
+    }
+
+    eq->events[eq->tail++ % ONI_EVENTQUEUEDEPTH] = event;
+}
+
+// Returns positive if the signal stream can be read without blocking, 0 if
+// not, or ONI_EUNIMPL if the driver provides no way to tell
+static int _oni_signal_readable(oni_ctx ctx)
+{
+    if (ctx->driver.stream_readable != NULL)
+        return ctx->driver.stream_readable(ctx->driver.ctx, ONI_READ_STREAM_SIGNAL) > 0;
+
+#ifndef _WIN32
+    // NB: The descriptor is only used for readiness, reads go through the driver
+    if (ctx->driver.stream_fd != NULL) {
+        int fd = ctx->driver.stream_fd(ctx->driver.ctx, ONI_READ_STREAM_SIGNAL);
+        if (fd >= 0) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+        }
+    }
+#endif
+
+    return ONI_EUNIMPL;
+}
+
+// Dispatches the signals that have already been received without blocking,
+// apart from waiting for the rest of a partially received packet. Returns
+// ONI_EUNIMPL if the driver cannot tell whether signals have been received.
+static int _oni_pump_signals(oni_ctx ctx)
+{
+    while (1) {
+
+        if (ctx->sig_pos == ctx->sig_end) {
+            int readable = _oni_signal_readable(ctx);
+            if (readable <= 0)
+                return readable;
+        }
+
+        int rc = _oni_dispatch_signal(ctx);
+        if (rc) return rc;
+    }
+}
+
+// Waits for the next signal whose type is in types, which must all share a
+// queue. Packets of other types are dispatched to their own queues and are
+// kept for their waiters. Packets in the same queue that do not match are
+// stale and are discarded. If data is not NULL, the signal's payload is
+// copied into it.
+static int _oni_wait_signal(oni_ctx ctx,
+                            int types,
+                            oni_signal_t *type,
+                            void *data,
+                            size_t size)
+{
+    struct oni_signal_queue *q = &ctx->sig_queues[_oni_signal_queue(types)];
+
+    while (1) {
+
+        while (q->head != q->tail) {
+
+            const struct oni_signal_packet *packet
+                = &q->packets[q->head++ % ONI_SIGNALQUEUEDEPTH];
+
+            if (!(packet->type & types))
+                continue;
+
+            *type = packet->type;
+
+            if (data != NULL) {
+
+                // Make sure the buffer size is sufficient
+                if (size < packet->size)
+                    return ONI_EBUFFERSIZE;
+
+                memcpy(data, packet->data, packet->size);
+            }
+
+            return ONI_ESUCCESS;
+        }
+
+        int rc = _oni_dispatch_signal(ctx);
+        if (rc) return rc;
+    }
+}
+
+// Writes a configuration register used for register access unless it is
+// known to hold value already
+static int _oni_write_reg_config(oni_ctx ctx,
+                                 oni_config_t reg,
+                                 int shadow,
+                                 oni_reg_val_t value)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    if ((rq->shadow_valid & (1 << shadow)) && rq->shadow[shadow] == value)
+        return ONI_ESUCCESS;
+
+    int rc = _oni_write_config(ctx, reg, value);
+    if (rc) {
+        rq->shadow_valid &= ~(1 << shadow);
+        return rc;
+    }
+
+    rq->shadow[shadow] = value;
+    rq->shadow_valid |= 1 << shadow;
+
+    return ONI_ESUCCESS;
+}
+
+static inline int _oni_reg_op_signals(const oni_reg_op_t *op)
+{
+    return op->write ? CONFIGWACK | CONFIGWNACK : CONFIGRACK | CONFIGRNACK;
+}
+
+// Makes sure we are not already in config triggered state. NB: This is only
+// unknown if a transaction was abandoned. Otherwise, receiving the previous
+// acknowledgment means that the trigger has been released.
+static int _oni_check_reg_trig(oni_ctx ctx)
+{
+    if (!ctx->regs.trig_unknown)
+        return ONI_ESUCCESS;
+
+    oni_reg_val_t trig = 0;
+    int rc = _oni_read_config(ctx, ONI_CONFIG_TRIG, &trig);
+    if (rc) return rc;
+
+    if (trig != 0) return ONI_ERETRIG;
+
+    ctx->regs.trig_unknown = 0;
+
+    return ONI_ESUCCESS;
+}
+
+// Sets up and triggers a register transaction
+static int _oni_start_reg_op(oni_ctx ctx, const oni_reg_op_t *op)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    int rc = _oni_check_reg_trig(ctx);
+    if (rc) return rc;
+
+    // Set config registers and trigger
+    rc = _oni_write_reg_config(ctx, ONI_CONFIG_DEV_IDX, REGSHADOW_DEVIDX, op->dev_idx);
+    if (rc) return rc;
+    rc = _oni_write_reg_config(ctx, ONI_CONFIG_REG_ADDR, REGSHADOW_ADDR, op->addr);
+    if (rc) return rc;
+
+    if (op->write) {
+        rc = _oni_write_reg_config(ctx, ONI_CONFIG_REG_VALUE, REGSHADOW_VALUE, op->value);
+        if (rc) return rc;
+    }
+
+    rc = _oni_write_reg_config(ctx, ONI_CONFIG_RW, REGSHADOW_RW, op->write ? 1 : 0);
+    if (rc) return rc;
+
+    rc = _oni_write_config(ctx, ONI_CONFIG_TRIG, 1);
+    if (rc) {
+        rq->trig_unknown = 1;
+        return rc;
+    }
+
+    return ONI_ESUCCESS;
+}
+
+// Waits for the acknowledgment of a triggered register transaction and
+// retrieves the value of a read
+static int _oni_finish_reg_op(oni_ctx ctx, oni_reg_op_t *op)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    // Wait for response from hardware
+    oni_signal_t type;
+    int rc = _oni_wait_signal(ctx, _oni_reg_op_signals(op), &type, NULL, 0);
+    if (rc) {
+        rq->trig_unknown = 1;
+        return rc;
+    }
+
+    if (type == CONFIGWNACK)
+        return ONI_EWRITEFAILURE;
+
+    if (op->write)
+        return ONI_ESUCCESS;
+
+    // NB: A read replaces the contents of the value register
+    rq->shadow_valid &= ~(1 << REGSHADOW_VALUE);
+
+    if (type == CONFIGRNACK)
+        return ONI_EREADFAILURE;
+
+    rc = _oni_read_config(ctx, ONI_CONFIG_REG_VALUE, &op->value);
+    if (rc) return rc;
+
+    rq->shadow[REGSHADOW_VALUE] = op->value;
+    rq->shadow_valid |= 1 << REGSHADOW_VALUE;
+
+    return ONI_ESUCCESS;
+}
+
+// Starts the next queued register transaction. Transactions that cannot be
+// started are completed with an error.
+static void _oni_start_queued_reg_op(oni_ctx ctx)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    while (rq->active != rq->tail) {
+
+        oni_reg_op_t *op = rq->ops[rq->active & (rq->capacity - 1)];
+        op->status = _oni_start_reg_op(ctx, op);
+        if (op->status == ONI_ESUCCESS)
+            return;
+
+        op->latency_ns = _oni_clock_ns() - op->latency_ns;
+        rq->active++;
+    }
+}
+
+// Completes the register transaction in progress, blocking until it is
+// acknowledged, and starts the next one
+static void _oni_progress_reg_ops(oni_ctx ctx)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+    assert(rq->active != rq->tail && "No register transaction in progress");
+
+    oni_reg_op_t *op = rq->ops[rq->active & (rq->capacity - 1)];
+    op->status = _oni_finish_reg_op(ctx, op);
+    op->latency_ns = _oni_clock_ns() - op->latency_ns;
+    _oni_reg_cache_update(ctx, op, op->status);
+    rq->active++;
+
+    _oni_start_queued_reg_op(ctx);
+}
+
+// Carries out a single register transaction synchronously
+static int _oni_run_reg_op(oni_ctx ctx, oni_reg_op_t *op)
+{
+    // NB: All transactions share the trigger, so submitted transactions must
+    // complete first
+    while (ctx->regs.active != ctx->regs.tail)
+        _oni_progress_reg_ops(ctx);
+
+    if (_oni_reg_cache_lookup(ctx, op))
+        return ONI_ESUCCESS;
+
+    int rc = _oni_start_reg_op(ctx, op);
+    if (rc) return rc;
+
+    rc = _oni_finish_reg_op(ctx, op);
+    _oni_reg_cache_update(ctx, op, rc);
+
+    return rc;
+}
+
+// Hands register writes to the driver in batches, waits for their
+// acknowledgments and sets the status of each op
+static int _oni_write_regs_batch(oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops)
+{
+    struct oni_reg_queue *rq = &ctx->regs;
+
+    // NB: All transactions share the trigger, so submitted transactions must
+    // complete first
+    while (rq->active != rq->tail)
+        _oni_progress_reg_ops(ctx);
+
+    int rc = _oni_check_reg_trig(ctx);
+    if (rc) return rc;
+
+    oni_reg_write_t writes[ONI_REGBATCHSIZE];
+    oni_reg_op_t *sent[ONI_REGBATCHSIZE];
+    const oni_reg_op_t *last = NULL;
+    int result = ONI_ESUCCESS;
+    size_t i = 0;
+
+    while (i < num_ops) {
+
+        // Collect writes that the cache cannot skip
+        size_t n = 0, j;
+        for (; i < num_ops && n < ONI_REGBATCHSIZE; i++) {
+
+            oni_reg_op_t op = {ops[i].dev_idx, ops[i].addr, ops[i].value, 1, ONI_ESUCCESS, 0};
+            if (_oni_reg_cache_lookup(ctx, &op)) {
+                ops[i].status = ONI_ESUCCESS;
+                continue;
+            }
+
+            sent[n] = &ops[i];
+            writes[n].dev_idx = op.dev_idx;
+            writes[n].addr = op.addr;
+            writes[n].value = op.value;
+            n++;
+        }
+
+        if (n == 0)
+            break;
+
+        // The configuration registers are left holding the last write, and
+        // the trigger state is unknown until every write is acknowledged
+        rq->shadow_valid = 0;
+        rq->trig_unknown = 1;
+
+        rc = ctx->driver.config_batch(ctx->driver.ctx, writes, n);
+        if (rc) {
+            for (j = 0; j < n; j++) {
+                sent[j]->status = rc;
+                _oni_reg_cache_update(ctx, sent[j], rc);
+            }
+            return rc;
+        }
+
+        for (j = 0; j < n; j++) {
+            oni_signal_t type;
+            rc = _oni_wait_signal(ctx, CONFIGWACK | CONFIGWNACK, &type, NULL, 0);
+            if (rc) {
+                for (; j < n; j++) {
+                    sent[j]->status = rc;
+                    _oni_reg_cache_update(ctx, sent[j], rc);
+                }
+                return rc;
+            }
+
+            sent[j]->status = type == CONFIGWNACK ? ONI_EWRITEFAILURE : ONI_ESUCCESS;
+            if (sent[j]->status && result == ONI_ESUCCESS)
+                result = sent[j]->status;
+
+            _oni_reg_cache_update(ctx, sent[j], sent[j]->status);
+        }
+
+        rq->trig_unknown = 0;
+        last = sent[n - 1];
+    }
+
+    if (last != NULL) {
+        rq->shadow[REGSHADOW_DEVIDX] = last->dev_idx;
+        rq->shadow[REGSHADOW_ADDR] = last->addr;
+        rq->shadow[REGSHADOW_VALUE] = last->value;
+        rq->shadow[REGSHADOW_RW] = 1;
+        rq->shadow_valid = (1 << NUMREGSHADOW) - 1;
+    }
+
+    return result;
+}
+
+// Mode used for registers that have not been given one by oni_set_reg_cache
+static int _oni_reg_cache_default_mode(oni_dev_idx_t dev_idx, oni_reg_addr_t addr)
+{
+    if ((dev_idx & 0xFF) != ONIX_HUB_DEV_IDX)
+        return ONI_REGCACHE_NONE;
+
+    switch (addr) {
+        case ONIX_HUB_HARDWAREID:
+        case ONIX_HUB_HARDWAREREV:
+        case ONIX_HUB_FIRMWAREVER:
+        case ONIX_HUB_CLKRATEHZ:
+        case ONIX_HUB_DELAYNS:
+            return ONI_REGCACHE_IMMUTABLE;
+        default:
+            return ONI_REGCACHE_NONE;
+    }
+}
+
+static inline size_t _oni_reg_cache_hash(oni_dev_idx_t dev_idx, oni_reg_addr_t addr)
+{
+    return (size_t)(dev_idx * 0x9E3779B1u) ^ (size_t)(addr * 0x85EBCA77u);
+}
+
+// Finds the cache entry of a register. If there is none and add is non-zero,
+// a new entry using the default mode is inserted. Returns NULL if there is no
+// entry or it could not be allocated.
+static struct oni_reg_cache_entry *_oni_reg_cache_find(oni_ctx ctx,
+                                                       oni_dev_idx_t dev_idx,
+                                                       oni_reg_addr_t addr,
+                                                       int add)
+{
+    struct oni_reg_cache *cache = &ctx->reg_cache;
+
+    if (cache->capacity > 0) {
+
+        size_t mask = cache->capacity - 1;
+        size_t i = _oni_reg_cache_hash(dev_idx, addr) & mask;
+        for (; cache->entries[i].used; i = (i + 1) & mask) {
+            struct oni_reg_cache_entry *entry = &cache->entries[i];
+            if (entry->dev_idx == dev_idx && entry->addr == addr)
+                return entry;
+        }
+    }
+
+    if (!add)
+        return NULL;
+
+    // Keep the load factor below 3/4 so that probes terminate quickly
+    if (4 * (cache->count + 1) > 3 * cache->capacity) {
+
+        size_t capacity = cache->capacity ? 2 * cache->capacity : ONI_REGCACHESIZE;
+        struct oni_reg_cache_entry *entries
+            = calloc(capacity, sizeof(struct oni_reg_cache_entry));
+        if (entries == NULL)
+            return NULL;
+
+        size_t i;
+        for (i = 0; i < cache->capacity; i++) {
+
+            if (!cache->entries[i].used)
+                continue;
+
+            size_t j = _oni_reg_cache_hash(cache->entries[i].dev_idx, cache->entries[i].addr)
+                       & (capacity - 1);
+            while (entries[j].used)
+                j = (j + 1) & (capacity - 1);
+
+            entries[j] = cache->entries[i];
+        }
+
+        free(cache->entries);
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    size_t mask = cache->capacity - 1;
+    size_t i = _oni_reg_cache_hash(dev_idx, addr) & mask;
+    while (cache->entries[i].used)
+        i = (i + 1) & mask;
+
+    struct oni_reg_cache_entry *entry = &cache->entries[i];
+    entry->dev_idx = dev_idx;
+    entry->addr = addr;
+    entry->mode = _oni_reg_cache_default_mode(dev_idx, addr);
+    entry->valid = 0;
+    entry->used = 1;
+    cache->count++;
+
+    return entry;
+}
+
+// Completes a register transaction from the cache if possible: reads of known
+// values and writes that would not change a host owned register. Returns
+// non-zero if the transaction was completed.
+static int _oni_reg_cache_lookup(oni_ctx ctx, oni_reg_op_t *op)
+{
+    const struct oni_reg_cache_entry *entry
+        = _oni_reg_cache_find(ctx, op->dev_idx, op->addr, 0);
+
+    if (entry == NULL || !entry->valid)
+        return 0;
+
+    if (op->write) {
+        if (entry->mode != ONI_REGCACHE_HOSTOWNED || entry->value != op->value)
+            return 0;
+    } else {
+        op->value = entry->value;
+    }
+
+    ctx->reg_cache.hits++;
+    return 1;
+}
+
+// Records the outcome of a register transaction that went to hardware. After
+// a successful read or write the register is known to hold op->value.
+static void _oni_reg_cache_update(oni_ctx ctx, const oni_reg_op_t *op, int rc)
+{
+    struct oni_reg_cache_entry *entry
+        = _oni_reg_cache_find(ctx, op->dev_idx, op->addr, 0);
+
+    if (entry == NULL) {
+
+        // Only registers that are cached by default are added here. NB: An
+        // allocation failure just means that the value is not cached.
+        if (rc != ONI_ESUCCESS
+            || _oni_reg_cache_default_mode(op->dev_idx, op->addr) == ONI_REGCACHE_NONE)
+            return;
+
+        entry = _oni_reg_cache_find(ctx, op->dev_idx, op->addr, 1);
+        if (entry == NULL)
+            return;
+    }
+
+    if (entry->mode == ONI_REGCACHE_NONE)
+        return;
+
+    entry->value = op->value;
+    entry->valid = rc == ONI_ESUCCESS;
+}
+
+// Forgets all cached register values
+static void _oni_reg_cache_invalidate(oni_ctx ctx)
+{
+    struct oni_reg_cache *cache = &ctx->reg_cache;
+
+    size_t i;
+    for (i = 0; i < cache->capacity; i++)
+        cache->entries[i].valid = 0;
+
+    cache->sys_clk_valid = 0;
+    cache->acq_clk_valid = 0;
+}
+
+// Returns non-zero if a signal with one of types is available or, because a
+// packet is partially received or the driver cannot tell, might be
+static int _oni_signal_ready(oni_ctx ctx, int types)
+{
+    const struct oni_signal_queue *q = &ctx->sig_queues[_oni_signal_queue(types)];
+
+    if (q->head != q->tail || ctx->sig_pos != ctx->sig_end)
+        return 1;
+
+    if (ctx->driver.stream_readable == NULL)
+        return 1;
+
+    return ctx->driver.stream_readable(ctx->driver.ctx, ONI_READ_STREAM_SIGNAL) != 0;
+}
+
+static inline int _oni_write_config(oni_ctx ctx, oni_config_t reg, oni_reg_val_t value)
+{
+    return ctx->driver.write_config(ctx->driver.ctx, reg, value);
+}
+
+static inline int _oni_read_config(oni_ctx ctx, oni_config_t reg, oni_reg_val_t *value)
+{
+    return ctx->driver.read_config(ctx->driver.ctx, reg, value);
+}
+
+static int _oni_ensure_read_buffer(oni_ctx ctx)
+{
+    // NB: This function can only be called if the device table has been 
+    // populated and contains devices that produce data.
+    if (ctx->max_read_frame_size == 0)
+        return ONI_EINVALARG;
+
+#ifdef __linux__
+    if (ctx->read_ring_size != 0)
+        return _oni_ensure_ring_buffer(ctx);
+#endif
+
+    if (ctx->reader != NULL)
+        return _oni_ensure_readahead_buffer(ctx);
+
+    // Remaining bytes in buffer
+    size_t remaining = ctx->shared_rbuf != NULL ?
+        ctx->shared_rbuf->end_pos - ctx->shared_rbuf->read_pos : 0;
+
+    // NB: Refill when remaining < max_read_frame_size to guarantee that after
+    // this call the buffer holds enough data for both the frame header and its
+    // maximum-sized payload. This allows _oni_consume_buffer to read the payload
+    // without ever triggering a second refill, keeping each frame inside a single
+    // buffer object.
+    if (remaining < ctx->max_read_frame_size) {
+
+#ifdef __linux__
+        // Leaving ring mode, ring is unmapped once its frames are released
+        if (ctx->ring != NULL) {
+            _ref_dec(&(ctx->ring->count));
+            ctx->ring = NULL;
+        }
+#endif
+
+        return _oni_refill_block(ctx, remaining);
+    }
+
+    return ONI_ESUCCESS;
+}
+
+// Replaces the current buffer with a block from the pool, holding the
+// remaining unread bytes followed by a new block read
+static int _oni_refill_block(oni_ctx ctx, size_t remaining)
+{
+    assert(ctx->max_read_frame_size <= ctx->block_read_size &&
+        "Block read size is too small given the possible read frame size.");
+
+    // Unconsumed tail of the old block is copied into the headroom of
+    // the new one so that it is contiguous with the next block read
+    size_t headroom = _oni_read_headroom(ctx);
+
+    // New buffer taken from pool, old_buffer saved
+    struct oni_buf_impl *old_buffer = ctx->shared_rbuf;
+    ctx->shared_rbuf = _oni_acquire_read_block(ctx, headroom);
+    if (!ctx->shared_rbuf) {
+        ctx->shared_rbuf = old_buffer;
+        return ONI_EBADALLOC;
+    }
+
+    // (Re)set buffer state
+    ctx->shared_rbuf->pool = ctx->pool;
+    _ref_inc(&(ctx->pool->count));
+    ctx->shared_rbuf->read_pos = ctx->shared_rbuf->buffer + headroom - remaining;
+    ctx->shared_rbuf->end_pos
+        = ctx->shared_rbuf->buffer + headroom + ctx->block_read_size;
+
+    // Transfer remaining data to new buffer
+    if (old_buffer != NULL) {
+
+        // Copy remaining contents into new buffer
+        memcpy(ctx->shared_rbuf->read_pos, old_buffer->read_pos, remaining);
+
+        // Context releases control of old buffer
+        _ref_dec(&(old_buffer->count));
+    }
+
+    // Fill the buffer with new data
+    int rc = _oni_read(ctx, ONI_READ_STREAM_DATA,
+                      ctx->shared_rbuf->buffer + headroom,
+                      ctx->block_read_size);
+    if ((size_t)rc != ctx->block_read_size) return ONI_EREADFAILURE;
+
+    if (ctx->triggers != NULL)
+        _oni_trig_scan(ctx, remaining, _oni_clock_ns());
+
+    return ONI_ESUCCESS;
+}
+
+static size_t _oni_read_headroom(oni_ctx ctx)
+{
+    if (ctx->block_read_size < ONI_BLOCKALIGN)
+        return ctx->max_read_frame_size;
+
+    size_t headroom = ctx->max_read_frame_size + ONI_BLOCKALIGN - 1;
+    return headroom - headroom % ONI_BLOCKALIGN;
+}
+
+static int _oni_start_control(oni_ctx ctx)
+{
+    struct oni_control_impl *ctl = calloc(1, sizeof(struct oni_control_impl));
+    if (!ctl)
+        return ONI_EBADALLOC;
+
+    ctl->ctx = ctx;
+    _oni_mutex_init(&ctl->mutex);
+    _oni_cond_init(&ctl->cond);
+
+    // NB: Calls are not redirected until the thread handle is published
+    int rc = _oni_thread_create(&ctl->thread, _oni_control_loop, ctl, -1);
+    if (rc) {
+        _oni_cond_destroy(&ctl->cond);
+        _oni_mutex_destroy(&ctl->mutex);
+        free(ctl);
+        return rc;
+    }
+
+    ctx->control = ctl;
+
+    return ONI_ESUCCESS;
+}
+
+static void _oni_stop_control(oni_ctx ctx)
+{
+    struct oni_control_impl *ctl = ctx->control;
+    if (ctl == NULL)
+        return;
+
+    // NB: Queued calls are carried out before the thread exits
+    _oni_mutex_lock(&ctl->mutex);
+    ctl->stop = 1;
+    _oni_cond_broadcast(&ctl->cond);
+    _oni_mutex_unlock(&ctl->mutex);
+
+    _oni_thread_join(ctl->thread);
+
+    _oni_cond_destroy(&ctl->cond);
+    _oni_mutex_destroy(&ctl->mutex);
+    free(ctl);
+
+    ctx->control = NULL;
+}
+
+// Queues a call for the control thread and waits for its result
+static int _oni_control_call(oni_ctx ctx,
+                             int (*func)(oni_ctx, const struct oni_control_call *),
+                             int opt,
+                             void *value,
+                             const void *cvalue,
+                             size_t size,
+                             size_t *size_out)
+{
+    struct oni_control_impl *ctl = ctx->control;
+
+    struct oni_control_call call;
+    call.func = func;
+    call.opt = opt;
+    call.value = value;
+    call.cvalue = cvalue;
+    call.size = size;
+    call.size_out = size_out;
+    call.rc = ONI_ESUCCESS;
+    call.done = 0;
+    call.next = NULL;
+
+    _oni_mutex_lock(&ctl->mutex);
+
+    if (ctl->tail != NULL)
+        ctl->tail->next = &call;
+    else
+        ctl->head = &call;
+    ctl->tail = &call;
+
+    _oni_cond_broadcast(&ctl->cond);
+
+    while (!call.done)
+        _oni_cond_wait(&ctl->cond, &ctl->mutex);
+
+    _oni_mutex_unlock(&ctl->mutex);
+
+    return call.rc;
+}
+
+// NB: The register transaction queue and signal queues are only touched by
+// this thread while it exists, so they are accessed without holding mutex
+static void _oni_control_loop(void *arg)
+{
+    struct oni_control_impl *ctl = arg;
+    oni_ctx ctx = ctl->ctx;
+
+    _oni_mutex_lock(&ctl->mutex);
+
+    while (1) {
+
+        struct oni_control_call *call = ctl->head;
+        if (call != NULL) {
+
+            ctl->head = call->next;
+            if (ctl->head == NULL)
+                ctl->tail = NULL;
+
+            _oni_mutex_unlock(&ctl->mutex);
+            int rc = call->func(ctx, call);
+            _oni_mutex_lock(&ctl->mutex);
+
+            call->rc = rc;
+            call->done = 1;
+            _oni_cond_broadcast(&ctl->cond);
+            continue;
+        }
+
+        if (ctl->stop)
+            break;
+
+        // Complete submitted register transactions without waiting for
+        // oni_poll_reg_completions
+        if (ctx->regs.active != ctx->regs.tail) {
+            _oni_mutex_unlock(&ctl->mutex);
+            _oni_progress_reg_ops(ctx);
+            _oni_mutex_lock(&ctl->mutex);
+            continue;
+        }
+
+        // Deliver hardware events to the callback as they arrive
+        if (ctx->events->handler.callback != NULL) {
+            _oni_mutex_unlock(&ctl->mutex);
+            _oni_pump_signals(ctx);
+            _oni_mutex_lock(&ctl->mutex);
+            if (ctl->head == NULL && !ctl->stop)
+                _oni_cond_timedwait(&ctl->cond, &ctl->mutex, ONI_EVENTPOLLNS);
+            continue;
+        }
+
+        _oni_cond_wait(&ctl->cond, &ctl->mutex);
+    }
+
+    _oni_mutex_unlock(&ctl->mutex);
+}
+
+static int _oni_start_readahead(oni_ctx ctx)
+{
+    struct oni_readahead_impl *ra = calloc(1, sizeof(struct oni_readahead_impl));
+    if (!ra)
+        return ONI_EBADALLOC;
+
+    ra->blocks = calloc(ctx->read_ahead_depth, sizeof(struct oni_buf_impl *));
+    if (!ra->blocks) {
+        free(ra);
+        return ONI_EBADALLOC;
+    }
+
+    ra->ctx = ctx;
+    ra->depth = ctx->read_ahead_depth;
+    ra->headroom = _oni_read_headroom(ctx);
+    ra->block_size = ctx->block_read_size;
+    ra->rc = ONI_EREADFAILURE;
+    _oni_mutex_init(&ra->mutex);
+    _oni_cond_init(&ra->cond);
+
+    int rc = _oni_thread_create(&ra->thread, _oni_readahead_loop, ra, ctx->read_ahead_cpu);
+    if (rc) {
+        _oni_cond_destroy(&ra->cond);
+        _oni_mutex_destroy(&ra->mutex);
+        free(ra->blocks);
+        free(ra);
+        return rc;
+    }
+
+    ctx->reader = ra;
+
+#ifdef __linux__
+    // NB: The driver's descriptor would now report data that the application
+    // cannot read without blocking
+    _oni_ready_watch_driver(ctx, 0);
+#endif
+
+    return ONI_ESUCCESS;
+}
+
+static void _oni_stop_readahead(oni_ctx ctx)
+{
+    struct oni_readahead_impl *ra = ctx->reader;
+    if (ra == NULL)
+        return;
+
+    _oni_mutex_lock(&ra->mutex);
+    _oni_atomic_store(&ra->stop, 1);
+    _oni_cond_broadcast(&ra->cond);
+    _oni_mutex_unlock(&ra->mutex);
+
+    _oni_thread_join(ra->thread);
+
+    // Release blocks that were never consumed
+    while (ra->head != ra->tail)
+        _ref_dec(&(ra->blocks[ra->head++ % ra->depth]->count));
+
+    _oni_cond_destroy(&ra->cond);
+    _oni_mutex_destroy(&ra->mutex);
+    free(ra->blocks);
+    free(ra);
+
+    ctx->reader = NULL;
+
+#ifdef __linux__
+    _oni_ready_watch_driver(ctx, 1);
+#endif
+}
+
+// NB: While the read-ahead thread exists, it is the only caller of
+// _oni_acquire_read_block and the data stream read function
+static void _oni_readahead_loop(void *arg)
+{
+    struct oni_readahead_impl *ra = arg;
+    oni_ctx ctx = ra->ctx;
+
+    // NB: tail is only written by this thread
+    while (!_oni_atomic_load(&ra->stop)) {
+
+        // Queue is full, sleep until the consumer takes a block
+        if (ra->tail - _oni_atomic_load(&ra->head) == ra->depth) {
+            _oni_mutex_lock(&ra->mutex);
+            _oni_atomic_store(&ra->producer_waiting, 1);
+            while (ra->tail - _oni_atomic_load(&ra->head) == ra->depth
+                   && !_oni_atomic_load(&ra->stop))
+                _oni_cond_wait(&ra->cond, &ra->mutex);
+            _oni_atomic_store(&ra->producer_waiting, 0);
+            _oni_mutex_unlock(&ra->mutex);
+            continue;
+        }
+
+        struct oni_buf_impl *buf = _oni_acquire_read_block(ctx, ra->headroom);
+        if (!buf) {
+            ra->rc = ONI_EBADALLOC;
+            break;
+        }
+
+        buf->pool = ctx->pool;
+        _ref_inc(&(ctx->pool->count));
+
+        int rc = _oni_read(ctx, ONI_READ_STREAM_DATA, buf->buffer + ra->headroom, ra->block_size);
+        buf->read_ns = _oni_clock_ns();
+        if ((size_t)rc != ra->block_size) {
+            _ref_dec(&(buf->count));
+            ra->rc = ONI_EREADFAILURE;
+            break;
+        }
+
+        // Publish the block
+        ra->blocks[ra->tail % ra->depth] = buf;
+        _oni_atomic_store(&ra->tail, ra->tail + 1);
+
+#ifdef __linux__
+        _oni_ready_raise(_oni_load_ptr((void *volatile *)&ctx->ready));
+#endif
+
+        if (_oni_atomic_load(&ra->consumer_waiting)) {
+            _oni_mutex_lock(&ra->mutex);
+            _oni_cond_broadcast(&ra->cond);
+            _oni_mutex_unlock(&ra->mutex);
+        }
+    }
+
+    _oni_mutex_lock(&ra->mutex);
+    _oni_atomic_store(&ra->done, 1);
+    _oni_cond_broadcast(&ra->cond);
+    _oni_mutex_unlock(&ra->mutex);
+
+#ifdef __linux__
+    // The next read returns the producer's error without blocking
+    _oni_ready_raise(_oni_load_ptr((void *volatile *)&ctx->ready));
+#endif
+}
+
+static int _oni_ensure_readahead_buffer(oni_ctx ctx)
+{
+    struct oni_readahead_impl *ra = ctx->reader;
+
+    // Remaining bytes in buffer
+    size_t remaining = ctx->shared_rbuf != NULL ?
+        ctx->shared_rbuf->end_pos - ctx->shared_rbuf->read_pos : 0;
+
+    if (remaining >= ctx->max_read_frame_size)
+        return ONI_ESUCCESS;
+
+    // Queue is empty, sleep until the producer delivers a block. NB: head is
+    // only written by this thread.
+    if (ra->head == _oni_atomic_load(&ra->tail)) {
+        _oni_mutex_lock(&ra->mutex);
+        _oni_atomic_store(&ra->consumer_waiting, 1);
+        while (ra->head == _oni_atomic_load(&ra->tail) && !_oni_atomic_load(&ra->done))
+            _oni_cond_wait(&ra->cond, &ra->mutex);
+        _oni_atomic_store(&ra->consumer_waiting, 0);
+        _oni_mutex_unlock(&ra->mutex);
+
+        // Producer has exited
+        if (ra->head == _oni_atomic_load(&ra->tail))
+            return ra->rc;
+    }
+
+    struct oni_buf_impl *buf = ra->blocks[ra->head % ra->depth];
+
+    // Unconsumed tail of the old block goes into the headroom of the new one
+    buf->read_pos = buf->buffer + ra->headroom - remaining;
+    buf->end_pos = buf->buffer + ra->headroom + ra->block_size;
+
+    if (ctx->shared_rbuf != NULL) {
+        memcpy(buf->read_pos, ctx->shared_rbuf->read_pos, remaining);
+        _ref_dec(&(ctx->shared_rbuf->count));
+    }
+    ctx->shared_rbuf = buf;
+
+    // Free the slot
+    _oni_atomic_store(&ra->head, ra->head + 1);
+
+    if (ctx->triggers != NULL)
+        _oni_trig_scan(ctx, remaining, buf->read_ns);
+
+    if (_oni_atomic_load(&ra->producer_waiting)) {
+        _oni_mutex_lock(&ra->mutex);
+        _oni_cond_broadcast(&ra->cond);
+        _oni_mutex_unlock(&ra->mutex);
+    }
+
+    return ONI_ESUCCESS;
+}
+
+static int _oni_start_writer(oni_ctx ctx)
+{
+    struct oni_writer_impl *w = calloc(1, sizeof(struct oni_writer_impl));
+    if (!w)
+        return ONI_EBADALLOC;
+
+    size_t capacity = 1;
+    while (capacity < ctx->writer_depth)
+        capacity <<= 1;
+
+    w->slots = calloc(capacity, sizeof(struct oni_writer_slot));
+    if (!w->slots) {
+        free(w);
+        return ONI_EBADALLOC;
+    }
+
+    size_t i;
+    for (i = 0; i < capacity; i++)
+        w->slots[i].seq = i;
+
+    w->ctx = ctx;
+    w->mask = capacity - 1;
+    _oni_mutex_init(&w->mutex);
+    _oni_cond_init(&w->cond);
+
+    int rc = _oni_thread_create(&w->thread, _oni_writer_loop, w, -1);
+    if (rc) {
+        _oni_cond_destroy(&w->cond);
+        _oni_mutex_destroy(&w->mutex);
+        free(w->slots);
+        free(w);
+        return rc;
+    }
+
+    ctx->writer = w;
+
+    return ONI_ESUCCESS;
+}
+
+static void _oni_stop_writer(oni_ctx ctx)
+{
+    struct oni_writer_impl *w = ctx->writer;
+    if (w == NULL)
+        return;
+
+    // NB: Queued frames are written before the thread exits
+    _oni_mutex_lock(&w->mutex);
+    _oni_atomic_store(&w->stop, 1);
+    _oni_cond_broadcast(&w->cond);
+    _oni_mutex_unlock(&w->mutex);
+
+    _oni_thread_join(w->thread);
+
+    _oni_cond_destroy(&w->cond);
+    _oni_mutex_destroy(&w->mutex);
+    free(w->slots);
+    free(w);
+
+    ctx->writer = NULL;
+}
+
+// NB: While the writer exists, it is the only caller of the data stream
+// write function
+static void _oni_writer_loop(void *arg)
+{
+    struct oni_writer_impl *w = arg;
+    oni_ctx ctx = w->ctx;
+
+    oni_frame_t *frames[ONI_WRITERBATCH];
+    uint64_t queued_ns[ONI_WRITERBATCH];
+
+    while (1) {
+
+        size_t queued = _oni_atomic_load(&w->tail) - _oni_atomic_load(&w->head);
+
+        // Take the frames that are ready, oldest first
+        size_t n = 0;
+        while (n < ONI_WRITERBATCH
+               && (frames[n] = _oni_writer_pop(w, &queued_ns[n])) != NULL)
+            n++;
+
+        if (n == 0) {
+
+            if (_oni_atomic_load(&w->stop))
+                break;
+
+            // Queue is empty, sleep until a frame is queued
+            _oni_mutex_lock(&w->mutex);
+            _oni_atomic_store(&w->writer_waiting, 1);
+            while (_oni_writer_empty(w) && !_oni_atomic_load(&w->stop))
+                _oni_cond_wait(&w->cond, &w->mutex);
+            _oni_atomic_store(&w->writer_waiting, 0);
+            _oni_mutex_unlock(&w->mutex);
+            continue;
+        }
 
-    return rc;
+        // Room has been made
+        if (_oni_atomic_load(&w->producers_waiting)) {
+            _oni_mutex_lock(&w->mutex);
+            _oni_cond_broadcast(&w->cond);
+            _oni_mutex_unlock(&w->mutex);
+        }
+
+        int rc = _oni_write_frames(ctx, (const oni_frame_t **)frames, n);
+        size_t written = rc > 0 ? (size_t)rc : 0;
+        uint64_t now = _oni_clock_ns();
+
+        uint64_t latency_sum = 0, max_latency = 0;
+        size_t i;
+        for (i = 0; i < n; i++) {
+            uint64_t latency = now - queued_ns[i];
+            latency_sum += latency;
+            if (latency > max_latency)
+                max_latency = latency;
+            oni_destroy_frame(frames[i]);
+        }
+
+        _oni_mutex_lock(&w->mutex);
+        w->written += written;
+        w->failed += n - written;
+        if (queued > w->max_queued)
+            w->max_queued = queued;
+        w->latency_sum_ns += latency_sum;
+        if (max_latency > w->max_latency_ns)
+            w->max_latency_ns = max_latency;
+        _oni_mutex_unlock(&w->mutex);
+    }
 }
 
-void oni_destroy_frame(oni_frame_t *frame)
+// Queues frame. Returns non-zero if the queue is full.
+static int _oni_writer_push(struct oni_writer_impl *w, oni_frame_t *frame)
 {
-    if (frame != NULL) {
+    size_t pos = _oni_atomic_load(&w->tail);
+
+    while (1) {
+        struct oni_writer_slot *slot = &w->slots[pos & w->mask];
+        size_t seq = _oni_atomic_load(&slot->seq);
+
+        if (seq == pos) {
+            // Slot is free, claim it
+            if (_oni_atomic_cas(&w->tail, pos, pos + 1)) {
+                slot->frame = frame;
+                slot->queued_ns = _oni_clock_ns();
+                _oni_atomic_store(&slot->seq, pos + 1);
+                return 0;
+            }
+        } else if ((ptrdiff_t)(seq - pos) < 0) {
+            // Slot still holds a frame from the previous lap
+            return 1;
+        }
 
-        oni_frame_impl_t* iframe = (oni_frame_impl_t*)frame;
+        pos = _oni_atomic_load(&w->tail);
+    }
+}
 
-        // Decrement buffer reference count
-        _ref_dec(&(iframe->private.buffer->count));
+// Takes the oldest frame. Returns NULL if the queue is empty.
+static oni_frame_t *_oni_writer_pop(struct oni_writer_impl *w, uint64_t *queued_ns)
+{
+    size_t pos = _oni_atomic_load(&w->head);
+
+    while (1) {
+        struct oni_writer_slot *slot = &w->slots[pos & w->mask];
+        size_t seq = _oni_atomic_load(&slot->seq);
+
+        if (seq == pos + 1) {
+            // Slot holds a frame, claim it
+            if (_oni_atomic_cas(&w->head, pos, pos + 1)) {
+                oni_frame_t *frame = slot->frame;
+                *queued_ns = slot->queued_ns;
+                _oni_atomic_store(&slot->seq, pos + w->mask + 1);
+                return frame;
+            }
+        } else if ((ptrdiff_t)(seq - (pos + 1)) < 0) {
+            // Slot is free or still being filled
+            return NULL;
+        }
 
-        // Free the container
-        free(iframe);
+        pos = _oni_atomic_load(&w->head);
     }
 }
 
-void oni_version(int *major, int *minor, int *patch)
+static int _oni_writer_full(struct oni_writer_impl *w)
 {
-    *major = ONI_VERSION_MAJOR;
-    *minor = ONI_VERSION_MINOR;
-    *patch = ONI_VERSION_PATCH;
+    size_t pos = _oni_atomic_load(&w->tail);
+    return (ptrdiff_t)(_oni_atomic_load(&w->slots[pos & w->mask].seq) - pos) < 0;
 }
 
-const oni_driver_info_t* oni_get_driver_info(const oni_ctx ctx)
+// NB: A slot that has been claimed but not yet filled counts as empty
+static int _oni_writer_empty(struct oni_writer_impl *w)
 {
-    return ctx->driver.info();
+    size_t pos = _oni_atomic_load(&w->head);
+    return (ptrdiff_t)(_oni_atomic_load(&w->slots[pos & w->mask].seq) - (pos + 1)) < 0;
 }
 
-const char *oni_error_str(int err)
+// Called with the time of every frame read
+static inline void _oni_sched_advance(oni_ctx ctx, oni_fifo_time_t time)
 {
-    assert(err > ONI_MINERRORNUM && "Invalid error number.");
-    assert(err <= 0 && "Invalid error number.");
+    struct oni_sched_impl *s = ctx->sched;
+    _oni_atomic_store64(&s->time, time);
 
-    switch (err) {
-        case ONI_ESUCCESS: {
-            return "Success";
-        }
-        case ONI_EPATHINVALID: {
-            return "Invalid stream path";
-        }
-        case ONI_EDEVID: {
-            return "Invalid device ID";
-        }
-        case ONI_EDEVIDX: {
-            return "Invalid device index";
-        }
-        case ONI_EWRITESIZE: {
-            return "Data size is not an integer multiple of the write size for "
-                   "the designated device";
-        }
-        case ONI_EREADFAILURE: {
-            return "Failure to read from a stream or register";
-        }
-        case ONI_EWRITEFAILURE: {
-            return "Failure to write to a stream or register";
-        }
-        case ONI_ENULLCTX: {
-            return "Attempt to use a NULL context";
-        }
-        case ONI_ESEEKFAILURE: {
-            return "Failure to seek on stream";
-        }
-        case ONI_EINVALSTATE: {
-            return "Invalid operation for the current context run state";
-        }
-        case ONI_EINVALOPT: {
-            return "Invalid context option";
-        }
-        case ONI_EINVALARG: {
-            return "Invalid function arguments";
-        }
-        case ONI_ECOBSPACK: {
-            return "Invalid COBS packet";
-        }
-        case ONI_ERETRIG: {
-            return "Attempted to perform a hardware operation before a "
-                   "previous call to the same operation has completed";
-        }
-        case ONI_EBUFFERSIZE: {
-            return "Supplied buffer is too small";
-        }
-        case ONI_EBADDEVTABLE: {
-            return "Badly formatted device table supplied by firmware";
-        }
-        case ONI_EBADALLOC: {
-            return "A memory allocation failed";
-        }
-        case ONI_ECLOSEFAIL: {
-            return "File descriptor close failure (check errno)";
-        }
-        case ONI_EREADONLY: {
-            return "Attempted write to read only object (register, context "
-                   "option, etc)";
-        }
-        case ONI_EUNIMPL: {
-            return "Unimplemented API feature";
-        }
-        case ONI_EINVALREADSIZE: {
-            return "Block read size is smaller than the maximal frame size";
-        }
-        case ONI_ENOREADDEV: {
-            return "Frame read attempted when there are no readable devices in "
-                   "the device table";
-        }
-        case ONI_EWRITEONLY: {
-            return "Attempted to read from a write only object (register, context "
-                   "option, etc)";
-        }
-        case ONI_EINIT: {
-            return "Hardware initialization failed";
-        }
-        case ONI_EINVALWRITESIZE: {
-            return "Write buffer pre-allocation size is smaller than the "
-                   "maximal write frame size";
-        }
-        case ONI_ENOTWRITEDEV: {
-            return "Frame allocation attempted for a non-writable device";
-        }
-        case ONI_EDEVIDXREPEAT: {
-            return "Device table contains repeated device indices";
-        }
-        case ONI_EPROTCONFIG : {
-            return "Attempted to directly read or write a protected "
-                   "configuration option";
+    if (time < s->release_at && _oni_atomic_load(&s->version) == s->seen_version)
+        return;
+
+    _oni_sched_release(ctx, time);
+}
+
+// Writes the frames that are due at time. The mutex is not held while writing
+// so that frames can be scheduled meanwhile.
+static void _oni_sched_release(oni_ctx ctx, oni_fifo_time_t time)
+{
+    struct oni_sched_impl *s = ctx->sched;
+    oni_frame_t *due[ONI_SCHEDBATCH];
+    size_t n;
+
+    do {
+        n = 0;
+
+        _oni_mutex_lock(&s->mutex);
+
+        // NB: Due if heap[0].time - lead <= time, without overflow
+        while (n < ONI_SCHEDBATCH && s->count > 0
+               && (s->heap[0].time <= s->lead || s->heap[0].time - s->lead <= time)) {
+            if (s->heap[0].time < time)
+                s->late++;
+            due[n++] = s->heap[0].frame;
+            _oni_sched_pop(s);
         }
-        case ONI_EBADFRAME:
-        {
-            return "Received malformed frame";
+
+        s->released += n;
+        s->seen_version = s->version;
+        if (s->count == 0)
+            s->release_at = UINT64_MAX;
+        else
+            s->release_at = s->heap[0].time > s->lead ? s->heap[0].time - s->lead : 0;
+
+        _oni_mutex_unlock(&s->mutex);
+
+        if (n == 0)
+            break;
+
+        size_t failed = 0;
+        size_t i;
+        if (ctx->writer != NULL) {
+            for (i = 0; i < n; i++) {
+                if (oni_queue_frame(ctx, due[i])) {
+                    oni_destroy_frame(due[i]);
+                    failed++;
+                }
+            }
+        } else {
+            int rc = _oni_write_frames(ctx, (const oni_frame_t **)due, n);
+            failed = n - (rc > 0 ? (size_t)rc : 0);
+            for (i = 0; i < n; i++)
+                oni_destroy_frame(due[i]);
         }
-        case ONI_EBADCONTROLLER :
-        {
-            return "ONI Controller is not compatible with driver translator";
+
+        if (failed) {
+            _oni_mutex_lock(&s->mutex);
+            s->failed += failed;
+            _oni_mutex_unlock(&s->mutex);
         }
-        default:
-            return "Unknown error";
-    }
-}
 
-static inline oni_dev_idx_t _oni_hash32(oni_dev_idx_t x)
-{
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = (x >> 16) ^ x;
-    return x;
+    } while (n == ONI_SCHEDBATCH);
 }
 
-static inline int _oni_hash32_find(oni_ctx ctx, oni_dev_idx_t x)
+// Removes the earliest frame from the heap. Must hold the mutex.
+static void _oni_sched_pop(struct oni_sched_impl *s)
 {
-    int probe;
+    struct oni_sched_entry last = s->heap[--s->count];
+    size_t i = 0;
+
+    // Sift down
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= s->count)
+            break;
 
-    // TODO: Not sure if this ideal. We are using a hashing function that has no collisions but this
-    // is not true when doing the modulo here and requires and explicitly check == x for that reason.
-    for (probe = _oni_hash32(x) % ctx->dev_hash_len;
-        ctx->dev_hash_table[probe].idx != ONI_DEVIDXNULL;
-        probe = (probe + 1) % ctx->dev_hash_len) {
+        if (child + 1 < s->count
+            && (s->heap[child + 1].time < s->heap[child].time
+                || (s->heap[child + 1].time == s->heap[child].time
+                    && s->heap[child + 1].seq < s->heap[child].seq)))
+            child++;
 
-        if (ctx->dev_hash_table[probe].idx == x)
-            return probe;
+        if (last.time < s->heap[child].time
+            || (last.time == s->heap[child].time && last.seq < s->heap[child].seq))
+            break;
+
+        s->heap[i] = s->heap[child];
+        i = child;
     }
 
-    return -1;
+    s->heap[i] = last;
 }
 
-static int _oni_reset_routine(oni_ctx ctx)
+// Destroys the frames that are still scheduled
+static void _oni_sched_clear(oni_ctx ctx)
 {
-    // Get number of devices
-    oni_signal_t sig_type = NULLSIG;
-    int rc = _oni_pump_signal_data(
-        ctx, DEVICETABLEACK, &sig_type, &(ctx->num_dev), sizeof(ctx->num_dev));
-    if (rc) return rc;
+    struct oni_sched_impl *s = ctx->sched;
 
-    // Hash table size
-    ctx->dev_hash_len = ctx->num_dev * ONI_DEVHASHOVERHEAD + 1;
-
-    // Make space for the device table
-    oni_device_t *temp = realloc(ctx->dev_table,
-                                 ctx->num_dev * sizeof(oni_device_t));
+    _oni_mutex_lock(&s->mutex);
+    while (s->count > 0)
+        oni_destroy_frame(s->heap[--s->count].frame);
+    _oni_atomic_store(&s->version, s->version + 1);
+    _oni_mutex_unlock(&s->mutex);
+}
 
-    if (temp)
-        ctx->dev_table = temp;
-    else
-        return ONI_EBADALLOC;
+#ifdef __linux__
+static int _oni_create_ready(oni_ctx ctx)
+{
+    // NB: Without a driver descriptor, readiness is provided by read-ahead
+    int driver_fd = -1;
+    if (ctx->driver.stream_fd != NULL)
+        driver_fd = ctx->driver.stream_fd(ctx->driver.ctx, ONI_READ_STREAM_DATA);
 
-    // Make space for the device hash table
-    temp = realloc(ctx->dev_hash_table,
-                   ctx->dev_hash_len * sizeof(oni_device_t));
+    if (driver_fd < 0 && (ctx->read_ahead_depth == 0 || ctx->read_ring_size != 0))
+        return ONI_EINVALSTATE;
 
-    if (temp)
-        ctx->dev_hash_table = temp;
-    else
+    struct oni_ready_impl *rd = calloc(1, sizeof(struct oni_ready_impl));
+    if (!rd)
         return ONI_EBADALLOC;
 
-    ctx->max_read_frame_size = 0;
-    ctx->max_write_frame_size = 0;
-    for (size_t i = 0; i < ctx->num_dev; i++) {
+    rd->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rd->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-        sig_type = NULLSIG;
-        uint8_t buffer[ONI_COBSBUFFERSIZE];
-        rc = _oni_read_signal_data(ctx, &sig_type, buffer, ONI_COBSBUFFERSIZE);
-        if (rc) return rc;
+    struct epoll_event ev = {.events = EPOLLIN};
+    if (rd->event_fd < 0 || rd->epoll_fd < 0
+        || epoll_ctl(rd->epoll_fd, EPOLL_CTL_ADD, rd->event_fd, &ev)) {
+        if (rd->event_fd >= 0) close(rd->event_fd);
+        if (rd->epoll_fd >= 0) close(rd->epoll_fd);
+        free(rd);
+        return ONI_EINIT;
+    }
 
-        // We should see num_dev device instances appear on the signal stream
-        if (sig_type != DEVICEINST)
-            return ONI_EBADDEVTABLE;
+    rd->driver_fd = driver_fd >= 0 ? driver_fd : -1;
 
-        // Append the device onto the table
-        memcpy(ctx->dev_table + i, buffer, sizeof(oni_device_t));
+    _oni_mutex_init(&rd->mutex);
+    _oni_xchg_ptr((void *volatile *)&ctx->ready, rd);
 
-        // Check to see if this is the biggest frame in the table
-        if ((ctx->dev_table + i)->read_size > ctx->max_read_frame_size)
-            ctx->max_read_frame_size = (ctx->dev_table + i)->read_size;
+    if (ctx->reader == NULL)
+        _oni_ready_watch_driver(ctx, 1);
 
-        if ((ctx->dev_table + i)->write_size > ctx->max_write_frame_size)
-            ctx->max_write_frame_size = (ctx->dev_table + i)->write_size;
-    }
+    _oni_ready_refresh(ctx, rd);
 
-    // Clear the table
-    for (size_t i = 0; i < ctx->dev_hash_len; i++) {
-        ctx->dev_hash_table[i].idx = ONI_DEVIDXNULL;
-    }
+    return ONI_ESUCCESS;
+}
 
-    // Sort device_table
-    // Check that dev_idx entries are unique (required for hash)
-    // Fill the hash_table table
-    for (size_t i = 0; i < ctx->num_dev; i++) {
+static void _oni_destroy_ready(struct oni_ready_impl *rd)
+{
+    close(rd->epoll_fd);
+    close(rd->event_fd);
+    _oni_mutex_destroy(&rd->mutex);
+    free(rd);
+}
 
-        // NB: i = ctx->num_dev - 1 will not loop
-        size_t min_idx = i;
-        for (size_t j = i + 1; j < ctx->num_dev; j++) {
+// Called by the read-ahead producer and the consumer
+static void _oni_ready_raise(struct oni_ready_impl *rd)
+{
+    if (rd == NULL || _oni_atomic_load(&rd->raised))
+        return;
+
+    _oni_mutex_lock(&rd->mutex);
+    if (!rd->raised) {
+        uint64_t one = 1;
+        if (write(rd->event_fd, &one, sizeof(one)) == sizeof(one))
+            _oni_atomic_store(&rd->raised, 1);
+    }
+    _oni_mutex_unlock(&rd->mutex);
+}
 
-            if (ctx->dev_table[i].idx == ctx->dev_table[j].idx)
-                return ONI_EDEVIDXREPEAT;
+// Sets the eventfd from the state of the read buffers. NB: It is lowered
+// before the read-ahead queue is checked so that a block published
+// concurrently is either seen here or raises the eventfd again.
+static void _oni_ready_refresh(oni_ctx ctx, struct oni_ready_impl *rd)
+{
+    _oni_mutex_lock(&rd->mutex);
 
-            if (ctx->dev_table[j].idx < ctx->dev_table[min_idx].idx)
-                min_idx = j;
+    if (rd->raised) {
+        uint64_t count;
+        if (read(rd->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            _oni_mutex_unlock(&rd->mutex);
+            return;
         }
+        _oni_atomic_store(&rd->raised, 0);
+    }
 
-        // Swap place device i and min_idx
-        oni_device_t tmpDev = ctx->dev_table[min_idx];
-        ctx->dev_table[min_idx] = ctx->dev_table[i];
-        ctx->dev_table[i] = tmpDev;
+    size_t remaining = ctx->shared_rbuf != NULL ?
+        ctx->shared_rbuf->end_pos - ctx->shared_rbuf->read_pos : 0;
 
-        // Hashing with open addressing
-        size_t probe;
-        for (probe = _oni_hash32(ctx->dev_table[i].idx) % ctx->dev_hash_len;
-             ctx->dev_hash_table[probe].idx != ONI_DEVIDXNULL;
-             probe = (probe + 1) % ctx->dev_hash_len) {
-        };
+    int ready = remaining >= ctx->max_read_frame_size;
 
-        assert(ctx->dev_hash_table[probe].idx == ONI_DEVIDXNULL);
-        ctx->dev_hash_table[probe] = ctx->dev_table[i];
-    }
+    struct oni_readahead_impl *ra = ctx->reader;
+    if (ra != NULL)
+        ready |= ra->head != _oni_atomic_load(&ra->tail) || _oni_atomic_load(&ra->done);
 
-    // Add the header contents to the read size
-    ctx->max_read_frame_size += ONI_RFRAMEHEADERSZ;
-    ctx->max_write_frame_size += ONI_WFRAMEHEADERSZ;
+    if (ready) {
+        uint64_t one = 1;
+        if (write(rd->event_fd, &one, sizeof(one)) == sizeof(one))
+            _oni_atomic_store(&rd->raised, 1);
+    }
 
-    // NB: Default the block read size to a single max sized frame. This is bad
-    // for high bandwidth performance and good for closed-loop delay. The opposite is true
-    // for write frames (to an extent) so this is defaulted to something large.
-    size_t align = sizeof(oni_fifo_dat_t);
-    ctx->block_read_size = (ctx->max_read_frame_size + align - 1) & ~(align - 1);
-    ctx->block_write_size = (ctx->max_write_frame_size + align - 1) & ~(align - 1);
+    _oni_mutex_unlock(&rd->mutex);
+}
 
-    // Set the block read size in the driver, in case it needs it
-    ctx->driver.set_opt_callback(ctx->driver.ctx,
-                                 ONI_OPT_BLOCKREADSIZE,
-                                 &(ctx->block_read_size),
-                                 sizeof(ctx->block_read_size));
+// Adds or removes the driver's descriptor from the epoll set
+static void _oni_ready_watch_driver(oni_ctx ctx, int watch)
+{
+    struct oni_ready_impl *rd = ctx->ready;
+    if (rd == NULL || rd->driver_fd < 0 || rd->driver_fd_watched == watch)
+        return;
 
-    return ONI_ESUCCESS;
+    struct epoll_event ev = {.events = EPOLLIN};
+    if (!epoll_ctl(rd->epoll_fd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, rd->driver_fd, &ev))
+        rd->driver_fd_watched = watch;
 }
+#endif
 
-static inline int _oni_read(oni_ctx ctx, oni_read_stream_t stream, void *data, size_t size)
+// Called by the consumer after it has taken frames from the current buffer.
+// NB: This is only a load and compare unless the buffer has just been drained.
+static inline void _oni_ready_update(oni_ctx ctx)
 {
-    return ctx->driver.read_stream(ctx->driver.ctx, stream, data, size);
+#ifdef __linux__
+    struct oni_ready_impl *rd = _oni_load_ptr((void *volatile *)&ctx->ready);
+    if (rd == NULL)
+        return;
+
+    size_t remaining = ctx->shared_rbuf != NULL ?
+        ctx->shared_rbuf->end_pos - ctx->shared_rbuf->read_pos : 0;
+
+    if (remaining >= ctx->max_read_frame_size)
+        _oni_ready_raise(rd);
+    else if (_oni_atomic_load(&rd->raised))
+        _oni_ready_refresh(ctx, rd);
+#else
+    (void)ctx;
+#endif
 }
 
-static inline int _oni_write(oni_ctx ctx, oni_write_stream_t stream, const char *data, size_t size)
+static int _oni_next_frame_view(oni_ctx ctx, oni_frame_view_t *view)
 {
-    return ctx->driver.write_stream(ctx->driver.ctx, stream, data, size);
+    int rc = _oni_ensure_read_buffer(ctx);
+    if (rc) return rc;
+
+    struct oni_buf_impl *buffer = ctx->shared_rbuf;
+    assert(buffer->read_pos + ONI_RFRAMEHEADERSZ <= buffer->end_pos
+           && "Attempted to read past buffer end");
+
+    // Copy frame header members (continuous)
+    memcpy(&view->time, buffer->read_pos, ONI_RFRAMEHEADERSZ);
+    buffer->read_pos += ONI_RFRAMEHEADERSZ;
+
+    if (view->data_sz == 0 || view->data_sz > ctx->max_read_frame_size)
+        return ONI_EBADFRAME;
+
+    // Find read size (+ padding)
+    size_t rsize = view->data_sz;
+    rsize += rsize % sizeof(oni_fifo_dat_t);
+
+    assert(buffer->read_pos + rsize <= buffer->end_pos
+           && "Attempted to read past buffer end");
+    view->data = (const char *)buffer->read_pos;
+    view->buffer = buffer;
+    buffer->read_pos += rsize;
+
+    // NB: Covers both oni_next_frame_view and the demultiplexer
+    _oni_sched_advance(ctx, view->time);
+
+    return ONI_ESUCCESS;
 }
 
-static inline int _oni_read_signal_packet(oni_ctx ctx, uint8_t *buffer)
+static int _oni_start_demux(oni_ctx ctx)
 {
-    // Read the next zero-delimited packet
-    int i = 0;
-    uint8_t curr_byte = 1;
-    int bad_delim = 0;
-    while (curr_byte != 0) {
-        int rc = _oni_read(ctx, ONI_READ_STREAM_SIGNAL, &curr_byte, 1);
-        if (rc != 1) return rc;
+    struct oni_demux_impl *dm = calloc(1, sizeof(struct oni_demux_impl));
+    if (!dm)
+        return ONI_EBADALLOC;
 
-        if (i < 255)
-            buffer[i] = curr_byte;
-        else
-            bad_delim = 1;
+    dm->routes = calloc(ctx->num_dev, sizeof(struct oni_sub_impl *));
+    if (!dm->routes) {
+        free(dm);
+        return ONI_EBADALLOC;
+    }
+
+    dm->ctx = ctx;
 
-        i++;
+    // NB: Subscribed devices that are no longer in the device table (e.g.
+    // after a reset) are ignored
+    struct oni_sub_impl *sub;
+    size_t i;
+    for (sub = ctx->subs; sub != NULL; sub = sub->next) {
+
+        for (i = 0; i < sub->num_devs; i++) {
+            int slot = _oni_dev_find(ctx, sub->dev_idxs[i]);
+            if (slot >= 0)
+                dm->routes[slot] = sub;
+        }
+
+        _oni_atomic_store(&sub->active, 1);
     }
 
-    if (bad_delim)
-        return ONI_ECOBSPACK;
-    else
-        return --i; // Length of packet without 0 delimiter
+    int rc = _oni_thread_create(&dm->thread, _oni_demux_loop, dm, ctx->demux_cpu);
+    if (rc) {
+        for (sub = ctx->subs; sub != NULL; sub = sub->next)
+            _oni_atomic_store(&sub->active, 0);
+        free(dm->routes);
+        free(dm);
+        return rc;
+    }
+
+    ctx->demux = dm;
+
+    return ONI_ESUCCESS;
 }
 
-static int _oni_read_signal_data(oni_ctx ctx, oni_signal_t *type, void *data, size_t size)
+static void _oni_stop_demux(oni_ctx ctx)
 {
-    if (type == NULL)
-        return ONI_EINVALARG;
+    struct oni_demux_impl *dm = ctx->demux;
+    if (dm == NULL)
+        return;
 
-    uint8_t buffer[255] = {0};
+    _oni_atomic_store(&dm->stop, 1);
+    _oni_thread_join(dm->thread);
 
-    int pack_size = _oni_read_signal_packet(ctx, buffer);
-    if (pack_size < 0) return pack_size;
+    free(dm->routes);
+    free(dm);
+
+    ctx->demux = NULL;
+}
+
+// NB: While the demultiplexer exists, it is the only reader of frames from
+// the context and the subscription list does not change
+static void _oni_demux_loop(void *arg)
+{
+    struct oni_demux_impl *dm = arg;
+    oni_ctx ctx = dm->ctx;
+    int rc = ONI_ESUCCESS;
+
+    // NB: tail of each queue is only written by this thread
+    while (!_oni_atomic_load(&dm->stop)) {
+
+        oni_frame_view_t view;
+        rc = _oni_next_frame_view(ctx, &view);
+        if (rc) break;
+
+        int slot = _oni_dev_find(ctx, view.dev_idx);
+        struct oni_sub_impl *sub = slot >= 0 ? dm->routes[slot] : NULL;
+        if (sub == NULL)
+            continue;
 
-    // Unstuff the packet
-    int rc = _oni_cobs_unstuff(buffer, buffer, pack_size);
-    if (rc < 0) return rc;
+        // Subscriber is not keeping up
+        if (sub->tail - _oni_atomic_load(&sub->head) > sub->mask) {
+            _oni_atomic_store(&sub->dropped, sub->dropped + 1);
+            continue;
+        }
 
-    // Remove the overhead byte and signal type
-    // and make sure the buffer size is sufficient
-    if ((int)size < (--pack_size - 4))
-        return ONI_EBUFFERSIZE;
+        oni_frame_t *frame = NULL;
+        rc = oni_promote_frame_view(ctx, &view, &frame);
+        if (rc) break;
 
-    // Get the type, which occupies first 4 bytes of buffer
-    memcpy(type, buffer, sizeof(oni_signal_t));
+        // Publish the frame
+        sub->frames[sub->tail & sub->mask] = frame;
+        _oni_atomic_store(&sub->tail, sub->tail + 1);
 
-    // pack_size still has overhead byte and header, so we remove those
-    size_t data_size = pack_size - sizeof(oni_signal_t);
-    if (size < data_size)
-        return ONI_EBUFFERSIZE;
+        if (_oni_atomic_load(&sub->consumer_waiting)) {
+            _oni_mutex_lock(&sub->mutex);
+            _oni_cond_broadcast(&sub->cond);
+            _oni_mutex_unlock(&sub->mutex);
+        }
+    }
 
-    // Copy remaining data into data buffer and update size to reflect the
-    // actual data payload size
-    memcpy(data, buffer + sizeof(oni_signal_t), data_size);
+    if (rc == ONI_ESUCCESS)
+        rc = ONI_EINVALSTATE;
+
+    // Wake subscribers so that they see the demultiplexer has stopped
+    struct oni_sub_impl *sub;
+    for (sub = ctx->subs; sub != NULL; sub = sub->next) {
+        _oni_mutex_lock(&sub->mutex);
+        sub->rc = rc;
+        _oni_atomic_store(&sub->active, 0);
+        _oni_cond_broadcast(&sub->cond);
+        _oni_mutex_unlock(&sub->mutex);
+    }
+}
 
-    return ONI_ESUCCESS;
+static void _oni_destroy_sub(struct oni_sub_impl *sub)
+{
+    while (sub->head != sub->tail)
+        oni_destroy_frame(sub->frames[sub->head++ & sub->mask]);
+
+    _oni_cond_destroy(&sub->cond);
+    _oni_mutex_destroy(&sub->mutex);
+    free(sub->frames);
+    free(sub->dev_idxs);
+    free(sub);
 }
 
-static int _oni_pump_signal_type(oni_ctx ctx, int flags, oni_signal_t *type)
+// Passes the frames of the read block that was just installed to the
+// triggers. remaining is the number of bytes carried over from the previous
+// block, the end of which might not have been scanned yet, and read_ns is
+// when the block was read.
+static void _oni_trig_scan(oni_ctx ctx, size_t remaining, uint64_t read_ns)
 {
-    oni_signal_t packet_type = NULLSIG;
-    uint8_t buffer[255] = {0};
+    struct oni_buf_impl *buffer = ctx->shared_rbuf;
+    size_t unscanned = ctx->trig_unscanned < remaining ? ctx->trig_unscanned : remaining;
+    uint8_t *pos = buffer->read_pos + remaining - unscanned;
 
-    do {
-        int pack_size = _oni_read_signal_packet(ctx, buffer);
+    struct oni_trigger_stats_impl *st = ctx->trig_stats;
+    struct oni_trigger_counts *c = &st->counts;
 
-        if (pack_size < 1)
-            continue; // Something wrong with delimiter, try again
+    oni_frame_index_t index[ONI_INDEXCHUNK];
+    uint64_t evaluated = 0;
+    size_t k;
 
-        // Unstuff the packet (last byte is the 0, so we decrement
-        int rc = _oni_cobs_unstuff(buffer, buffer, pack_size);
-        if (rc < 0)
-            continue; // Something wrong with packet, try again
+    do {
+        k = ctx->index_block(
+            pos, buffer->end_pos, ctx->max_read_frame_size, index, ONI_INDEXCHUNK);
+
+        size_t i;
+        for (i = 0; i < k; i++) {
+
+            struct oni_trigger_impl *t;
+            for (t = ctx->triggers; t != NULL; t = t->next) {
+
+                if (t->dev_idx != index[i].dev_idx)
+                    continue;
+
+                oni_frame_view_t view;
+                view.time = index[i].time;
+                view.dev_idx = index[i].dev_idx;
+                view.data_sz = index[i].data_sz;
+                view.data = (const char *)pos + index[i].offset + ONI_RFRAMEHEADERSZ;
+                view.buffer = buffer;
+                evaluated++;
+
+                if (!t->predicate(&view, t->frame, t->user))
+                    continue;
+
+                int rc = _oni_write_frames(ctx, (const oni_frame_t **)&t->frame, 1);
+                uint64_t latency_ns = _oni_clock_ns() - read_ns;
+
+                // NB: Stores are ordered after seq turns odd and before it
+                // turns even again
+                _oni_atomic_store64(&st->seq, st->seq + 1);
+                if (rc != 1) {
+                    _oni_atomic_store64(&c->failed, c->failed + 1);
+                } else {
+                    size_t bucket = _oni_latency_bucket(latency_ns);
+                    _oni_atomic_store64(&c->fired, c->fired + 1);
+                    _oni_atomic_store64(&c->latency_sum_ns, c->latency_sum_ns + latency_ns);
+                    if (latency_ns > c->max_latency_ns)
+                        _oni_atomic_store64(&c->max_latency_ns, latency_ns);
+                    _oni_atomic_store64(&c->latency_hist[bucket], c->latency_hist[bucket] + 1);
+                }
+                _oni_atomic_store64(&st->seq, st->seq + 1);
+            }
+        }
 
-        // Get the type, which occupies first 4 bytes of buffer
-        memcpy(&packet_type, buffer, sizeof(oni_signal_t));
+        if (k > 0)
+            pos += index[k - 1].offset + index[k - 1].size;
 
-    } while (!(packet_type & flags));
+    } while (k == ONI_INDEXCHUNK);
 
-    *type = packet_type;
+    // NB: Scanning stops at the first incomplete or malformed frame
+    ctx->trig_unscanned = buffer->end_pos - pos;
 
-    return ONI_ESUCCESS;
+    if (evaluated > 0) {
+        _oni_atomic_store64(&st->seq, st->seq + 1);
+        _oni_atomic_store64(&c->evaluated, c->evaluated + evaluated);
+        _oni_atomic_store64(&st->seq, st->seq + 1);
+    }
 }
 
-static int _oni_pump_signal_data(oni_ctx ctx, int flags, oni_signal_t *type, void *data, int size)
+// Copies the trigger counters into snapshot, retrying while the reading
+// thread updates them. Must hold the statistics mutex.
+static void _oni_trig_snapshot(struct oni_trigger_stats_impl *st)
 {
-    oni_signal_t packet_type = NULLSIG;
-    int pack_size = 0;
-    uint8_t buffer[255] = {0};
+    struct oni_trigger_counts *c = &st->counts, *s = &st->snapshot;
+    uint64_t seq;
 
     do {
-        pack_size = _oni_read_signal_packet(ctx, buffer);
-
-        if (pack_size < 1)
-            continue; // Something wrong with delimiter, try again
+        while ((seq = _oni_atomic_load64(&st->seq)) & 1)
+            ;
 
-        // Unstuff the packet (last byte is the 0, so we decrement
-        int rc = _oni_cobs_unstuff(buffer, buffer, pack_size);
-        if (rc < 0)
-            continue;
-
-        // Get the type, which occupies first 4 bytes of buffer
-        memcpy(&packet_type, buffer, sizeof(oni_signal_t));
-
-    } while (!(packet_type & flags));
-
-    *type = packet_type;
+        s->evaluated = _oni_atomic_load64(&c->evaluated);
+        s->fired = _oni_atomic_load64(&c->fired);
+        s->failed = _oni_atomic_load64(&c->failed);
+        s->latency_sum_ns = _oni_atomic_load64(&c->latency_sum_ns);
+        s->max_latency_ns = _oni_atomic_load64(&c->max_latency_ns);
 
-    // pack_size still has overhead byte and header, so we remove those
-    int data_size = pack_size - 1 - sizeof(oni_signal_t);
-    if (size < data_size)
-        return ONI_EBUFFERSIZE;
+        size_t i;
+        for (i = 0; i < ONI_LATENCYBUCKETS; i++)
+            s->latency_hist[i] = _oni_atomic_load64(&c->latency_hist[i]);
 
-    // Copy remaining data into data buffer and update size to reflect the
-    // actual data payload size
-    memcpy(data, buffer + sizeof(oni_signal_t), data_size);
-
-    return ONI_ESUCCESS;
+    } while (_oni_atomic_load64(&st->seq) != seq);
 }
 
-static int _oni_cobs_unstuff(uint8_t *dst, const uint8_t *src, size_t size)
+// Values below 1 << ONI_LATENCYSUBBITS have a bucket each. Above, each power
+// of two is split into 1 << ONI_LATENCYSUBBITS buckets.
+static inline size_t _oni_latency_bucket(uint64_t ns)
 {
-    // Minimal COBS packet is 1 overhead byte + 1 data byte
-    // Maximal COBS packet is 1 overhead byte + 254 data bytes
-    assert(size >= 2 && size <= 255 && "Invalid COBS packet buffer size.");
+    const uint64_t sub_buckets = (uint64_t)1 << ONI_LATENCYSUBBITS;
+    if (ns < sub_buckets)
+        return (size_t)ns;
 
-    const uint8_t *end = src + size;
-    while (src < end) {
-        int code = *src++;
-        int i;
-        for (i = 1; src < end && i < code; i++)
-            *dst++ = *src++;
-        if (code < 0xFF)
-            *dst++ = 0;
-    }
+    unsigned shift = 0;
+    while ((ns >> shift) >= 2 * sub_buckets)
+        shift++;
 
-    return ONI_ESUCCESS;
+    return ((size_t)(shift + 1) << ONI_LATENCYSUBBITS) + (size_t)((ns >> shift) & (sub_buckets - 1));
 }
 
-static inline int _oni_write_config(oni_ctx ctx, oni_config_t reg, oni_reg_val_t value)
+// Largest value counted in bucket
+static inline uint64_t _oni_latency_bucket_max(size_t bucket)
 {
-    return ctx->driver.write_config(ctx->driver.ctx, reg, value);
+    const uint64_t sub_buckets = (uint64_t)1 << ONI_LATENCYSUBBITS;
+    if (bucket < sub_buckets)
+        return bucket;
+
+    unsigned shift = (unsigned)(bucket >> ONI_LATENCYSUBBITS) - 1;
+    uint64_t low = (sub_buckets + (bucket & (sub_buckets - 1))) << shift;
+    return low + (((uint64_t)1 << shift) - 1);
 }
 
-static inline int _oni_read_config(oni_ctx ctx, oni_config_t reg, oni_reg_val_t *value)
+// Smallest bucket bound below which a fraction p of the fired latencies fall
+static uint64_t _oni_latency_percentile(const struct oni_trigger_counts *c, double p)
 {
-    return ctx->driver.read_config(ctx->driver.ctx, reg, value);
+    uint64_t target = (uint64_t)(p * c->fired);
+    if (target < p * c->fired || target == 0)
+        target++;
+
+    uint64_t seen = 0;
+    size_t i;
+    for (i = 0; i < ONI_LATENCYBUCKETS; i++) {
+        seen += c->latency_hist[i];
+        if (seen >= target) {
+            uint64_t bound = _oni_latency_bucket_max(i);
+            return bound < c->max_latency_ns ? bound : c->max_latency_ns;
+        }
+    }
+
+    return c->max_latency_ns;
 }
 
-static int _oni_ensure_read_buffer(oni_ctx ctx)
+#ifdef __linux__
+static int _oni_ensure_ring_buffer(oni_ctx ctx)
 {
-    // NB: This function can only be called if the device table has been 
-    // populated and contains devices that produce data.
-    if (ctx->max_read_frame_size == 0)
-        return ONI_EINVALARG;
-
     // Remaining bytes in buffer
     size_t remaining = ctx->shared_rbuf != NULL ?
         ctx->shared_rbuf->end_pos - ctx->shared_rbuf->read_pos : 0;
 
-    // NB: Refill when remaining < max_read_frame_size to guarantee that after
-    // this call the buffer holds enough data for both the frame header and its
-    // maximum-sized payload. This allows _oni_consume_buffer to read the payload
-    // without ever triggering a second refill, keeping each frame inside a single
-    // buffer object.
-    if (remaining < ctx->max_read_frame_size) {
+    // NB: Same refill condition as the block path, so frames never extend
+    // past the data read into the ring so far
+    if (remaining >= ctx->max_read_frame_size)
+        return ONI_ESUCCESS;
 
-        assert(ctx->max_read_frame_size <= ctx->block_read_size &&
-            "Block read size is too small given the possible read frame size.");
+    struct oni_ring_impl *ring = ctx->ring;
 
-        // New buffer allocated, old_buffer saved
-        struct oni_buf_impl *old_buffer = ctx->shared_rbuf;
-        ctx->shared_rbuf = malloc(sizeof(struct oni_buf_impl));
-        if (!ctx->shared_rbuf) {
-            ctx->shared_rbuf = old_buffer;
-            return ONI_EBADALLOC;
-        }
+    // (Re)create the ring if it does not exist or has the wrong geometry
+    if (ring == NULL || ring->block_size != ctx->block_read_size
+        || ring->frame_size != ctx->max_read_frame_size
+        || ring->size < ctx->read_ring_size) {
 
-        // Allocate data block in buffer
-        ctx->shared_rbuf->buffer = malloc(remaining + ctx->block_read_size);
-        if (!ctx->shared_rbuf->buffer) {
-            free(ctx->shared_rbuf);
-            ctx->shared_rbuf = old_buffer;
+        ring = _oni_create_ring(ctx);
+        if (!ring)
             return ONI_EBADALLOC;
-        }
 
-        // Transfer remaining data to new buffer
-        if (old_buffer != NULL) {
+        if (ctx->ring != NULL)
+            _ref_dec(&(ctx->ring->count));
+        ctx->ring = ring;
+    }
+
+    // Reclaim released segments
+    while (ring->tail != ring->head
+           && __atomic_load_n(&ring->segs[ring->tail % ring->num_segs].released,
+                              __ATOMIC_ACQUIRE))
+        ring->tail++;
+
+    // The unread tail is already in front of the next block if the current
+    // buffer is the newest segment. Otherwise (new ring or after a block
+    // refill) it is copied to the write position first.
+    int in_ring = ring->tail != ring->head
+        && ctx->shared_rbuf == &ring->segs[(ring->head - 1) % ring->num_segs].buf;
+    uint64_t end_pos = ring->write_pos + ring->block_size + (in_ring ? 0 : remaining);
+
+    // NB: If frames still reference the ring memory about to be written, or
+    // every segment descriptor is in use, this refill goes to a block from
+    // the pool instead. Waiting for those frames to be destroyed could
+    // deadlock when they are held by the calling thread.
+    if (ring->head - ring->tail == ring->num_segs
+        || (ring->tail != ring->head
+            && ring->segs[ring->tail % ring->num_segs].start + ring->size < end_pos))
+        return _oni_refill_block(ctx, remaining);
+
+    if (!in_ring) {
+        if (ctx->shared_rbuf != NULL)
+            memcpy(ring->base + (ring->write_pos % ring->size),
+                   ctx->shared_rbuf->read_pos,
+                   remaining);
+        ring->write_pos += remaining;
+    }
 
-            // Copy remaining contents into new buffer
-            memcpy(ctx->shared_rbuf->buffer, old_buffer->read_pos, remaining);
+    // Absolute stream position of the unread tail
+    uint64_t read_pos = ring->write_pos - remaining;
+
+    // New segment starts with the unread tail
+    struct oni_ring_seg *seg = &ring->segs[ring->head++ % ring->num_segs];
+    seg->start = read_pos;
+    seg->released = 0;
+    seg->buf.buffer = ring->base + (read_pos % ring->size);
+    seg->buf.read_pos = seg->buf.buffer;
+    seg->buf.end_pos = seg->buf.buffer + remaining + ring->block_size;
+    seg->buf.pool = ctx->pool;
+    seg->buf.count = (struct ref){_oni_release_ring_segment, 1};
+    _ref_inc(&(ctx->pool->count));
+    _ref_inc(&(ring->count));
+
+    // Context releases control of old buffer
+    if (ctx->shared_rbuf != NULL)
+        _ref_dec(&(ctx->shared_rbuf->count));
+    ctx->shared_rbuf = &seg->buf;
 
-            // Context releases control of old buffer
-            _ref_dec(&(old_buffer->count));
-        }
+    // Fill the ring with new data
+    int rc = _oni_read(ctx, ONI_READ_STREAM_DATA,
+                       ring->base + (ring->write_pos % ring->size),
+                       ring->block_size);
+    if ((size_t)rc != ring->block_size) return ONI_EREADFAILURE;
 
-        // (Re)set buffer state
-        ctx->shared_rbuf->count = (struct ref) {_oni_destroy_buffer, 1};
-        ctx->shared_rbuf->read_pos = ctx->shared_rbuf->buffer;
-        ctx->shared_rbuf->end_pos
-            = ctx->shared_rbuf->buffer + remaining + ctx->block_read_size;
+    ring->write_pos += ring->block_size;
 
-        // Fill the buffer with new data
-        int rc = _oni_read(ctx, ONI_READ_STREAM_DATA,
-                          ctx->shared_rbuf->buffer + remaining,
-                          ctx->block_read_size);
-        if ((size_t)rc != ctx->block_read_size) return ONI_EREADFAILURE;
-    }
+    if (ctx->triggers != NULL)
+        _oni_trig_scan(ctx, remaining, _oni_clock_ns());
 
     return ONI_ESUCCESS;
 }
+#endif
 
 static int _oni_alloc_write_buffer(oni_ctx ctx, void **data, size_t size)
 {
@@ -1301,28 +5441,21 @@ static int _oni_alloc_write_buffer(oni_ctx ctx, void **data, size_t size)
         assert(ctx->max_write_frame_size <= ctx->block_write_size &&
             "Block write size is too small given the possible write frame size.");
 
-        // New buffer allocated, old_buffer saved
+        // New buffer taken from pool, old_buffer saved
         struct oni_buf_impl *old_buffer = ctx->shared_wbuf;
-        ctx->shared_wbuf = malloc(sizeof(struct oni_buf_impl));
+        ctx->shared_wbuf = _oni_acquire_write_block(ctx);
         if (!ctx->shared_wbuf) {
             ctx->shared_wbuf = old_buffer;
             return ONI_EBADALLOC;
         }
 
-        // Allocate data block in buffer
-        ctx->shared_wbuf->buffer = malloc(ctx->block_write_size);
-        if (!ctx->shared_wbuf->buffer) {
-            free(ctx->shared_wbuf);
-            ctx->shared_wbuf = old_buffer;
-            return ONI_EBADALLOC;
-        }
-
         // Context releases control of old buffer
         if (old_buffer != NULL)
             _ref_dec(&(old_buffer->count));
 
         // (Re)set buffer state
-        ctx->shared_wbuf->count = (struct ref) { _oni_destroy_buffer, 1 };
+        ctx->shared_wbuf->pool = ctx->pool;
+        _ref_inc(&(ctx->pool->count));
         ctx->shared_wbuf->read_pos = ctx->shared_wbuf->buffer;
         ctx->shared_wbuf->end_pos
             = ctx->shared_wbuf->buffer + ctx->block_write_size;
@@ -1335,6 +5468,74 @@ static int _oni_alloc_write_buffer(oni_ctx ctx, void **data, size_t size)
     return ONI_ESUCCESS;
 }
 
+// Takes a frame descriptor and space for its header and data from the shared
+// write buffer and writes the header. Returns the size of the public portion
+// of the frame.
+static int _oni_create_write_frame(oni_ctx ctx,
+                                   oni_frame_impl_t **frame,
+                                   oni_dev_idx_t dev_idx,
+                                   size_t data_sz)
+{
+    // Get the device table position
+    int i = _oni_dev_find(ctx, dev_idx);
+    if (i < 0) return ONI_EDEVIDX;
+
+    // Check that the devices accepts data
+    if (ctx->dev_table[i].write_size == 0)
+        return ONI_ENOTWRITEDEV;
+
+    // Check that data_sz is a multiple of write_size
+    if (data_sz % ctx->dev_table[i].write_size != 0)
+        return ONI_EWRITESIZE;
+
+    // Total frame size
+    int total_size = sizeof(oni_frame_t);
+
+    // Pad if needed
+    size_t asize = data_sz;
+    asize += asize % sizeof(oni_fifo_dat_t);
+    total_size += asize;
+
+    _oni_mutex_lock(&ctx->write_mutex);
+
+    // Allocate data storage
+    char *buffer_start = NULL;
+    int rc = _oni_alloc_write_buffer(ctx, (void **)&buffer_start, ONI_WFRAMEHEADERSZ + asize);
+    if (rc) {
+        _oni_mutex_unlock(&ctx->write_mutex);
+        return rc;
+    }
+
+    // Get frame descriptor from pool
+    oni_frame_impl_t *iframe = _oni_acquire_frame(ctx->pool, &ctx->pool->wcache);
+    if (!iframe) {
+        _oni_mutex_unlock(&ctx->write_mutex);
+        return ONI_EBADALLOC;
+    }
+
+    // Fill out public fields
+    // NB: https://stackoverflow.com/questions/9691404/how-to-initialize-const-in-a-struct-in-c-with-malloc
+    *(oni_size_t *)&iframe->private.f.dev_idx = dev_idx;
+    *(oni_size_t *)&iframe->private.f.data_sz = data_sz;
+    iframe->private.f.data = buffer_start + ONI_WFRAMEHEADERSZ;
+
+    // Copy frame header members into start of continuous buffer, before data
+    // 0. index (4)
+    // 1. data_sz (4)
+    *((oni_fifo_dat_t *)buffer_start + 0) = iframe->private.f.dev_idx;
+    *((oni_fifo_dat_t *)buffer_start + 1) = iframe->private.f.data_sz >> BYTE_TO_FIFO_SHIFT;
+
+    // Update buffer ref count and provide reference to frame
+    _ref_inc(&(ctx->shared_wbuf->count));
+    iframe->private.buffer = ctx->shared_wbuf;
+
+    _oni_mutex_unlock(&ctx->write_mutex);
+
+    *frame = iframe;
+
+    return total_size;
+}
+
 // NB: Allow context to release control of buffer without refilling in the case
 // of restart
 static void _oni_dump_buffers(oni_ctx ctx)
@@ -1343,20 +5544,353 @@ static void _oni_dump_buffers(oni_ctx ctx)
     if (ctx->shared_rbuf != NULL)
         ctx->shared_rbuf->read_pos = ctx->shared_rbuf->end_pos;
 
+    _oni_mutex_lock(&ctx->write_mutex);
     if (ctx->shared_wbuf != NULL)
         ctx->shared_wbuf->read_pos = ctx->shared_wbuf->end_pos;
+    _oni_mutex_unlock(&ctx->write_mutex);
 }
 
-// NB: Stolen from Linux kernel. Used to get the buffer holding a given
-// reference count for buffer freeing.
-#define container_of(ptr, type, member) \
-    ((type *)((char *)(ptr) - offsetof(type, member)))
-
 static void _oni_destroy_buffer(const struct ref *ref)
 {
     struct oni_buf_impl *buf = container_of(ref, struct oni_buf_impl, count);
-    free(buf->buffer);
+    struct oni_pool_impl *pool = buf->pool;
+    _oni_free_block(buf->buffer);
     free(buf);
+
+    // Buffer releases its hold on the pool
+    _ref_dec(&(pool->count));
+}
+
+// NB: Read blocks are only acquired by the thread reading frames
+static struct oni_buf_impl *_oni_acquire_read_block(oni_ctx ctx, size_t headroom)
+{
+    struct oni_pool_impl *pool = ctx->pool;
+
+    // Private list is empty, so claim everything that has been released
+    if (pool->rblocks_free == NULL)
+        pool->rblocks_free
+            = _oni_xchg_ptr((void *volatile *)&pool->rblocks_returned, NULL);
+
+    while (pool->rblocks_free != NULL) {
+
+        struct oni_buf_impl *buf = pool->rblocks_free;
+        pool->rblocks_free = buf->next;
+
+        if (buf->headroom == headroom && buf->block_size == ctx->block_read_size
+            && pool->rblocks_count <= pool->rblocks_depth) {
+            buf->count = (struct ref){_oni_recycle_read_block, 1};
+            return buf;
+        }
+
+        // Block is stale (frame or block size changed) or surplus
+        pool->rblocks_count--;
+        _oni_free_block(buf->buffer);
+        free(buf);
+    }
+
+    int pooled = pool->rblocks_count < pool->rblocks_depth;
+    if (!pooled)
+        pool->rblocks_exhausted++;
+
+    struct oni_buf_impl *buf = malloc(sizeof(struct oni_buf_impl));
+    if (!buf)
+        return NULL;
+
+    buf->buffer = _oni_alloc_block(headroom + ctx->block_read_size,
+                                   ctx->block_read_size);
+    if (!buf->buffer) {
+        free(buf);
+        return NULL;
+    }
+
+    buf->headroom = headroom;
+    buf->block_size = ctx->block_read_size;
+
+    // Blocks allocated after the pool is exhausted are freed when released
+    if (pooled) {
+        pool->rblocks_count++;
+        buf->count = (struct ref){_oni_recycle_read_block, 1};
+    } else {
+        buf->count = (struct ref){_oni_destroy_buffer, 1};
+    }
+
+    return buf;
+}
+
+static void _oni_recycle_read_block(const struct ref *ref)
+{
+    struct oni_buf_impl *buf = container_of(ref, struct oni_buf_impl, count);
+    struct oni_pool_impl *pool = buf->pool;
+
+    do {
+        buf->next = _oni_load_ptr((void *volatile *)&pool->rblocks_returned);
+    } while (!_oni_cas_ptr((void *volatile *)&pool->rblocks_returned, buf->next, buf));
+
+    // Buffer releases its hold on the pool
+    _ref_dec(&(pool->count));
+}
+
+// NB: Write blocks are only acquired by the thread creating write frames
+static struct oni_buf_impl *_oni_acquire_write_block(oni_ctx ctx)
+{
+    struct oni_pool_impl *pool = ctx->pool;
+
+    // Private list is empty, so claim everything that has been released
+    if (pool->wblocks_free == NULL)
+        pool->wblocks_free
+            = _oni_xchg_ptr((void *volatile *)&pool->wblocks_returned, NULL);
+
+    while (pool->wblocks_free != NULL) {
+
+        struct oni_buf_impl *buf = pool->wblocks_free;
+        pool->wblocks_free = buf->next;
+
+        if (buf->block_size == ctx->block_write_size
+            && pool->wblocks_count <= pool->wblocks_depth) {
+            buf->count = (struct ref){_oni_recycle_write_block, 1};
+            return buf;
+        }
+
+        // Block is stale (block size changed) or surplus
+        pool->wblocks_count--;
+        _oni_free_block(buf->buffer);
+        free(buf);
+    }
+
+    int pooled = pool->wblocks_count < pool->wblocks_depth;
+
+    struct oni_buf_impl *buf = malloc(sizeof(struct oni_buf_impl));
+    if (!buf)
+        return NULL;
+
+    buf->buffer = _oni_alloc_block(ctx->block_write_size, ctx->block_write_size);
+    if (!buf->buffer) {
+        free(buf);
+        return NULL;
+    }
+
+    buf->headroom = 0;
+    buf->block_size = ctx->block_write_size;
+
+    if (pooled) {
+        pool->wblocks_count++;
+        buf->count = (struct ref){_oni_recycle_write_block, 1};
+    } else {
+        buf->count = (struct ref){_oni_destroy_buffer, 1};
+    }
+
+    return buf;
+}
+
+static void _oni_recycle_write_block(const struct ref *ref)
+{
+    struct oni_buf_impl *buf = container_of(ref, struct oni_buf_impl, count);
+    struct oni_pool_impl *pool = buf->pool;
+
+    do {
+        buf->next = _oni_load_ptr((void *volatile *)&pool->wblocks_returned);
+    } while (!_oni_cas_ptr((void *volatile *)&pool->wblocks_returned, buf->next, buf));
+
+    // Buffer releases its hold on the pool
+    _ref_dec(&(pool->count));
+}
+
+#ifdef __linux__
+static struct oni_ring_impl *_oni_create_ring(oni_ctx ctx)
+{
+    // Ring must hold the current block and its unread tail, the next block,
+    // and one older block that is still referenced by a frame
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t size = 3 * ctx->block_read_size + ctx->max_read_frame_size;
+    if (size < ctx->read_ring_size)
+        size = ctx->read_ring_size;
+    size += page_size - 1;
+    size -= size % page_size;
+
+    struct oni_ring_impl *ring = calloc(1, sizeof(struct oni_ring_impl));
+    if (!ring)
+        return NULL;
+
+    // Each live segment spans at least the bytes consumed from its block, so
+    // this bounds the number of segments the ring can hold
+    ring->num_segs = 2 * (size / ctx->block_read_size) + 2;
+    ring->segs = calloc(ring->num_segs, sizeof(struct oni_ring_seg));
+    if (!ring->segs) {
+        free(ring);
+        return NULL;
+    }
+
+    // Reserve address space for both mappings and then map the same memory
+    // file over each half
+    int fd = memfd_create("oni_ring", MFD_CLOEXEC);
+    if (fd < 0)
+        goto error;
+
+    if (ftruncate(fd, size)) {
+        close(fd);
+        goto error;
+    }
+
+    uint8_t *base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        goto error;
+    }
+
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * size);
+        close(fd);
+        goto error;
+    }
+
+    // NB: The mappings keep the memory alive
+    close(fd);
+
+    size_t i;
+    for (i = 0; i < ring->num_segs; i++)
+        ring->segs[i].ring = ring;
+
+    ring->base = base;
+    ring->size = size;
+    ring->block_size = ctx->block_read_size;
+    ring->frame_size = ctx->max_read_frame_size;
+    ring->count = (struct ref){_oni_destroy_ring, 1};
+
+    return ring;
+
+error:
+    free(ring->segs);
+    free(ring);
+    return NULL;
+}
+
+static void _oni_release_ring_segment(const struct ref *ref)
+{
+    struct oni_buf_impl *buf = container_of(ref, struct oni_buf_impl, count);
+    struct oni_ring_seg *seg = container_of(buf, struct oni_ring_seg, buf);
+    struct oni_pool_impl *pool = buf->pool;
+    struct oni_ring_impl *ring = seg->ring;
+
+    // NB: seg can be reused as soon as this is visible
+    __atomic_store_n(&seg->released, 1, __ATOMIC_RELEASE);
+
+    // Segment releases its hold on the ring and the pool
+    _ref_dec(&(ring->count));
+    _ref_dec(&(pool->count));
+}
+
+static void _oni_destroy_ring(const struct ref *ref)
+{
+    struct oni_ring_impl *ring = container_of(ref, struct oni_ring_impl, count);
+    munmap(ring->base, 2 * ring->size);
+    free(ring->segs);
+    free(ring);
+}
+#endif
+
+static void *_oni_alloc_block(size_t size, size_t block_size)
+{
+    return _oni_alloc_aligned(size, block_size >= ONI_BLOCKALIGN ? ONI_BLOCKALIGN : 0);
+}
+
+// NB: align must be 0 (no requirement) or a power of two multiple of
+// sizeof(void *)
+static void *_oni_alloc_aligned(size_t size, size_t align)
+{
+#ifdef _WIN32
+    // NB: Everything must come from _aligned_malloc to use _aligned_free
+    return _aligned_malloc(size, align ? align : sizeof(void *));
+#else
+    if (!align)
+        return malloc(size);
+
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, align, size))
+        return NULL;
+    return ptr;
+#endif
+}
+
+static void _oni_free_block(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static oni_frame_impl_t *_oni_acquire_frame(struct oni_pool_impl *pool,
+                                            struct oni_frame_cache *cache)
+{
+    oni_frame_impl_t *iframe = cache->free;
+
+    // Private list is empty, so claim everything that has been released
+    if (iframe == NULL)
+        iframe = _oni_xchg_ptr((void *volatile *)&pool->returned, NULL);
+
+    if (iframe != NULL) {
+        cache->free = iframe->next;
+        _oni_atomic_store64(&cache->hits, cache->hits + 1);
+        return iframe;
+    }
+
+    // Pool is empty, allocate a new slab
+    struct oni_frame_slab *slab = malloc(sizeof(struct oni_frame_slab));
+    if (!slab)
+        return NULL;
+
+    _oni_atomic_store64(&cache->misses, cache->misses + 1);
+
+    // First descriptor is returned, the rest go onto the private list
+    for (size_t i = 1; i < ONI_FRAMESLABSIZE - 1; i++)
+        slab->frames[i].next = &slab->frames[i + 1];
+    slab->frames[ONI_FRAMESLABSIZE - 1].next = NULL;
+    cache->free = &slab->frames[1];
+
+    // Slabs are only freed when the pool is destroyed
+    do {
+        slab->next = _oni_load_ptr((void *volatile *)&pool->slabs);
+    } while (!_oni_cas_ptr((void *volatile *)&pool->slabs, slab->next, slab));
+
+    return &slab->frames[0];
+}
+
+static inline void _oni_release_frame(struct oni_pool_impl *pool,
+                                      oni_frame_impl_t *iframe)
+{
+    do {
+        iframe->next = _oni_load_ptr((void *volatile *)&pool->returned);
+    } while (!_oni_cas_ptr((void *volatile *)&pool->returned, iframe->next, iframe));
+}
+
+static void _oni_destroy_pool(const struct ref *ref)
+{
+    struct oni_pool_impl *pool = container_of(ref, struct oni_pool_impl, count);
+
+    struct oni_frame_slab *slab = pool->slabs;
+    while (slab != NULL) {
+        struct oni_frame_slab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    // NB: All pooled blocks have been returned at this point
+    struct oni_buf_impl *lists[] = {pool->rblocks_free, pool->rblocks_returned,
+                                    pool->wblocks_free, pool->wblocks_returned};
+    size_t i;
+    for (i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        struct oni_buf_impl *buf = lists[i];
+        while (buf != NULL) {
+            struct oni_buf_impl *next = buf->next;
+            _oni_free_block(buf->buffer);
+            free(buf);
+            buf = next;
+        }
+    }
+
+    free(pool);
 }
 
 static inline void _ref_inc(struct ref *ref)
@@ -1377,3 +5911,32 @@ static inline void _ref_dec(struct ref *ref)
 #endif
         ref->free(ref);
 }
+
+static inline int _oni_cas_ptr(void *volatile *ptr, void *expected, void *desired)
+{
+#ifdef _WIN32
+    return _InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(ptr, expected, desired);
+#endif
+}
+
+static inline void *_oni_xchg_ptr(void *volatile *ptr, void *value)
+{
+#ifdef _WIN32
+    return _InterlockedExchangePointer(ptr, value);
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// NB: Frames and blocks are released from any thread, so the head of a return
+// stack must be read atomically
+static inline void *_oni_load_ptr(void *volatile *ptr)
+{
+#ifdef _WIN32
+    return *ptr;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#endif
+}
@@ -4,7 +4,7 @@
 // Version macros for compile-time API version detection
 // NB: see https://semver.org/
 #define ONI_VERSION_MAJOR 4
-#define ONI_VERSION_MINOR 6
+#define ONI_VERSION_MINOR 7
 #define ONI_VERSION_PATCH 0
 
 #define ONI_MAKE_VERSION(major, minor, patch) \
@@ -35,6 +35,12 @@ extern "C" {
 // Acquisition context
 typedef struct oni_ctx_impl *oni_ctx;
 
+// Per-device frame subscription
+typedef struct oni_sub_impl *oni_sub;
+
+// Closed-loop trigger
+typedef struct oni_trigger_impl *oni_trigger;
+
 // Device type
 typedef struct {
     // NB: Block read so don't change order
@@ -55,6 +61,100 @@ typedef struct {
 
 } oni_frame_t;
 
+// Borrowed frame type. Views directly into the context's read buffer and is
+// only valid until the next frame read on the same context.
+typedef struct {
+    oni_fifo_time_t time;           // Frame time (ACQCLKHZ)
+    oni_fifo_dat_t dev_idx;         // Device index that produced the frame
+    oni_fifo_dat_t data_sz;         // Size in bytes of data buffer
+    const char *data;               // Raw data block
+    void *buffer;                   // NB: Internal, buffer being viewed
+
+} oni_frame_view_t;
+
+// Columnar frame storage for a single device. Sample i has time time[i] and
+// data at data + i * stride. Filled by oni_read_columns.
+typedef struct {
+    oni_dev_idx_t dev_idx;          // Device whose frames are collected
+    size_t capacity;                // Number of samples that fit in time and data
+    size_t stride;                  // Size in bytes of each sample in data
+    oni_fifo_time_t *time;          // Sample times (ACQCLKHZ) [capacity]
+    char *data;                     // Sample data [capacity x stride]
+    size_t num_samples;             // Samples stored by the last oni_read_columns
+
+} oni_column_t;
+
+// Register transaction for oni_submit_reg_ops, oni_write_regs and oni_read_regs
+typedef struct {
+    oni_dev_idx_t dev_idx;          // Device index
+    oni_reg_addr_t addr;            // Register address
+    oni_reg_val_t value;            // Value to write, or value read on completion
+    int write;                      // Non-zero to write, zero to read
+    int status;                     // Result on completion
+    uint64_t latency_ns;            // Time from submission to completion (ns)
+
+} oni_reg_op_t;
+
+// Asynchronous hardware event received on the signal stream
+typedef struct {
+    oni_fifo_time_t time;           // Hardware time at which the event was raised (ACQCLKHZ)
+    oni_dev_idx_t dev_idx;          // Device or hub that raised the event
+    oni_size_t code;                // Event code (ONI_EVENT_*)
+    oni_reg_val_t value;            // Event specific value
+
+} oni_event_t;
+
+// Called for each hardware event instead of queueing it for oni_poll_event
+typedef void (*oni_event_cb_t)(const oni_event_t *event, void *user);
+
+// Evaluated for each frame from a trigger's device as soon as the block
+// holding it has been read. frame is only valid during the call. Returns
+// non-zero to write out, whose data may be updated first.
+typedef int (*oni_trigger_fn_t)(const oni_frame_view_t *frame, oni_frame_t *out, void *user);
+
+// Asynchronous writer statistics (ONI_OPT_WRITERSTATS). Latency is measured
+// from oni_queue_frame until the driver write of the frame has returned.
+typedef struct {
+    uint64_t written;               // Frames written
+    uint64_t dropped;               // Frames discarded to make room (ONI_WRITER_DROPOLDEST)
+    uint64_t failed;                // Frames whose driver write failed
+    oni_size_t queued;              // Frames currently queued
+    oni_size_t max_queued;          // Most frames seen queued by the writer
+    uint64_t mean_latency_ns;       // Mean write latency
+    uint64_t max_latency_ns;        // Maximum write latency
+
+} oni_writer_stats_t;
+
+// Output scheduler statistics (ONI_OPT_SCHEDSTATS). Frames are late if the
+// acquisition time had already passed their target time when they were
+// released.
+typedef struct {
+    oni_fifo_time_t time;           // Latest acquisition time read
+    uint64_t released;              // Frames released for writing
+    uint64_t late;                  // Released frames that were late
+    uint64_t failed;                // Released frames whose write failed
+    oni_size_t pending;             // Frames currently scheduled
+    oni_size_t max_pending;         // Most frames scheduled at once
+
+} oni_sched_stats_t;
+
+// Closed-loop trigger statistics (ONI_OPT_TRIGGERSTATS). Latency is measured
+// from the return of the driver read of the block holding the triggering
+// frame until the return of the driver write of the trigger's frame.
+// Percentiles are upper bounds within 1/16 of the true value.
+typedef struct {
+    uint64_t evaluated;             // Frames passed to trigger predicates
+    uint64_t fired;                 // Trigger frames written
+    uint64_t failed;                // Trigger frames whose write failed
+    uint64_t mean_latency_ns;       // Mean read-to-write latency
+    uint64_t p50_latency_ns;        // Median read-to-write latency
+    uint64_t p90_latency_ns;        // 90th percentile read-to-write latency
+    uint64_t p99_latency_ns;        // 99th percentile read-to-write latency
+    uint64_t p999_latency_ns;       // 99.9th percentile read-to-write latency
+    uint64_t max_latency_ns;        // Maximum read-to-write latency
+
+} oni_trigger_stats_t;
+
 // Context management
 ONI_EXPORT oni_ctx oni_create_ctx(const char *drv_name);
 ONI_EXPORT int oni_init_ctx(oni_ctx ctx, int host_idx);
@@ -71,12 +171,46 @@ ONI_EXPORT int oni_set_driver_opt(oni_ctx ctx, int drv_opt, const void *value, s
 // Hardware inspection, manipulation, and IO
 ONI_EXPORT int oni_read_reg(const oni_ctx ctx, oni_dev_idx_t dev_idx, oni_reg_addr_t addr, oni_reg_val_t *value);
 ONI_EXPORT int oni_write_reg(const oni_ctx ctx, oni_dev_idx_t dev_idx, oni_reg_addr_t addr, oni_reg_val_t value);
+ONI_EXPORT int oni_write_regs(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops);
+ONI_EXPORT int oni_read_regs(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops);
+ONI_EXPORT int oni_set_reg_cache(oni_ctx ctx, oni_dev_idx_t dev_idx, oni_reg_addr_t addr, int mode);
+ONI_EXPORT int oni_submit_reg_ops(const oni_ctx ctx, oni_reg_op_t *ops, size_t num_ops);
+ONI_EXPORT int oni_poll_reg_completions(const oni_ctx ctx, oni_reg_op_t **ops, size_t max_n, int block);
+ONI_EXPORT int oni_poll_event(const oni_ctx ctx, oni_event_t *events, size_t max_n);
+ONI_EXPORT int oni_set_event_callback(oni_ctx ctx, oni_event_cb_t callback, void *user);
 ONI_EXPORT int oni_read_frame(const oni_ctx ctx, oni_frame_t **frame);
+ONI_EXPORT int oni_read_frames(const oni_ctx ctx, oni_frame_t **frames, size_t max_n);
+ONI_EXPORT int oni_next_frame_view(const oni_ctx ctx, oni_frame_view_t *view);
+ONI_EXPORT int oni_promote_frame_view(const oni_ctx ctx, const oni_frame_view_t *view, oni_frame_t **frame);
 ONI_EXPORT int oni_create_frame(const oni_ctx ctx, oni_frame_t **frame, oni_dev_idx_t dev_idx, void *data, size_t data_sz);
+ONI_EXPORT int oni_create_write_frame(const oni_ctx ctx, oni_frame_t **frame, oni_dev_idx_t dev_idx, size_t data_sz);
 ONI_EXPORT int oni_write_frame(const oni_ctx ctx, const oni_frame_t *frame);
+ONI_EXPORT int oni_write_frames(const oni_ctx ctx, const oni_frame_t **frames, size_t num_frames);
+ONI_EXPORT int oni_queue_frame(const oni_ctx ctx, oni_frame_t *frame);
+ONI_EXPORT int oni_schedule_frame(const oni_ctx ctx, oni_frame_t *frame, oni_fifo_time_t time);
+// NB: Frames from oni_read_frames share storage and are released together by
+// passing the array filled by that call to oni_destroy_frames. All other
+// frames are released individually using oni_destroy_frame.
 ONI_EXPORT void oni_destroy_frame(oni_frame_t *frame);
+ONI_EXPORT void oni_destroy_frames(oni_frame_t **frames);
+
+// Columnar decoding
+ONI_EXPORT int oni_create_columns(const oni_ctx ctx, oni_column_t *cols, const oni_dev_idx_t *dev_idxs, size_t num_devs, size_t capacity);
+ONI_EXPORT int oni_read_columns(const oni_ctx ctx, oni_column_t *cols, size_t num_cols, size_t max_n);
+ONI_EXPORT void oni_destroy_columns(oni_column_t *cols, size_t num_cols);
+
+// Per-device demultiplexing
+ONI_EXPORT int oni_subscribe(oni_ctx ctx, oni_sub *sub, const oni_dev_idx_t *dev_idxs, size_t num_devs, size_t depth);
+ONI_EXPORT int oni_unsubscribe(oni_sub sub);
+ONI_EXPORT int oni_sub_read_frame(oni_sub sub, oni_frame_t **frame);
+ONI_EXPORT uint64_t oni_sub_dropped(const oni_sub sub);
+
+// Closed-loop triggers
+ONI_EXPORT int oni_add_trigger(oni_ctx ctx, oni_trigger *trigger, oni_dev_idx_t dev_idx, oni_trigger_fn_t predicate, void *user, oni_frame_t *out);
+ONI_EXPORT int oni_remove_trigger(oni_trigger trigger);
 
 // Helpers
+ONI_EXPORT const oni_device_t *oni_get_device(const oni_ctx ctx, oni_dev_idx_t dev_idx);
 ONI_EXPORT void oni_version(int *major, int *minor, int *patch);
 ONI_EXPORT const oni_driver_info_t* oni_get_driver_info(const oni_ctx ctx);
 ONI_EXPORT const char *oni_error_str(int err);
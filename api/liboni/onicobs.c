@@ -0,0 +1,288 @@
+#include "onicobs.h"
+
+#include <assert.h>
+
+#include "onicpu.h"
+
+// Maximal packet size, overhead byte included and delimiter excluded
+#define ONI_COBSMAXPACKET (ONI_COBSMAXPAYLOAD + 1)
+
+static int _oni_cobs_encode_scalar(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    if (size > ONI_COBSMAXPAYLOAD)
+        return ONI_ECOBSPACK;
+
+    size_t code_pos = 0; // Overhead byte of the current block
+    size_t i;
+    for (i = 0; i < size; i++) {
+        dst[i + 1] = src[i];
+        if (src[i] == 0) {
+            dst[code_pos] = (uint8_t)(i + 1 - code_pos);
+            code_pos = i + 1;
+        }
+    }
+
+    // NB: Only the first block can reach this length
+    if (size + 1 - code_pos >= 0xFF)
+        return ONI_ECOBSPACK;
+
+    dst[code_pos] = (uint8_t)(size + 1 - code_pos);
+
+    return ONI_ESUCCESS;
+}
+
+static int _oni_cobs_decode_scalar(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    // Minimal COBS packet is 1 overhead byte + 1 data byte
+    // Maximal COBS packet is 1 overhead byte + 254 data bytes
+    assert(size >= 2 && size <= ONI_COBSMAXPACKET && "Invalid COBS packet buffer size.");
+
+    const uint8_t *end = src + size;
+    while (src < end) {
+        int code = *src++;
+        int i;
+        for (i = 1; src < end && i < code; i++)
+            *dst++ = *src++;
+        if (code < 0xFF)
+            *dst++ = 0;
+    }
+
+    return ONI_ESUCCESS;
+}
+
+#ifdef ONI_X86
+
+static inline unsigned _oni_ctz(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctz(x);
+#endif
+}
+
+// Records the positions of the overhead bytes following the first. Returns
+// their number, or -1 if a block is not followed by a zero (code 0xFF).
+static inline int _oni_cobs_find_codes(const uint8_t *src, size_t size, uint8_t *codes)
+{
+    int n = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        uint8_t code = src[pos];
+        if (code == 0xFF)
+            return -1;
+        if (pos > 0)
+            codes[n++] = (uint8_t)pos;
+        pos += code ? code : 1;
+    }
+
+    return n;
+}
+
+// Without 0xFF codes, every overhead byte decodes to a zero one position
+// earlier, so a packet is decoded by shifting it down by one byte and
+// clearing those positions. The shift only needs wide copies and the number
+// of scalar steps is the number of blocks instead of the number of bytes.
+static inline void _oni_cobs_clear_codes(uint8_t *dst, const uint8_t *codes, int n, size_t size)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[codes[i] - 1] = 0;
+
+    dst[size - 1] = 0;
+}
+
+// Block copies load each chunk before storing it. This is safe in place
+// because the destination is always behind the source.
+ONI_TARGET("sse2")
+static int _oni_cobs_decode_sse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    assert(size >= 2 && size <= ONI_COBSMAXPACKET && "Invalid COBS packet buffer size.");
+
+    uint8_t codes[ONI_COBSMAXPACKET];
+    int n = _oni_cobs_find_codes(src, size, codes);
+    if (n < 0)
+        return _oni_cobs_decode_scalar(dst, src, size);
+
+    const uint8_t *data = src + 1;
+    size_t len = size - 1;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(data + i)));
+    for (; i < len; i++)
+        dst[i] = data[i];
+
+    _oni_cobs_clear_codes(dst, codes, n, size);
+
+    return ONI_ESUCCESS;
+}
+
+ONI_TARGET("avx2")
+static int _oni_cobs_decode_avx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    assert(size >= 2 && size <= ONI_COBSMAXPACKET && "Invalid COBS packet buffer size.");
+
+    uint8_t codes[ONI_COBSMAXPACKET];
+    int n = _oni_cobs_find_codes(src, size, codes);
+    if (n < 0)
+        return _oni_cobs_decode_scalar(dst, src, size);
+
+    const uint8_t *data = src + 1;
+    size_t len = size - 1;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(data + i)));
+    if (i + 16 <= len) {
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(data + i)));
+        i += 16;
+    }
+    for (; i < len; i++)
+        dst[i] = data[i];
+
+    _oni_cobs_clear_codes(dst, codes, n, size);
+
+    return ONI_ESUCCESS;
+}
+
+// Chunks are copied whole and the positions of their zeros are found with a
+// byte compare and mask, so only zero bytes take scalar steps
+ONI_TARGET("sse2")
+static int _oni_cobs_encode_sse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    if (size > ONI_COBSMAXPAYLOAD)
+        return ONI_ECOBSPACK;
+
+    const __m128i zero = _mm_setzero_si128();
+    size_t code_pos = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i + 1), v);
+
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        while (mask) {
+            size_t z = i + _oni_ctz(mask) + 1;
+            dst[code_pos] = (uint8_t)(z - code_pos);
+            code_pos = z;
+            mask &= mask - 1;
+        }
+    }
+
+    for (; i < size; i++) {
+        dst[i + 1] = src[i];
+        if (src[i] == 0) {
+            dst[code_pos] = (uint8_t)(i + 1 - code_pos);
+            code_pos = i + 1;
+        }
+    }
+
+    if (size + 1 - code_pos >= 0xFF)
+        return ONI_ECOBSPACK;
+
+    dst[code_pos] = (uint8_t)(size + 1 - code_pos);
+
+    return ONI_ESUCCESS;
+}
+
+ONI_TARGET("avx2")
+static int _oni_cobs_encode_avx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    if (size > ONI_COBSMAXPAYLOAD)
+        return ONI_ECOBSPACK;
+
+    const __m256i zero = _mm256_setzero_si256();
+    size_t code_pos = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i + 1), v);
+
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        while (mask) {
+            size_t z = i + _oni_ctz(mask) + 1;
+            dst[code_pos] = (uint8_t)(z - code_pos);
+            code_pos = z;
+            mask &= mask - 1;
+        }
+    }
+
+    for (; i < size; i++) {
+        dst[i + 1] = src[i];
+        if (src[i] == 0) {
+            dst[code_pos] = (uint8_t)(i + 1 - code_pos);
+            code_pos = i + 1;
+        }
+    }
+
+    if (size + 1 - code_pos >= 0xFF)
+        return ONI_ECOBSPACK;
+
+    dst[code_pos] = (uint8_t)(size + 1 - code_pos);
+
+    return ONI_ESUCCESS;
+}
+
+#endif
+
+oni_cobs_fn_t oni_cobs_encoder(int impl)
+{
+    switch (impl) {
+        case ONI_COBSSCALAR:
+            return _oni_cobs_encode_scalar;
+#ifdef ONI_X86
+        case ONI_COBSSSE2:
+            return _oni_cpu_supports(ONI_CPUSSE2) ? _oni_cobs_encode_sse2 : NULL;
+        case ONI_COBSAVX2:
+            return _oni_cpu_supports(ONI_CPUAVX2) ? _oni_cobs_encode_avx2 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+oni_cobs_fn_t oni_cobs_decoder(int impl)
+{
+    switch (impl) {
+        case ONI_COBSSCALAR:
+            return _oni_cobs_decode_scalar;
+#ifdef ONI_X86
+        case ONI_COBSSSE2:
+            return _oni_cpu_supports(ONI_CPUSSE2) ? _oni_cobs_decode_sse2 : NULL;
+        case ONI_COBSAVX2:
+            return _oni_cpu_supports(ONI_CPUAVX2) ? _oni_cobs_decode_avx2 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+oni_cobs_fn_t oni_cobs_best_encoder(void)
+{
+    int impl;
+    for (impl = ONI_NUMCOBSIMPLS - 1; impl > ONI_COBSSCALAR; impl--) {
+        oni_cobs_fn_t fn = oni_cobs_encoder(impl);
+        if (fn != NULL)
+            return fn;
+    }
+
+    return _oni_cobs_encode_scalar;
+}
+
+oni_cobs_fn_t oni_cobs_best_decoder(void)
+{
+    int impl;
+    for (impl = ONI_NUMCOBSIMPLS - 1; impl > ONI_COBSSCALAR; impl--) {
+        oni_cobs_fn_t fn = oni_cobs_decoder(impl);
+        if (fn != NULL)
+            return fn;
+    }
+
+    return _oni_cobs_decode_scalar;
+}
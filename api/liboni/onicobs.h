@@ -0,0 +1,43 @@
+#ifndef __ONI_COBS_H__
+#define __ONI_COBS_H__
+
+// Consistent overhead byte stuffing (COBS) used internally by liboni and the
+// test driver. This header is not part of the public API and is not installed.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "onidefs.h"
+
+// Maximal payload size that can be encoded into a single packet (bytes)
+#define ONI_COBSMAXPAYLOAD 254
+
+// Encode: stuff size (<= ONI_COBSMAXPAYLOAD) bytes from src into the size + 1
+// bytes at dst. The packet delimiter is not written. Fails with
+// ONI_ECOBSPACK if the payload contains ONI_COBSMAXPAYLOAD consecutive
+// non-zero bytes.
+//
+// Decode: unstuff a size byte packet (overhead byte included, delimiter
+// excluded, 2 to 255 bytes) from src into dst. dst receives at most size
+// bytes and may be the same buffer as src. Malformed packets are decoded on a
+// best effort basis, identically by all implementations.
+typedef int (*oni_cobs_fn_t)(uint8_t *dst, const uint8_t *src, size_t size);
+
+// COBS implementations
+enum {
+    ONI_COBSSCALAR = 0,
+    ONI_COBSSSE2,
+    ONI_COBSAVX2,
+    ONI_NUMCOBSIMPLS
+};
+
+// Return the given implementation, or NULL if it is not supported by the
+// compiler or the host CPU
+oni_cobs_fn_t oni_cobs_encoder(int impl);
+oni_cobs_fn_t oni_cobs_decoder(int impl);
+
+// Return the fastest implementation supported by the host CPU
+oni_cobs_fn_t oni_cobs_best_encoder(void);
+oni_cobs_fn_t oni_cobs_best_decoder(void);
+
+#endif
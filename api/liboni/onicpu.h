@@ -0,0 +1,57 @@
+#ifndef __ONI_CPU_H__
+#define __ONI_CPU_H__
+
+// Host CPU feature detection shared by the vectorized kernels. This header is
+// not part of the public API and is not installed.
+
+// Vector implementations are compiled for x86 regardless of the target
+// architecture flags and selected at run time based on the host CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ONI_X86
+#define ONI_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define ONI_X86
+#define ONI_TARGET(isa)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#ifdef ONI_X86
+
+// Instruction set extensions that kernels are compiled for
+enum {
+    ONI_CPUSSE2 = 0,
+    ONI_CPUAVX2
+};
+
+// Returns non-zero if the host CPU, and OS, support feature
+static inline int _oni_cpu_supports(int feature)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+
+    if (feature == ONI_CPUSSE2)
+        return (info[3] & (1 << 26)) != 0;
+
+    // AVX2 also requires the OS to save YMM registers
+    int osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6)
+        return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+
+    if (feature == ONI_CPUSSE2)
+        return __builtin_cpu_supports("sse2");
+
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+#endif
@@ -19,6 +19,56 @@ enum {
     ONI_OPT_CUSTOMBEGIN,
 };
 
+// liboni implementation options. These are handled in software by liboni and
+// do not correspond to ONI configuration registers. They are numbered well
+// past ONI_OPT_CUSTOMBEGIN so that they never alias a custom hardware option.
+enum {
+    ONI_OPT_FRAMEPOOLHITS = 0x10000, // Frame descriptors served from the context's frame pool (uint64_t, read-only)
+    ONI_OPT_FRAMEPOOLMISSES, // Heap allocations made by the frame pool, each of which provides 256 frame descriptors (uint64_t, read-only)
+    ONI_OPT_READPOOLDEPTH, // Maximum number of read blocks retained for reuse (oni_size_t)
+    ONI_OPT_READPOOLEXHAUSTED, // Read blocks allocated outside the pool because it was exhausted (uint64_t, read-only)
+    ONI_OPT_READRINGSIZE, // Size of the mirrored read ring buffer in bytes, 0 selects block reads (oni_size_t, Linux only)
+    ONI_OPT_READAHEADDEPTH, // Number of blocks read ahead by a background thread while RUNNING, 0 disables (oni_size_t)
+    ONI_OPT_READAHEADCPU, // CPU the read-ahead thread is pinned to, -1 for none (int)
+    ONI_OPT_READAHEADWAITING, // Filled blocks waiting to be consumed by oni_read_frame (oni_size_t, read-only)
+    ONI_OPT_DEMUXCPU, // CPU the demultiplexer thread is pinned to, -1 for none (int)
+    ONI_OPT_REGCACHEHITS, // Register accesses served by the register cache (uint64_t, read-only)
+    ONI_OPT_CONTROLTHREAD, // Non-zero to carry out control plane calls on a dedicated thread (oni_size_t)
+    ONI_OPT_RESETTIMENS, // Duration of the last reset, from the reset request until the context was IDLE (uint64_t, read-only)
+    ONI_OPT_EVENTSDROPPED, // Hardware events discarded because the event queue was full (uint64_t, read-only)
+    ONI_OPT_EVENTFD, // Descriptor that polls readable when a frame can be read without blocking, requires read-ahead and no read ring if the driver has no descriptor (int, read-only, Linux only)
+    ONI_OPT_WRITEPOOLDEPTH, // Maximum number of write blocks retained for reuse (oni_size_t)
+    ONI_OPT_WRITERDEPTH, // Capacity of the asynchronous writer's queue, rounded up to a power of two, 0 stops the writer (oni_size_t)
+    ONI_OPT_WRITERPOLICY, // What oni_queue_frame does when the writer's queue is full, see ONI_WRITER_* (int)
+    ONI_OPT_WRITERSTATS, // Asynchronous writer statistics (oni_writer_stats_t, read-only)
+    ONI_OPT_SCHEDLEAD, // Acquisition clock ticks before its target time that a scheduled frame is written (uint64_t)
+    ONI_OPT_SCHEDSTATS, // Output scheduler statistics (oni_sched_stats_t, read-only)
+    ONI_OPT_TRIGGERSTATS, // Closed-loop trigger statistics and read-to-write latency percentiles (oni_trigger_stats_t, read-only)
+};
+
+// Hardware event codes, see oni_poll_event()
+enum {
+    ONI_EVENT_LINKSTATE = 0, // Hub link state changed, value is non-zero if the link is up
+    ONI_EVENT_HUBERROR, // Hub reported an error, value holds a hub specific error code
+    ONI_EVENT_OVERFLOW, // Acquisition buffer overflowed, value holds the number of words lost
+    ONI_EVENT_MEMUSAGE, // Acquisition buffer usage crossed its warning level, value holds the usage in words
+    ONI_EVENT_CUSTOMBEGIN = 0x100, // First device specific event code
+};
+
+// Asynchronous writer full queue policies, see oni_queue_frame()
+enum {
+    ONI_WRITER_BLOCK = 0, // Wait until the writer has made room
+    ONI_WRITER_DROPOLDEST, // Discard the oldest queued frame to make room
+    ONI_WRITER_FAIL, // Return ONI_EQUEUEFULL, the caller keeps the frame
+};
+
+// Register cache modes, see oni_set_reg_cache()
+enum {
+    ONI_REGCACHE_NONE = 0, // Every access goes to hardware
+    ONI_REGCACHE_IMMUTABLE, // Value does not change until reset, reads after the first are served from memory
+    ONI_REGCACHE_HOSTOWNED, // Only changed by this host, reads are served from memory and unchanged writes are skipped
+};
+
 // NB: If you add an error here, make sure to update oni_error_str() in oni.c
 enum {
     ONI_ESUCCESS = 0, // Success
@@ -51,9 +101,10 @@ enum {
     ONI_EPROTCONFIG = -27, // Attempted to directly read or write a protected configuration option
     ONI_EBADFRAME = -28, // Received malformed frame
     ONI_EBADCONTROLLER = -29, // ONI Controller is not compatible
+    ONI_EQUEUEFULL = -30, // Queue is full
 
     // NB: Always at bottom
-    ONI_MINERRORNUM = -30
+    ONI_MINERRORNUM = -31
 };
 
 // Registers available in the specification
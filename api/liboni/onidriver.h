@@ -20,6 +20,13 @@ typedef enum {
 // Generic pointer for driver-specific options
 typedef void *oni_driver_ctx;
 
+// Device register write, see oni_driver_config_batch
+typedef struct {
+    oni_dev_idx_t dev_idx;
+    oni_reg_addr_t addr;
+    oni_reg_val_t value;
+} oni_reg_write_t;
+
 // Prototype functions for drivers. Every driver has to implement these
 #ifndef ONI_DRIVER_IGNORE_FUNCTION_PROTOTYPES // For use only for including in the main library driver loader
 #ifdef _WIN32
@@ -51,6 +58,27 @@ ONI_DRIVER_EXPORT int oni_driver_get_opt(oni_driver_ctx driver_ctx, int driver_o
 // Get a string identifying the driver
 ONI_DRIVER_EXPORT const oni_driver_info_t *oni_driver_info(void);
 
+// Optional. Returns the number of bytes that can be read from a stream
+// without blocking, or an error code. Drivers that do not implement this are
+// read one byte at a time where the amount of available data matters (e.g. the
+// signal stream).
+ONI_DRIVER_EXPORT int oni_driver_stream_readable(oni_driver_ctx driver_ctx, oni_read_stream_t stream);
+
+// Optional. Performs num_writes device register writes in order. Each must
+// have the same effect as writing ONI_CONFIG_DEV_IDX, ONI_CONFIG_REG_ADDR,
+// ONI_CONFIG_REG_VALUE and ONI_CONFIG_RW (1), and then ONI_CONFIG_TRIG once
+// the previous write has completed. Acknowledgments are delivered on the
+// signal stream as usual. Drivers can use this to send several writes in a
+// single transfer.
+ONI_DRIVER_EXPORT int oni_driver_config_batch(oni_driver_ctx driver_ctx, const oni_reg_write_t *writes, size_t num_writes);
+
+// Optional. Returns a file descriptor that polls readable (POLLIN) when data
+// can be read from a stream without blocking, or an error code. The
+// descriptor remains owned by the driver and is only used for readiness, never
+// for reads. Drivers that do not implement this are read ahead by a thread
+// when the application asks for a readiness descriptor (ONI_OPT_EVENTFD).
+ONI_DRIVER_EXPORT int oni_driver_stream_fd(oni_driver_ctx driver_ctx, oni_read_stream_t stream);
+
 #endif
 
 #endif
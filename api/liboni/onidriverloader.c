@@ -47,6 +47,18 @@ static inline void* get_driver_function(lib_handle_t handle, const char* functio
 #endif
 }
 
+// Same as get_driver_function, but a missing function is not an error
+static inline void* get_optional_driver_function(lib_handle_t handle, const char* function_name)
+{
+#ifdef _WIN32
+    return (void*)GetProcAddress(handle, function_name);
+#else
+    void *f = (void*)dlsym(handle, function_name);
+    dlerror();
+    return f;
+#endif
+}
+
 // Macro to load a function a check for error
 #define DSTR(x) #x
 #define LOAD_FUNCTION(fname) {\
@@ -54,6 +66,11 @@ static inline void* get_driver_function(lib_handle_t handle, const char* functio
     if (!driver-> fname) rc = -1; \
 }
 
+// Optional functions are NULL if the driver does not export them
+#define LOAD_OPTIONAL_FUNCTION(fname) {\
+    driver-> fname = ( oni_driver_ ## fname ## _f)get_optional_driver_function(handle,DSTR(oni_driver_ ## fname)); \
+}
+
 int oni_create_driver(const char* lib_name, oni_driver_t* driver)
 {
 #if defined(_WIN32)
@@ -92,6 +109,9 @@ int oni_create_driver(const char* lib_name, oni_driver_t* driver)
     LOAD_FUNCTION(set_opt);
     LOAD_FUNCTION(get_opt);
     LOAD_FUNCTION(info);
+    LOAD_OPTIONAL_FUNCTION(stream_readable);
+    LOAD_OPTIONAL_FUNCTION(config_batch);
+    LOAD_OPTIONAL_FUNCTION(stream_fd);
 
     if (!rc) {
         driver->ctx = driver->create_ctx();
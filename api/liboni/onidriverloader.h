@@ -20,10 +20,13 @@ typedef int(*oni_driver_init_f)(oni_driver_ctx, int);
 typedef int(*oni_driver_destroy_ctx_f)(oni_driver_ctx);
 
 typedef int(*oni_driver_read_stream_f)(oni_driver_ctx, oni_read_stream_t, void *, size_t);
+typedef int(*oni_driver_stream_readable_f)(oni_driver_ctx, oni_read_stream_t);
+typedef int(*oni_driver_stream_fd_f)(oni_driver_ctx, oni_read_stream_t);
 typedef int(*oni_driver_write_stream_f)(oni_driver_ctx, oni_write_stream_t, const char *, size_t);
 
 typedef int(*oni_driver_read_config_f)(oni_driver_ctx, oni_config_t, oni_reg_val_t *);
 typedef int(*oni_driver_write_config_f)(oni_driver_ctx, oni_config_t, oni_reg_val_t);
+typedef int(*oni_driver_config_batch_f)(oni_driver_ctx, const oni_reg_write_t *, size_t);
 
 typedef int(*oni_driver_set_opt_f)(oni_driver_ctx, int, const void *, size_t);
 typedef int(*oni_driver_get_opt_f)(oni_driver_ctx, int, void *, size_t *);
@@ -46,6 +49,11 @@ typedef struct oni_driver {
     oni_driver_set_opt_f set_opt;
     oni_driver_get_opt_f get_opt;
     oni_driver_info_f info;
+
+    // Optional, NULL if not implemented by the driver
+    oni_driver_stream_readable_f stream_readable;
+    oni_driver_config_batch_f config_batch;
+    oni_driver_stream_fd_f stream_fd;
 } oni_driver_t;
 
 int oni_create_driver(const char *lib_name, oni_driver_t *driver);
@@ -0,0 +1,206 @@
+#include "oniindex.h"
+
+#include <string.h>
+
+#include "onicpu.h"
+
+// [time, dev_idx, data_sz]
+#define ONI_RFRAMEHEADERSZ (sizeof(oni_fifo_time_t) + 2 * sizeof(oni_fifo_dat_t))
+
+// Frames verified per speculative step in the AVX2 implementation
+#define ONI_INDEXRUN 8
+
+// Maximum number of frames indexed without speculation after failed guesses
+#define ONI_INDEXMAXBACKOFF 64
+
+// NB: Padding rule used by oni_read_frame
+static inline size_t _oni_frame_size(oni_fifo_dat_t data_sz)
+{
+    return ONI_RFRAMEHEADERSZ + data_sz + data_sz % sizeof(oni_fifo_dat_t);
+}
+
+// NB: data_sz - 1 wraps when data_sz is 0, so this rejects both bounds with a
+// single comparison
+static inline int _oni_valid_size(oni_fifo_dat_t data_sz, oni_size_t max_data_sz)
+{
+    return data_sz - 1 < max_data_sz;
+}
+
+static size_t _oni_index_scalar(const uint8_t *pos,
+                                const uint8_t *end,
+                                oni_size_t max_data_sz,
+                                oni_frame_index_t *index,
+                                size_t max_n)
+{
+    const uint8_t *start = pos;
+    size_t n = 0;
+
+    while (n < max_n && (size_t)(end - pos) >= ONI_RFRAMEHEADERSZ) {
+
+        oni_frame_index_t *entry = index + n;
+        memcpy(entry, pos, ONI_RFRAMEHEADERSZ);
+
+        if (!_oni_valid_size(entry->data_sz, max_data_sz))
+            break;
+
+        size_t size = _oni_frame_size(entry->data_sz);
+        if ((size_t)(end - pos) < size)
+            break;
+
+        entry->offset = (uint32_t)(pos - start);
+        entry->size = (uint32_t)size;
+
+        pos += size;
+        n++;
+    }
+
+    return n;
+}
+
+#ifdef ONI_X86
+
+// Each header is moved with a single 128-bit load and store
+ONI_TARGET("sse2")
+static size_t _oni_index_sse2(const uint8_t *pos,
+                               const uint8_t *end,
+                               oni_size_t max_data_sz,
+                               oni_frame_index_t *index,
+                               size_t max_n)
+{
+    const uint8_t *start = pos;
+    size_t n = 0;
+
+    while (n < max_n && (size_t)(end - pos) >= ONI_RFRAMEHEADERSZ) {
+
+        oni_fifo_dat_t data_sz;
+        memcpy(&data_sz, pos + ONI_RFRAMEHEADERSZ - sizeof(data_sz), sizeof(data_sz));
+
+        if (!_oni_valid_size(data_sz, max_data_sz))
+            break;
+
+        size_t size = _oni_frame_size(data_sz);
+        if ((size_t)(end - pos) < size)
+            break;
+
+        oni_frame_index_t *entry = index + n;
+        _mm_storeu_si128((__m128i *)entry, _mm_loadu_si128((const __m128i *)pos));
+        entry->offset = (uint32_t)(pos - start);
+        entry->size = (uint32_t)size;
+
+        pos += size;
+        n++;
+    }
+
+    return n;
+}
+
+// Frame positions depend on the sizes of all preceding frames, so headers
+// cannot be located in parallel in general. However, blocks are often
+// dominated by runs of equally sized frames. After each frame, the following
+// ONI_INDEXRUN frames are assumed to have the same size and their data_sz
+// fields are gathered and checked at once. A failed guess costs one gather, so
+// consecutive failures exponentially increase the number of frames that are
+// indexed one at a time before guessing again.
+ONI_TARGET("avx2")
+static size_t _oni_index_avx2(const uint8_t *pos,
+                              const uint8_t *end,
+                              oni_size_t max_data_sz,
+                              oni_frame_index_t *index,
+                              size_t max_n)
+{
+    const uint8_t *start = pos;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t backoff = 0, wait = 0;
+    size_t n = 0;
+
+    while (n < max_n && (size_t)(end - pos) >= ONI_RFRAMEHEADERSZ) {
+
+        oni_fifo_dat_t data_sz;
+        memcpy(&data_sz, pos + ONI_RFRAMEHEADERSZ - sizeof(data_sz), sizeof(data_sz));
+
+        if (!_oni_valid_size(data_sz, max_data_sz))
+            break;
+
+        size_t size = _oni_frame_size(data_sz);
+        if ((size_t)(end - pos) < size)
+            break;
+
+        oni_frame_index_t *entry = index + n;
+        _mm_storeu_si128((__m128i *)entry, _mm_loadu_si128((const __m128i *)pos));
+        entry->offset = (uint32_t)(pos - start);
+        entry->size = (uint32_t)size;
+
+        pos += size;
+        n++;
+
+        // NB: Gather offsets are 32-bit
+        if (wait > 0 || size > INT32_MAX / ONI_INDEXRUN) {
+            wait -= wait > 0;
+            continue;
+        }
+
+        const __m256i offsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32((int)size));
+        const __m256i expected = _mm256_set1_epi32((int)data_sz);
+
+        while (max_n - n >= ONI_INDEXRUN
+               && (size_t)(end - pos) >= ONI_INDEXRUN * size) {
+
+            __m256i sizes = _mm256_i32gather_epi32(
+                (const int *)(pos + ONI_RFRAMEHEADERSZ - sizeof(oni_fifo_dat_t)),
+                offsets,
+                1);
+
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sizes, expected)) != -1) {
+                backoff = backoff ? (backoff < ONI_INDEXMAXBACKOFF ? 2 * backoff : backoff) : 1;
+                wait = backoff;
+                break;
+            }
+
+            backoff = 0;
+
+            int i;
+            for (i = 0; i < ONI_INDEXRUN; i++) {
+                entry = index + n + i;
+                _mm_storeu_si128((__m128i *)entry,
+                                 _mm_loadu_si128((const __m128i *)(pos + i * size)));
+                entry->offset = (uint32_t)(pos + i * size - start);
+                entry->size = (uint32_t)size;
+            }
+
+            pos += ONI_INDEXRUN * size;
+            n += ONI_INDEXRUN;
+        }
+    }
+
+    return n;
+}
+
+#endif
+
+oni_index_fn_t oni_index_impl(int impl)
+{
+    switch (impl) {
+        case ONI_INDEXSCALAR:
+            return _oni_index_scalar;
+#ifdef ONI_X86
+        case ONI_INDEXSSE2:
+            return _oni_cpu_supports(ONI_CPUSSE2) ? _oni_index_sse2 : NULL;
+        case ONI_INDEXAVX2:
+            return _oni_cpu_supports(ONI_CPUAVX2) ? _oni_index_avx2 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+oni_index_fn_t oni_index_best(void)
+{
+    int impl;
+    for (impl = ONI_NUMINDEXIMPLS - 1; impl > ONI_INDEXSCALAR; impl--) {
+        oni_index_fn_t fn = oni_index_impl(impl);
+        if (fn != NULL)
+            return fn;
+    }
+
+    return _oni_index_scalar;
+}
@@ -0,0 +1,46 @@
+#ifndef __ONI_INDEX_H__
+#define __ONI_INDEX_H__
+
+// Read block header indexing used internally by liboni. This header is not
+// part of the public API and is not installed.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "onidefs.h"
+
+// Header and location of a complete frame within an indexed region. The first
+// three members have the same layout as the frame header in the data stream.
+typedef struct {
+    oni_fifo_time_t time;   // Frame time (ACQCLKHZ)
+    oni_fifo_dat_t dev_idx; // Device index that produced the frame
+    oni_fifo_dat_t data_sz; // Size in bytes of frame data
+    uint32_t offset;        // Offset of the frame header from the start of the region
+    uint32_t size;          // Size of the frame in the region (header + padded data)
+} oni_frame_index_t;
+
+// Index up to max_n consecutive frames starting at pos. Stops at the first
+// frame that is incomplete (extends past end) or malformed (data_sz is zero
+// or greater than max_data_sz). Returns the number of frames indexed.
+typedef size_t (*oni_index_fn_t)(const uint8_t *pos,
+                                 const uint8_t *end,
+                                 oni_size_t max_data_sz,
+                                 oni_frame_index_t *index,
+                                 size_t max_n);
+
+// Index implementations
+enum {
+    ONI_INDEXSCALAR = 0,
+    ONI_INDEXSSE2,
+    ONI_INDEXAVX2,
+    ONI_NUMINDEXIMPLS
+};
+
+// Returns the given implementation, or NULL if it is not supported by the
+// compiler or the host CPU
+oni_index_fn_t oni_index_impl(int impl);
+
+// Returns the fastest implementation supported by the host CPU
+oni_index_fn_t oni_index_best(void);
+
+#endif
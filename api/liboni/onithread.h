@@ -0,0 +1,268 @@
+#ifndef __ONI_THREAD_H__
+#define __ONI_THREAD_H__
+
+// Minimal threading primitives used internally by liboni. This header is not
+// part of the public API and is not installed.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "onidefs.h"
+
+#ifdef _WIN32
+typedef HANDLE oni_thread_t;
+typedef CRITICAL_SECTION oni_mutex_t;
+typedef CONDITION_VARIABLE oni_cond_t;
+#else
+typedef pthread_t oni_thread_t;
+typedef pthread_mutex_t oni_mutex_t;
+typedef pthread_cond_t oni_cond_t;
+#endif
+
+typedef void (*oni_thread_func_t)(void *arg);
+
+// NB: Thread functions are wrapped so that they have a common signature
+struct _oni_thread_start {
+    oni_thread_func_t func;
+    void *arg;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI _oni_thread_entry(LPVOID arg)
+#else
+static void *_oni_thread_entry(void *arg)
+#endif
+{
+    struct _oni_thread_start start = *(struct _oni_thread_start *)arg;
+    free(arg);
+    start.func(start.arg);
+    return 0;
+}
+
+// Start a thread running func(arg). If cpu is non-negative, the thread is
+// pinned to that CPU.
+static inline int _oni_thread_create(oni_thread_t *thread, oni_thread_func_t func, void *arg, int cpu)
+{
+    struct _oni_thread_start *start = malloc(sizeof(struct _oni_thread_start));
+    if (!start)
+        return ONI_EBADALLOC;
+
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, _oni_thread_entry, start, CREATE_SUSPENDED, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return ONI_EINIT;
+    }
+
+    if (cpu >= 0)
+        SetThreadAffinityMask(*thread, (DWORD_PTR)1 << cpu);
+
+    ResumeThread(*thread);
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
+    }
+#else
+    (void)cpu;
+#endif
+
+    int rc = pthread_create(thread, &attr, _oni_thread_entry, start);
+    pthread_attr_destroy(&attr);
+    if (rc) {
+        free(start);
+        return ONI_EINIT;
+    }
+#endif
+
+    return ONI_ESUCCESS;
+}
+
+static inline void _oni_thread_join(oni_thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+// Returns non-zero if called from thread
+static inline int _oni_thread_is_current(oni_thread_t thread)
+{
+#ifdef _WIN32
+    return GetThreadId(thread) == GetCurrentThreadId();
+#else
+    return pthread_equal(thread, pthread_self());
+#endif
+}
+
+static inline void _oni_mutex_init(oni_mutex_t *mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static inline void _oni_mutex_destroy(oni_mutex_t *mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+static inline void _oni_mutex_lock(oni_mutex_t *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static inline void _oni_mutex_unlock(oni_mutex_t *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+static inline void _oni_cond_init(oni_cond_t *cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+static inline void _oni_cond_destroy(oni_cond_t *cond)
+{
+#ifdef _WIN32
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+static inline void _oni_cond_wait(oni_cond_t *cond, oni_mutex_t *mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+// Waits at most timeout_ns nanoseconds
+static inline void _oni_cond_timedwait(oni_cond_t *cond, oni_mutex_t *mutex, uint64_t timeout_ns)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, (DWORD)((timeout_ns + 999999) / 1000000));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + timeout_ns;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    pthread_cond_timedwait(cond, mutex, &ts);
+#endif
+}
+
+static inline void _oni_cond_broadcast(oni_cond_t *cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+// Sequentially consistent load and store of a variable shared between threads
+static inline size_t _oni_atomic_load(volatile size_t *ptr)
+{
+#ifdef _WIN32
+    return (size_t)InterlockedCompareExchangePointer((PVOID volatile *)ptr, NULL, NULL);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void _oni_atomic_store(volatile size_t *ptr, size_t value)
+{
+#ifdef _WIN32
+    InterlockedExchangePointer((PVOID volatile *)ptr, (PVOID)value);
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Sequentially consistent compare and swap. Returns non-zero if *ptr held
+// expected and was replaced by desired.
+static inline int _oni_atomic_cas(volatile size_t *ptr, size_t expected, size_t desired)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchangePointer((PVOID volatile *)ptr, (PVOID)desired, (PVOID)expected)
+        == (PVOID)expected;
+#else
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Load and store of a 64-bit variable that is written by one thread and read
+// by others. The store publishes prior writes to threads that load the value.
+static inline uint64_t _oni_atomic_load64(volatile uint64_t *ptr)
+{
+#ifdef _WIN32
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)ptr, 0, 0);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void _oni_atomic_store64(volatile uint64_t *ptr, uint64_t value)
+{
+#ifdef _WIN32
+    InterlockedExchange64((volatile LONG64 *)ptr, (LONG64)value);
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Monotonic clock (nanoseconds)
+static inline uint64_t _oni_clock_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000
+        + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#endif
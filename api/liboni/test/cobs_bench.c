@@ -0,0 +1,119 @@
+// Measures the throughput of each COBS encoder and decoder implementation for
+// payload sizes from 1 to 254 bytes. Payloads are random with roughly one zero
+// byte in 32. Throughput is given in payload bytes.
+//
+// Usage: cobs-bench [packets_per_size] [repetitions]
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testfunc.h"
+#include "../onicobs.h"
+
+static const char *impl_names[ONI_NUMCOBSIMPLS] = {"scalar", "sse2", "avx2"};
+
+// Sizes reported individually. All sizes are included in the total.
+static const size_t report_sizes[] = {1, 4, 8, 16, 32, 64, 128, 254};
+
+static double elapsed_s(timespec_t start, timespec_t end)
+{
+    timespec_t dt = timediff(start, end);
+    return dt.tv_sec + dt.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t num_packets = argc > 1 ? (size_t)atol(argv[1]) : 1024;
+    int reps = argc > 2 ? atoi(argv[2]) : 200;
+
+    const size_t stride = ONI_COBSMAXPAYLOAD + 1;
+    uint8_t *payloads = malloc(num_packets * stride);
+    uint8_t *packets = malloc(num_packets * stride);
+    uint8_t *decoded = malloc(num_packets * stride);
+    assert(payloads != NULL && packets != NULL && decoded != NULL);
+
+    printf("%zu packets per size, %d repetitions\n", num_packets, reps);
+    printf("%-8s %-8s %-12s %-12s\n", "size", "impl", "encode GB/s", "decode GB/s");
+
+    double enc_time[ONI_NUMCOBSIMPLS] = {0}, dec_time[ONI_NUMCOBSIMPLS] = {0};
+    double total_bytes = 0;
+
+    srand(1);
+
+    size_t size;
+    for (size = 1; size <= ONI_COBSMAXPAYLOAD; size++) {
+
+        size_t i, j;
+        for (i = 0; i < num_packets; i++) {
+            uint8_t *payload = payloads + i * stride;
+            for (j = 0; j < size; j++)
+                payload[j] = rand() % 32 ? (uint8_t)(rand() % 255 + 1) : 0;
+
+            // A maximal payload needs at least one zero to be encodable
+            if (size == ONI_COBSMAXPAYLOAD)
+                payload[rand() % size] = 0;
+        }
+
+        double bytes = (double)size * num_packets * reps;
+        total_bytes += bytes;
+
+        int report = 0;
+        for (i = 0; i < sizeof(report_sizes) / sizeof(report_sizes[0]); i++)
+            report |= report_sizes[i] == size;
+
+        int impl;
+        for (impl = 0; impl < ONI_NUMCOBSIMPLS; impl++) {
+
+            oni_cobs_fn_t encode = oni_cobs_encoder(impl);
+            oni_cobs_fn_t decode = oni_cobs_decoder(impl);
+            if (encode == NULL || decode == NULL)
+                continue;
+
+            timespec_t start, end;
+            int r, rc = 0;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (r = 0; r < reps; r++)
+                for (i = 0; i < num_packets; i++)
+                    rc |= encode(packets + i * stride, payloads + i * stride, size);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            assert(rc == 0 && "Encoding failed.");
+            double enc = elapsed_s(start, end);
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (r = 0; r < reps; r++)
+                for (i = 0; i < num_packets; i++)
+                    rc |= decode(decoded + i * stride, packets + i * stride, size + 1);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            assert(rc == 0 && "Decoding failed.");
+            double dec = elapsed_s(start, end);
+
+            for (i = 0; i < num_packets; i++)
+                assert(memcmp(decoded + i * stride, payloads + i * stride, size) == 0
+                       && "Round trip mismatch.");
+
+            enc_time[impl] += enc;
+            dec_time[impl] += dec;
+
+            if (report)
+                printf("%-8zu %-8s %-12.2f %-12.2f\n",
+                       size, impl_names[impl], bytes / enc / 1e9, bytes / dec / 1e9);
+        }
+    }
+
+    int impl;
+    for (impl = 0; impl < ONI_NUMCOBSIMPLS; impl++) {
+        if (enc_time[impl] > 0)
+            printf("%-8s %-8s %-12.2f %-12.2f\n",
+                   "1-254", impl_names[impl],
+                   total_bytes / enc_time[impl] / 1e9, total_bytes / dec_time[impl] / 1e9);
+    }
+
+    free(decoded);
+    free(packets);
+    free(payloads);
+
+    return 0;
+}
@@ -7,16 +7,120 @@
 //#include <unistd.h>
 
 #include "testfunc.h"
-#include "../oni.c" // Access static _oni_cobs_unstuff function
+#include "../oni.h"
+#include "../onicobs.h"
+
+// Random packets tested per payload size
+#define ROUND_TRIPS 2000
+
+static const char *impl_names[ONI_NUMCOBSIMPLS] = {"scalar", "sse2", "avx2"};
+
+// Random payload with roughly one zero per 1 << zero_shift bytes
+static void fill_payload(uint8_t *payload, size_t size, int zero_shift)
+{
+    size_t i;
+    for (i = 0; i < size; i++) {
+        payload[i] = (uint8_t)(rand() & 0xFF);
+        if (rand() % (1 << zero_shift) == 0)
+            payload[i] = 0;
+    }
+}
+
+// Round trips random payloads of every size through each implementation and
+// checks that all implementations produce the same packets
+static void test_round_trip(void)
+{
+    oni_cobs_fn_t ref_encode = oni_cobs_encoder(ONI_COBSSCALAR);
+    oni_cobs_fn_t ref_decode = oni_cobs_decoder(ONI_COBSSCALAR);
+
+    uint8_t payload[ONI_COBSMAXPAYLOAD];
+    uint8_t ref_packet[ONI_COBSMAXPAYLOAD + 1];
+    uint8_t packet[ONI_COBSMAXPAYLOAD + 1];
+    uint8_t decoded[ONI_COBSMAXPAYLOAD + 1];
+
+    int impl;
+    for (impl = 0; impl < ONI_NUMCOBSIMPLS; impl++) {
+
+        oni_cobs_fn_t encode = oni_cobs_encoder(impl);
+        oni_cobs_fn_t decode = oni_cobs_decoder(impl);
+        if (encode == NULL || decode == NULL) {
+            printf("%-8s not supported\n", impl_names[impl]);
+            continue;
+        }
+
+        size_t size;
+        for (size = 1; size <= ONI_COBSMAXPAYLOAD; size++) {
+
+            int trip;
+            for (trip = 0; trip < ROUND_TRIPS; trip++) {
+
+                fill_payload(payload, size, trip % 9);
+
+                int ref_rc = ref_encode(ref_packet, payload, size);
+                int rc = encode(packet, payload, size);
+                assert(rc == ref_rc && "Encoder result mismatch.");
+
+                // Only a payload without zeros of maximal size cannot be encoded
+                if (rc) {
+                    assert(rc == ONI_ECOBSPACK);
+                    assert(size == ONI_COBSMAXPAYLOAD && memchr(payload, 0, size) == NULL);
+                    continue;
+                }
+
+                assert(memcmp(packet, ref_packet, size + 1) == 0 && "Encoder output mismatch.");
+                assert(memchr(packet, 0, size + 1) == NULL && "Packet contains a delimiter.");
+
+                // Decode to a separate buffer and in place
+                rc = decode(decoded, packet, size + 1);
+                assert(rc == ONI_ESUCCESS);
+                assert(memcmp(decoded, payload, size) == 0 && "Round trip mismatch.");
+
+                rc = decode(packet, packet, size + 1);
+                assert(rc == ONI_ESUCCESS);
+                assert(memcmp(packet, payload, size) == 0 && "In place round trip mismatch.");
+            }
+        }
+
+        // Malformed packets must be decoded the same way by every implementation
+        for (size = 2; size <= ONI_COBSMAXPAYLOAD + 1; size++) {
+
+            int trip;
+            for (trip = 0; trip < ROUND_TRIPS; trip++) {
+
+                fill_payload(packet, size, trip % 9);
+                memcpy(ref_packet, packet, size);
+
+                memset(decoded, 0xAA, sizeof(decoded));
+                int rc = ref_decode(decoded, ref_packet, size);
+                assert(rc == ONI_ESUCCESS);
+
+                uint8_t out[ONI_COBSMAXPAYLOAD + 1];
+                memset(out, 0xAA, sizeof(out));
+                rc = decode(out, packet, size);
+                assert(rc == ONI_ESUCCESS);
+                assert(memcmp(out, decoded, sizeof(out)) == 0 && "Malformed packet decoded differently.");
+            }
+        }
+
+        printf("%-8s round trip passed\n", impl_names[impl]);
+    }
+}
 
 int main(int argc, char *argv[])
 {
+    (void)argc;
+    (void)argv;
+
+    oni_cobs_fn_t cobs_stuff = oni_cobs_best_encoder();
+    oni_cobs_fn_t cobs_unstuff = oni_cobs_best_decoder();
+
     // String to encode/decode
     const char *msg = "Hello world.";
 
     // Stuff
     const size_t msg_len = strlen(msg) + 1;
-    uint8_t *en_buf = malloc(msg_len);
+    uint8_t *en_buf = malloc(msg_len + 1);
+    assert(en_buf != NULL);
     int rc = cobs_stuff(en_buf, (uint8_t *)msg, msg_len);
     if (rc) { printf("Error stuffing packet: %s\n", oni_error_str(rc)); }
     assert(rc == 0);
@@ -24,7 +128,8 @@ int main(int argc, char *argv[])
     // Unstuff
     const size_t buf_len = 256;
     uint8_t *de_buf = malloc(buf_len);
-    rc = _oni_cobs_unstuff(de_buf, en_buf, msg_len);
+    assert(de_buf != NULL);
+    rc = cobs_unstuff(de_buf, en_buf, msg_len + 1);
     if (rc) { printf("Error unstuffing packet: %s\n", oni_error_str(rc)); }
     char *de_msg = (char *)de_buf;
     assert(rc == 0);
@@ -36,6 +141,9 @@ int main(int argc, char *argv[])
     free(en_buf);
     free(de_buf);
 
+    srand(1);
+    test_round_trip();
+
     printf("Success.\n");
 
     return 0;
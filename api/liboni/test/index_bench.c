@@ -0,0 +1,144 @@
+// Measures the rate at which each block header indexer implementation indexes
+// frames. Blocks are reconstructed from frames produced by the test driver so
+// that they contain its mix of frame sizes. A block holding only frames from a
+// single device is also indexed for comparison. The test driver must be
+// discoverable by the driver loader (e.g. installed or on LD_LIBRARY_PATH).
+//
+// Usage: index-bench [block_size] [repetitions]
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+#include "../oniindex.h"
+
+#define HEADER_SIZE (sizeof(oni_fifo_time_t) + 2 * sizeof(oni_fifo_dat_t))
+
+static const char *impl_names[ONI_NUMINDEXIMPLS] = {"scalar", "sse2", "avx2"};
+
+// Serialize frames in the data stream format until the block is full
+static size_t fill_block(oni_ctx ctx, uint8_t *block, size_t block_size, int single_device)
+{
+    size_t pos = 0;
+    oni_fifo_dat_t dev_idx = 0;
+    int have_dev = 0;
+
+    while (1) {
+
+        oni_frame_t *frame = NULL;
+        int rc = oni_read_frame(ctx, &frame);
+        assert(rc >= 0 && "Frame read failed.");
+
+        if (single_device) {
+            if (!have_dev) {
+                dev_idx = frame->dev_idx;
+                have_dev = 1;
+            } else if (frame->dev_idx != dev_idx) {
+                oni_destroy_frame(frame);
+                continue;
+            }
+        }
+
+        size_t rsize = frame->data_sz + frame->data_sz % sizeof(oni_fifo_dat_t);
+        if (pos + HEADER_SIZE + rsize > block_size) {
+            oni_destroy_frame(frame);
+            break;
+        }
+
+        memcpy(block + pos, &frame->time, HEADER_SIZE);
+        memcpy(block + pos + HEADER_SIZE, frame->data, rsize);
+        pos += HEADER_SIZE + rsize;
+
+        oni_destroy_frame(frame);
+    }
+
+    return pos;
+}
+
+static void run(const char *label, const uint8_t *block, size_t size, oni_size_t max_frame_size, int reps)
+{
+    size_t max_n = size / HEADER_SIZE;
+    oni_frame_index_t *reference = malloc(max_n * sizeof(oni_frame_index_t));
+    oni_frame_index_t *index = malloc(max_n * sizeof(oni_frame_index_t));
+    assert(reference != NULL && index != NULL);
+
+    size_t n_ref = oni_index_impl(ONI_INDEXSCALAR)(block, block + size, max_frame_size, reference, max_n);
+
+    int impl;
+    for (impl = 0; impl < ONI_NUMINDEXIMPLS; impl++) {
+
+        oni_index_fn_t fn = oni_index_impl(impl);
+        if (fn == NULL) {
+            printf("%-14s %-8s %s\n", label, impl_names[impl], "not supported");
+            continue;
+        }
+
+        // Results must match the scalar implementation
+        size_t n = fn(block, block + size, max_frame_size, index, max_n);
+        assert(n == n_ref && "Frame count mismatch.");
+        assert(memcmp(index, reference, n * sizeof(oni_frame_index_t)) == 0
+               && "Index mismatch.");
+
+        timespec_t start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int i;
+        size_t total = 0;
+        for (i = 0; i < reps; i++)
+            total += fn(block, block + size, max_frame_size, index, max_n);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        timespec_t dt = timediff(start, end);
+        double sec = dt.tv_sec + dt.tv_nsec / 1e9;
+        printf("%-14s %-8s %-12zu %-14.0f %-10.2f\n",
+               label, impl_names[impl], n, total / sec, (double)size * reps / sec / 1e9);
+    }
+
+    free(index);
+    free(reference);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t block_size = argc > 1 ? (size_t)atol(argv[1]) : 1 << 20;
+    int reps = argc > 2 ? atoi(argv[2]) : 200;
+
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t max_frame_size = 0;
+    size_t len = sizeof(max_frame_size);
+    rc = oni_get_opt(ctx, ONI_OPT_MAXREADFRAMESIZE, &max_frame_size, &len);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t run_ctx = 1;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run_ctx, sizeof(run_ctx));
+    assert(rc == ONI_ESUCCESS);
+
+    uint8_t *mixed = malloc(block_size);
+    uint8_t *single = malloc(block_size);
+    assert(mixed != NULL && single != NULL);
+
+    size_t mixed_size = fill_block(ctx, mixed, block_size, 0);
+    size_t single_size = fill_block(ctx, single, block_size, 1);
+
+    oni_destroy_ctx(ctx);
+
+    printf("%zu byte blocks, %d repetitions\n", block_size, reps);
+    printf("%-14s %-8s %-12s %-14s %-10s\n", "block", "indexer", "frames", "frames/s", "GB/s");
+
+    run("test driver", mixed, mixed_size, max_frame_size, reps);
+    run("single device", single, single_size, max_frame_size, reps);
+
+    free(single);
+    free(mixed);
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Measures closed-loop read-to-write latency with the test driver in loopback
+// mode. A rule is evaluated for every frame from the first device and, for one
+// in RULE_PERIOD of them, a frame holding its time is written to the second
+// device. The test driver returns the written frame from the second device,
+// so the loop's round trip is the difference between the time of the frame
+// read back and the time it holds (acquisition clock ticks). The rule is run
+// by the closed-loop trigger engine and, for comparison, by the application
+// after oni_read_frame followed by oni_create_frame and oni_write_frame. The
+// test driver must be discoverable by the driver loader (e.g. installed or on
+// LD_LIBRARY_PATH).
+//
+// Usage: loop-bench [num_frames] [block_read_size]
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+
+// Test driver option that reads back written frames
+#define TESTOPT_LOOPBACK 3
+
+// One in RULE_PERIOD frames from the input device fires the rule
+#define RULE_PERIOD 16
+
+// Input and output (looped back) devices
+#define IN_DEV 0
+#define OUT_DEV 1
+
+// Written after the time to tell looped back frames from the output device's
+// own frames, which have a zero message word
+#define LOOP_MARK UINT64_MAX
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Rule: the frame's hub counter is a multiple of RULE_PERIOD
+static int rule(const char *data)
+{
+    uint64_t counter;
+    memcpy(&counter, data, sizeof(counter));
+    return counter % RULE_PERIOD == 0;
+}
+
+static int predicate(const oni_frame_view_t *frame, oni_frame_t *out, void *user)
+{
+    (void)user;
+
+    if (!rule(frame->data))
+        return 0;
+
+    memcpy(out->data, &frame->time, sizeof(frame->time));
+    return 1;
+}
+
+// Context acquiring from the test driver in loopback mode
+static oni_ctx create(oni_size_t block_read_size)
+{
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    rc = oni_set_opt(ctx, ONI_OPT_BLOCKREADSIZE, &block_read_size, sizeof(block_read_size));
+    assert(rc == ONI_ESUCCESS);
+
+    int loopback = 1;
+    rc = oni_set_driver_opt(ctx, TESTOPT_LOOPBACK, &loopback, sizeof(loopback));
+    assert(rc == ONI_ESUCCESS);
+
+    return ctx;
+}
+
+// Starts acquisition and reads num_frames frames, optionally applying the
+// rule in the application. Returns the number of round trips stored in ticks
+// and stores the duration of each frame creation and write in app_ns.
+static size_t run(oni_ctx ctx, long num_frames, int app_rule, uint64_t *ticks, uint64_t *app_ns, size_t *num_fired)
+{
+    size_t num_loops = 0;
+    long i;
+
+    oni_size_t run_state = 1;
+    int rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run_state, sizeof(run_state));
+    assert(rc == ONI_ESUCCESS);
+
+    *num_fired = 0;
+
+    for (i = 0; i < num_frames; i++) {
+
+        oni_frame_t *frame = NULL;
+        rc = oni_read_frame(ctx, &frame);
+        assert(rc >= 0);
+
+        if (app_rule && frame->dev_idx == IN_DEV && rule(frame->data)) {
+
+            timespec_t start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            oni_frame_t *out = NULL;
+            oni_fifo_time_t data[4] = {frame->time, LOOP_MARK, 0, 0};
+            rc = oni_create_frame(ctx, &out, OUT_DEV, data, sizeof(data));
+            assert(rc >= 0);
+            rc = oni_write_frame(ctx, out);
+            assert(rc >= 0);
+            oni_destroy_frame(out);
+
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            timespec_t dt = timediff(start, end);
+            app_ns[(*num_fired)++] = dt.tv_sec * 1000000000ull + dt.tv_nsec;
+        }
+
+        uint32_t mark;
+        memcpy(&mark, frame->data + sizeof(oni_fifo_time_t), sizeof(mark));
+        if (frame->dev_idx == OUT_DEV && mark == (uint32_t)LOOP_MARK) {
+            oni_fifo_time_t fired_at;
+            memcpy(&fired_at, frame->data, sizeof(fired_at));
+            ticks[num_loops++] = frame->time - fired_at;
+        }
+
+        oni_destroy_frame(frame);
+    }
+
+    return num_loops;
+}
+
+static void print_percentiles(const char *name, uint64_t *ticks, size_t n)
+{
+    assert(n > 0 && "No samples.");
+    qsort(ticks, n, sizeof(uint64_t), compare_u64);
+    printf("%-24s %-10zu p50 %-6lu p90 %-6lu p99 %-6lu p99.9 %-6lu max %-6lu\n",
+           name,
+           n,
+           (unsigned long)ticks[n / 2],
+           (unsigned long)ticks[n * 90 / 100],
+           (unsigned long)ticks[n * 99 / 100],
+           (unsigned long)ticks[n * 999 / 1000],
+           (unsigned long)ticks[n - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+    long num_frames = argc > 1 ? atol(argv[1]) : 10000000;
+    oni_size_t block_read_size = argc > 2 ? (oni_size_t)atol(argv[2]) : 4096;
+
+    uint64_t *ticks = malloc(num_frames * sizeof(uint64_t));
+    uint64_t *app_ns = malloc(num_frames * sizeof(uint64_t));
+    assert(ticks != NULL && app_ns != NULL);
+
+    printf("%ld frames, %u byte blocks, rule fires for 1 in %d frames from device %d\n",
+           num_frames, block_read_size, RULE_PERIOD, IN_DEV);
+    printf("%-24s %-10s\n", "measurement", "count");
+
+    // Rule evaluated by the application
+    oni_ctx ctx = create(block_read_size);
+
+    size_t num_fired;
+    size_t n = run(ctx, num_frames, 1, ticks, app_ns, &num_fired);
+    print_percentiles("application (ticks)", ticks, n);
+    print_percentiles("create and write (ns)", app_ns, num_fired);
+
+    oni_destroy_ctx(ctx);
+
+    // Rule evaluated by a trigger
+    ctx = create(block_read_size);
+
+    oni_frame_t *out = NULL;
+    int rc = oni_create_write_frame(ctx, &out, OUT_DEV, 4 * sizeof(oni_fifo_time_t));
+    assert(rc >= 0);
+
+    oni_fifo_time_t mark = LOOP_MARK;
+    memcpy(out->data + sizeof(oni_fifo_time_t), &mark, sizeof(mark));
+
+    oni_trigger trigger = NULL;
+    rc = oni_add_trigger(ctx, &trigger, IN_DEV, predicate, NULL, out);
+    assert(rc == ONI_ESUCCESS);
+
+    n = run(ctx, num_frames, 0, ticks, app_ns, &num_fired);
+    print_percentiles("trigger (ticks)", ticks, n);
+
+    oni_trigger_stats_t stats;
+    size_t len = sizeof(stats);
+    rc = oni_get_opt(ctx, ONI_OPT_TRIGGERSTATS, &stats, &len);
+    assert(rc == ONI_ESUCCESS && stats.failed == 0);
+
+    printf("%-24s %-10lu p50 %-6lu p90 %-6lu p99 %-6lu p99.9 %-6lu max %-6lu (mean %lu, %lu frames evaluated)\n",
+           "read to write (ns)",
+           (unsigned long)stats.fired,
+           (unsigned long)stats.p50_latency_ns,
+           (unsigned long)stats.p90_latency_ns,
+           (unsigned long)stats.p99_latency_ns,
+           (unsigned long)stats.p999_latency_ns,
+           (unsigned long)stats.max_latency_ns,
+           (unsigned long)stats.mean_latency_ns,
+           (unsigned long)stats.evaluated);
+
+    oni_size_t run_state = 0;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run_state, sizeof(run_state));
+    assert(rc == ONI_ESUCCESS);
+
+    rc = oni_remove_trigger(trigger);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_destroy_ctx(ctx);
+
+    free(app_ns);
+    free(ticks);
+
+    return 0;
+}
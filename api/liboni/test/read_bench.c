@@ -0,0 +1,111 @@
+// Compares frame read throughput of the block, read-ahead and mirrored ring
+// read paths using the test driver. The test driver must be discoverable by the driver
+// loader (e.g. installed or on LD_LIBRARY_PATH).
+//
+// Usage: read-bench [num_frames] [frames_held]
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+
+#define NUM_BLOCK_SIZES 4
+#define RING_SIZE_HELD (16 << 20)
+#define READ_AHEAD_DEPTH 4
+
+static double run(oni_size_t block_size, oni_size_t ring_size, oni_size_t ahead_depth, long num_frames, int held, double *mbps)
+{
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    if (block_size != 0) {
+        rc = oni_set_opt(ctx, ONI_OPT_BLOCKREADSIZE, &block_size, sizeof(block_size));
+        assert(rc == ONI_ESUCCESS);
+    }
+
+    rc = oni_set_opt(ctx, ONI_OPT_READRINGSIZE, &ring_size, sizeof(ring_size));
+    if (rc) {
+        printf("Could not set ring size: %s\n", oni_error_str(rc));
+        oni_destroy_ctx(ctx);
+        return 0;
+    }
+
+    rc = oni_set_opt(ctx, ONI_OPT_READAHEADDEPTH, &ahead_depth, sizeof(ahead_depth));
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t run = 1;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run, sizeof(run));
+    assert(rc == ONI_ESUCCESS);
+
+    // Frames kept alive to emulate a consumer that holds on to recent data
+    oni_frame_t **frames = calloc(held > 0 ? held : 1, sizeof(oni_frame_t *));
+
+    uint64_t bytes = 0;
+    timespec_t start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long i;
+    for (i = 0; i < num_frames; i++) {
+
+        oni_frame_t *frame = NULL;
+        rc = oni_read_frame(ctx, &frame);
+        assert(rc >= 0 && "Frame read failed.");
+        bytes += frame->data_sz;
+
+        if (held > 0) {
+            oni_destroy_frame(frames[i % held]);
+            frames[i % held] = frame;
+        } else {
+            oni_destroy_frame(frame);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (i = 0; i < held; i++)
+        oni_destroy_frame(frames[i]);
+    free(frames);
+
+    oni_destroy_ctx(ctx);
+
+    timespec_t dt = timediff(start, end);
+    double sec = dt.tv_sec + dt.tv_nsec / 1e9;
+    *mbps = bytes / sec / 1e6;
+
+    return num_frames / sec;
+}
+
+int main(int argc, char *argv[])
+{
+    long num_frames = argc > 1 ? atol(argv[1]) : 5000000;
+    int held = argc > 2 ? atoi(argv[2]) : 0;
+
+    // 0 selects the default block read size (the maximum frame size)
+    const oni_size_t block_sizes[NUM_BLOCK_SIZES] = {0, 4096, 65536, 1048576};
+
+    printf("%ld frames, %d held by consumer\n", num_frames, held);
+    printf("%-12s %-10s %-14s %-10s\n", "block size", "read path", "frames/s", "MB/s");
+
+    int i;
+    for (i = 0; i < NUM_BLOCK_SIZES; i++) {
+
+        double mbps = 0;
+        double fps = run(block_sizes[i], 0, 0, num_frames, held, &mbps);
+        printf("%-12u %-10s %-14.0f %-10.1f\n", block_sizes[i], "block", fps, mbps);
+
+        fps = run(block_sizes[i], 0, READ_AHEAD_DEPTH, num_frames, held, &mbps);
+        printf("%-12u %-10s %-14.0f %-10.1f\n", block_sizes[i], "ahead", fps, mbps);
+
+        // Ring size is rounded up to the minimum for the block size. Held
+        // frames pin ring memory, so give them room to avoid stalling.
+        fps = run(block_sizes[i], held > 0 ? RING_SIZE_HELD : 1, 0, num_frames, held, &mbps);
+        printf("%-12u %-10s %-14.0f %-10.1f\n", block_sizes[i], "ring", fps, mbps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+// Measures the latency of register round trips, the throughput of batched
+// register writes and of submitted register transactions, the latency of
+// register writes made through the control thread while another thread
+// acquires frames and the latency of hardware reset and device table discovery
+// with the default and the largest device table using the test driver. The test driver must be discoverable by the driver
+// loader (e.g. installed or on LD_LIBRARY_PATH).
+//
+// Usage: reg-bench [num_reg_ops] [num_resets]
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+
+// Test driver register holding a writable message
+#define MESSAGE_REG 1
+
+// Transactions submitted at a time
+#define BATCH_SIZE 1024
+
+// Test driver option holding the number of hubs, each with 4 devices
+#define TESTOPT_NUMHUBS 0
+
+static double elapsed_us(timespec_t start, timespec_t end, long n)
+{
+    timespec_t dt = timediff(start, end);
+    return (dt.tv_sec * 1e6 + dt.tv_nsec / 1e3) / n;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Reads frames as fast as possible until acquiring is cleared
+static volatile int acquiring = 1;
+static volatile long frames_read = 0;
+
+static void *acquire(void *arg)
+{
+    oni_ctx ctx = arg;
+
+    while (acquiring) {
+        oni_frame_t *frame = NULL;
+        int rc = oni_read_frame(ctx, &frame);
+        assert(rc >= 0);
+        oni_destroy_frame(frame);
+        frames_read++;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long num_reg_ops = argc > 1 ? atol(argv[1]) : 100000;
+    long num_resets = argc > 2 ? atol(argv[2]) : 10000;
+
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t num_devs = 0;
+    size_t len = sizeof(num_devs);
+    rc = oni_get_opt(ctx, ONI_OPT_NUMDEVICES, &num_devs, &len);
+    assert(rc == ONI_ESUCCESS && num_devs > 0);
+
+    oni_device_t *devices = malloc(num_devs * sizeof(oni_device_t));
+    len = num_devs * sizeof(oni_device_t);
+    rc = oni_get_opt(ctx, ONI_OPT_DEVICETABLE, devices, &len);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_dev_idx_t dev_idx = devices[0].idx;
+    free(devices);
+
+    timespec_t start, end;
+    long i;
+
+    printf("%-20s %-10s %-10s\n", "operation", "count", "us/op");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_reg_ops; i++) {
+        rc = oni_write_reg(ctx, dev_idx, MESSAGE_REG, (oni_reg_val_t)i & 0x7fff);
+        assert(rc == ONI_ESUCCESS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-20s %-10ld %-10.3f\n", "oni_write_reg", num_reg_ops, elapsed_us(start, end, num_reg_ops));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_reg_ops; i++) {
+        oni_reg_val_t value = 0;
+        rc = oni_read_reg(ctx, dev_idx, MESSAGE_REG, &value);
+        assert(rc == ONI_ESUCCESS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-20s %-10ld %-10.3f\n", "oni_read_reg", num_reg_ops, elapsed_us(start, end, num_reg_ops));
+
+    oni_reg_op_t *ops = calloc(BATCH_SIZE, sizeof(oni_reg_op_t));
+    oni_reg_op_t **done = malloc(BATCH_SIZE * sizeof(oni_reg_op_t *));
+    assert(ops != NULL && done != NULL);
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        ops[i].dev_idx = dev_idx;
+        ops[i].addr = MESSAGE_REG;
+        ops[i].value = (oni_reg_val_t)i & 0x7fff;
+    }
+
+    long completed = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (completed < num_reg_ops) {
+        rc = oni_write_regs(ctx, ops, BATCH_SIZE);
+        assert(rc == ONI_ESUCCESS);
+        completed += BATCH_SIZE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-20s %-10ld %-10.3f\n", "oni_write_regs", completed, elapsed_us(start, end, completed));
+
+    // Alternate writes and reads of the same register
+    completed = 0;
+    uint64_t total_latency = 0, max_latency = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (completed < num_reg_ops) {
+
+        for (i = 0; i < BATCH_SIZE; i++) {
+            ops[i].dev_idx = dev_idx;
+            ops[i].addr = MESSAGE_REG;
+            ops[i].value = (oni_reg_val_t)i & 0x7fff;
+            ops[i].write = !(i & 1);
+        }
+
+        rc = oni_submit_reg_ops(ctx, ops, BATCH_SIZE);
+        assert(rc == ONI_ESUCCESS);
+
+        int n = 0;
+        while (n < BATCH_SIZE) {
+            int k = oni_poll_reg_completions(ctx, done, BATCH_SIZE, 1);
+            assert(k > 0);
+
+            int j;
+            for (j = 0; j < k; j++) {
+                assert(done[j]->status == ONI_ESUCCESS);
+                assert(done[j]->write || done[j]->value == (oni_reg_val_t)(done[j] - ops - 1));
+                total_latency += done[j]->latency_ns;
+                if (done[j]->latency_ns > max_latency)
+                    max_latency = done[j]->latency_ns;
+            }
+            n += k;
+        }
+
+        completed += BATCH_SIZE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-20s %-10ld %-10.3f (%.0f ops/s, mean latency %.1f us, max %.1f us)\n",
+           "oni_submit_reg_ops",
+           completed,
+           elapsed_us(start, end, completed),
+           completed / (elapsed_us(start, end, 1) / 1e6),
+           total_latency / 1e3 / completed,
+           max_latency / 1e3);
+
+    free(done);
+    free(ops);
+
+    // Write a register from this thread while another one acquires
+    oni_size_t control = 1;
+    rc = oni_set_opt(ctx, ONI_OPT_CONTROLTHREAD, &control, sizeof(control));
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t run = 1;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run, sizeof(run));
+    assert(rc == ONI_ESUCCESS);
+
+    pthread_t reader;
+    rc = pthread_create(&reader, NULL, acquire, ctx);
+    assert(rc == 0);
+
+    double *latency = malloc(num_reg_ops * sizeof(double));
+    assert(latency != NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_reg_ops; i++) {
+        timespec_t op_start, op_end;
+        clock_gettime(CLOCK_MONOTONIC, &op_start);
+        rc = oni_write_reg(ctx, dev_idx, MESSAGE_REG, (oni_reg_val_t)i & 0x7fff);
+        clock_gettime(CLOCK_MONOTONIC, &op_end);
+        assert(rc == ONI_ESUCCESS);
+        latency[i] = elapsed_us(op_start, op_end, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    acquiring = 0;
+    pthread_join(reader, NULL);
+
+    qsort(latency, num_reg_ops, sizeof(double), compare_double);
+    printf("%-20s %-10ld %-10.3f (p50 %.1f us, p99 %.1f us, max %.1f us, %.0f frames/s)\n",
+           "write while running",
+           num_reg_ops,
+           elapsed_us(start, end, num_reg_ops),
+           latency[num_reg_ops / 2],
+           latency[num_reg_ops * 99 / 100],
+           latency[num_reg_ops - 1],
+           frames_read / (elapsed_us(start, end, 1) / 1e6));
+
+    free(latency);
+
+    run = 0;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run, sizeof(run));
+    assert(rc == ONI_ESUCCESS);
+
+    control = 0;
+    rc = oni_set_opt(ctx, ONI_OPT_CONTROLTHREAD, &control, sizeof(control));
+    assert(rc == ONI_ESUCCESS);
+
+    const int num_hubs[] = {4, 64};
+    size_t h;
+    for (h = 0; h < sizeof(num_hubs) / sizeof(num_hubs[0]); h++) {
+
+        rc = oni_set_driver_opt(ctx, TESTOPT_NUMHUBS, &num_hubs[h], sizeof(num_hubs[h]));
+        assert(rc == ONI_ESUCCESS);
+
+        oni_reg_val_t reset = 1;
+        rc = oni_set_opt(ctx, ONI_OPT_RESET, &reset, sizeof(reset));
+        assert(rc == ONI_ESUCCESS);
+
+        len = sizeof(num_devs);
+        rc = oni_get_opt(ctx, ONI_OPT_NUMDEVICES, &num_devs, &len);
+        assert(rc == ONI_ESUCCESS && num_devs == (oni_size_t)num_hubs[h] * 4);
+
+        uint64_t total_reset_ns = 0, max_reset_ns = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < num_resets; i++) {
+            rc = oni_set_opt(ctx, ONI_OPT_RESET, &reset, sizeof(reset));
+            assert(rc == ONI_ESUCCESS);
+
+            uint64_t reset_ns = 0;
+            len = sizeof(reset_ns);
+            rc = oni_get_opt(ctx, ONI_OPT_RESETTIMENS, &reset_ns, &len);
+            assert(rc == ONI_ESUCCESS);
+            total_reset_ns += reset_ns;
+            if (reset_ns > max_reset_ns)
+                max_reset_ns = reset_ns;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        char name[32];
+        snprintf(name, sizeof(name), "reset (%u devices)", num_devs);
+        printf("%-20s %-10ld %-10.3f (reset to IDLE mean %.1f us, max %.1f us)\n",
+               name,
+               num_resets,
+               elapsed_us(start, end, num_resets),
+               total_reset_ns / 1e3 / num_resets,
+               max_reset_ns / 1e3);
+    }
+
+    oni_destroy_ctx(ctx);
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+// Schedules frames with the output scheduler while acquiring from the test
+// driver and checks when they are released. First, frames are scheduled one at
+// a time and the acquisition time at which each is written, which the test
+// driver reports through TESTOPT_LASTWRITETIME, is checked against its target
+// time less the lead (ONI_OPT_SCHEDLEAD). Then several producer threads create
+// and schedule frames at once while frames are read and released, and the
+// scheduler's statistics (ONI_OPT_SCHEDSTATS) must account for every frame. The test driver
+// must be discoverable by the driver loader (e.g. installed or on
+// LD_LIBRARY_PATH).
+//
+// Usage: sched-test [frames_per_producer]
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+
+// Test driver option holding the acquisition time of the last write
+#define TESTOPT_LASTWRITETIME 2
+
+#define BLOCK_READ_SIZE 1024
+
+// Test driver read frames are at least a 16 byte header and 12 bytes of data.
+// A block read can therefore produce the acquisition times of this many frames
+// ahead of the frame being read, which bounds how late the test driver sees a
+// write.
+#define MIN_FRAME_SIZE 28
+#define MAX_AHEAD (2 * BLOCK_READ_SIZE / MIN_FRAME_SIZE + 2)
+
+// Lead and distance from the current time of frames scheduled one at a time
+#define LEAD 100
+#define TIMED_GAP 5000
+#define NUM_TIMED 100
+
+#define NUM_PRODUCERS 4
+
+// Producers schedule frames at random times within this many ticks, starting
+// this many ticks after the latest acquisition time
+#define WINDOW 200000
+#define MARGIN 10000
+
+// Device written to and its write size
+#define OUT_DEV 0
+#define WRITE_SIZE 32
+
+struct producer {
+    oni_ctx ctx;
+    long num_frames;
+    unsigned int seed;
+};
+
+static oni_fifo_time_t read_time(oni_ctx ctx)
+{
+    oni_frame_t *frame = NULL;
+    int rc = oni_read_frame(ctx, &frame);
+    assert(rc >= 0);
+    oni_fifo_time_t time = frame->time;
+    oni_destroy_frame(frame);
+    return time;
+}
+
+static uint64_t last_write_time(oni_ctx ctx)
+{
+    uint64_t time;
+    size_t len = sizeof(time);
+    int rc = oni_get_driver_opt(ctx, TESTOPT_LASTWRITETIME, &time, &len);
+    assert(rc == ONI_ESUCCESS);
+    return time;
+}
+
+static oni_sched_stats_t sched_stats(oni_ctx ctx)
+{
+    oni_sched_stats_t stats;
+    size_t len = sizeof(stats);
+    int rc = oni_get_opt(ctx, ONI_OPT_SCHEDSTATS, &stats, &len);
+    assert(rc == ONI_ESUCCESS);
+    return stats;
+}
+
+static void schedule(oni_ctx ctx, oni_fifo_time_t time)
+{
+    uint64_t data[WRITE_SIZE / sizeof(uint64_t)] = {time};
+    oni_frame_t *frame = NULL;
+    int rc = oni_create_frame(ctx, &frame, OUT_DEV, data, sizeof(data));
+    assert(rc >= 0);
+    rc = oni_schedule_frame(ctx, frame, time);
+    assert(rc == ONI_ESUCCESS);
+}
+
+static void *produce(void *arg)
+{
+    struct producer *p = arg;
+    long i;
+    for (i = 0; i < p->num_frames; i++) {
+        oni_sched_stats_t stats = sched_stats(p->ctx);
+        schedule(p->ctx, stats.time + MARGIN + rand_r(&p->seed) % WINDOW);
+    }
+
+    return NULL;
+}
+
+// Schedules frames one at a time and returns the number released outside of
+// [target - LEAD, target - LEAD + MAX_AHEAD]
+static int test_timing(oni_ctx ctx)
+{
+    int failed = 0;
+    uint64_t max_error = 0;
+    int i;
+
+    for (i = 0; i < NUM_TIMED; i++) {
+
+        uint64_t before = last_write_time(ctx);
+        oni_fifo_time_t target = read_time(ctx) + TIMED_GAP;
+        schedule(ctx, target);
+
+        // NB: The test driver records the time of the next frame it produces
+        oni_fifo_time_t time;
+        uint64_t written;
+        do {
+            time = read_time(ctx);
+            written = last_write_time(ctx);
+        } while (written == before && time < target + TIMED_GAP);
+
+        if (written == before || written - 1 < target - LEAD
+            || written - 1 > target - LEAD + MAX_AHEAD) {
+            printf("Frame for %lu written at %lu (lead %d)\n",
+                   (unsigned long)target, (unsigned long)written - 1, LEAD);
+            failed++;
+        } else if (written - 1 - (target - LEAD) > max_error) {
+            max_error = written - 1 - (target - LEAD);
+        }
+    }
+
+    oni_sched_stats_t stats = sched_stats(ctx);
+    printf("%-12s released %-9lu late %-6lu failed %-6lu pending %-6u max written after target - lead %lu ticks\n",
+           "one at a time",
+           (unsigned long)stats.released,
+           (unsigned long)stats.late,
+           (unsigned long)stats.failed,
+           stats.pending,
+           (unsigned long)max_error);
+
+    if (stats.released != NUM_TIMED || stats.late != 0 || stats.failed != 0
+        || stats.pending != 0 || stats.max_pending != 1)
+        failed++;
+
+    // A frame whose time has passed is released on the next read and is late
+    schedule(ctx, 0);
+    read_time(ctx);
+    stats = sched_stats(ctx);
+    if (stats.released != NUM_TIMED + 1 || stats.late != 1)
+        failed++;
+
+    return failed;
+}
+
+// Schedules frames from several threads while reading and returns non-zero if
+// the statistics do not account for all of them. NB: A producer that is
+// preempted for longer than MARGIN ticks schedules a late frame, so late frames
+// are reported but not counted as a failure.
+static int test_producers(oni_ctx ctx, long frames_per_producer)
+{
+    oni_sched_stats_t before = sched_stats(ctx);
+
+    struct producer producers[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+    int i;
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        producers[i] = (struct producer){ctx, frames_per_producer, i + 1};
+        int rc = pthread_create(&threads[i], NULL, produce, &producers[i]);
+        assert(rc == 0);
+    }
+
+    uint64_t total = NUM_PRODUCERS * frames_per_producer;
+    oni_sched_stats_t stats;
+    do {
+        read_time(ctx);
+        stats = sched_stats(ctx);
+    } while (stats.released - before.released < total);
+
+    for (i = 0; i < NUM_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+
+    printf("%-12s released %-9lu late %-6lu failed %-6lu pending %-6u max pending %u\n",
+           "producers",
+           (unsigned long)(stats.released - before.released),
+           (unsigned long)(stats.late - before.late),
+           (unsigned long)(stats.failed - before.failed),
+           stats.pending,
+           stats.max_pending);
+
+    return stats.released - before.released != total
+           || stats.failed != before.failed || stats.pending != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long frames_per_producer = argc > 1 ? atol(argv[1]) : 100000;
+
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t block_read_size = BLOCK_READ_SIZE;
+    rc = oni_set_opt(ctx, ONI_OPT_BLOCKREADSIZE, &block_read_size, sizeof(block_read_size));
+    assert(rc == ONI_ESUCCESS);
+
+    uint64_t lead = LEAD;
+    rc = oni_set_opt(ctx, ONI_OPT_SCHEDLEAD, &lead, sizeof(lead));
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t run = 1;
+    rc = oni_set_opt(ctx, ONI_OPT_RUNNING, &run, sizeof(run));
+    assert(rc == ONI_ESUCCESS);
+
+    printf("%d frames scheduled one at a time, then %d producers scheduling %ld frames each\n",
+           NUM_TIMED, NUM_PRODUCERS, frames_per_producer);
+
+    int failed = test_timing(ctx);
+    failed |= test_producers(ctx, frames_per_producer);
+
+    oni_destroy_ctx(ctx);
+
+    printf(failed ? "Failed.\n" : "Success.\n");
+
+    return failed != 0;
+}
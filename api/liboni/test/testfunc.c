@@ -2,35 +2,6 @@
 #include <stddef.h>
 
 #include "testfunc.h"
-#include "../onidefs.h"
-
-#define FINISHBLOCK(X) (*code_ptr = (X), code_ptr = dst++, code = 0x01)
-
-int cobs_stuff(uint8_t *dst, const uint8_t *src, size_t size)
-{
-    // Maximal payload size is is 254 bytes.
-    if (size > 254)
-        return ONI_ECOBSPACK;
-
-    const uint8_t *end = src + size;
-    uint8_t *code_ptr = dst++; // First value is len of packet
-    uint8_t code = 0x01;
-
-    while (src < end) {
-        if (*src == 0) // Encoding required
-            FINISHBLOCK(code);
-        else { // No encoding required
-            *dst++ = *src;
-            if (++code == 0xFF) //Data exceeds 254 byte len
-                return ONI_ECOBSPACK;
-        }
-        src++;
-    }
-
-    FINISHBLOCK(code);
-
-    return ONI_ESUCCESS;
-}
 
 // Normal distribution
 double randn(double mu, double sigma)
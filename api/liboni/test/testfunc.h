@@ -4,7 +4,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-int cobs_stuff(uint8_t *dst, const uint8_t *src, size_t size);
 double randn(double mu, double sigma);
 
 #ifdef _WIN32
@@ -0,0 +1,188 @@
+// Creates and queues write frames from several producer threads at once under
+// each asynchronous writer policy and checks that no frame is corrupted by
+// another producer and that every frame is accounted for by the writer's
+// statistics. The test driver must be discoverable by the driver loader (e.g.
+// installed or on LD_LIBRARY_PATH).
+//
+// Usage: writer-test [frames_per_producer]
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testfunc.h"
+#include "../oni.h"
+
+#define NUM_PRODUCERS 4
+
+// Frames created before any of them is queued, so that frames of different
+// producers are live at the same time
+#define BATCH_SIZE 16
+
+// Small queue so that it fills up and each policy applies
+#define WRITER_DEPTH 16
+
+// Device written to and its write size
+#define OUT_DEV 0
+#define WRITE_SIZE 32
+
+static const char *policy_names[] = {"block", "drop oldest", "fail"};
+
+struct producer {
+    oni_ctx ctx;
+    uint64_t id;
+    long num_frames;
+    long queued;
+    long rejected;
+    long corrupt;
+};
+
+static void fill(uint64_t *data, uint64_t id, uint64_t seq)
+{
+    data[0] = id;
+    data[1] = seq;
+    data[2] = ~id;
+    data[3] = ~seq;
+}
+
+static void *produce(void *arg)
+{
+    struct producer *p = arg;
+    oni_frame_t *frames[BATCH_SIZE];
+    long seq = 0;
+
+    while (seq < p->num_frames) {
+
+        int n = 0;
+        for (; n < BATCH_SIZE && seq + n < p->num_frames; n++) {
+            uint64_t data[WRITE_SIZE / sizeof(uint64_t)];
+            fill(data, p->id, seq + n);
+            int rc = oni_create_frame(p->ctx, &frames[n], OUT_DEV, data, sizeof(data));
+            assert(rc >= 0);
+        }
+
+        // Frames created by other producers must not have overwritten these
+        int i;
+        for (i = 0; i < n; i++) {
+            uint64_t data[WRITE_SIZE / sizeof(uint64_t)];
+            fill(data, p->id, seq + i);
+            if (memcmp(frames[i]->data, data, sizeof(data)) != 0)
+                p->corrupt++;
+        }
+
+        for (i = 0; i < n; i++) {
+            int rc = oni_queue_frame(p->ctx, frames[i]);
+            if (rc == ONI_EQUEUEFULL) {
+                oni_destroy_frame(frames[i]);
+                p->rejected++;
+            } else {
+                assert(rc == ONI_ESUCCESS);
+                p->queued++;
+            }
+        }
+
+        seq += n;
+    }
+
+    return NULL;
+}
+
+// Runs the producers under policy and returns non-zero if a check failed
+static int run(int policy, long frames_per_producer)
+{
+    oni_ctx ctx = oni_create_ctx("test");
+    assert(ctx != NULL && "Could not create context with test driver.");
+
+    int rc = oni_init_ctx(ctx, 0);
+    assert(rc == ONI_ESUCCESS);
+
+    rc = oni_set_opt(ctx, ONI_OPT_WRITERPOLICY, &policy, sizeof(policy));
+    assert(rc == ONI_ESUCCESS);
+
+    oni_size_t depth = WRITER_DEPTH;
+    rc = oni_set_opt(ctx, ONI_OPT_WRITERDEPTH, &depth, sizeof(depth));
+    assert(rc == ONI_ESUCCESS);
+
+    struct producer producers[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+
+    timespec_t start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int i;
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        producers[i] = (struct producer){ctx, i, frames_per_producer, 0, 0, 0};
+        rc = pthread_create(&threads[i], NULL, produce, &producers[i]);
+        assert(rc == 0);
+    }
+
+    long queued = 0, rejected = 0, corrupt = 0;
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        queued += producers[i].queued;
+        rejected += producers[i].rejected;
+        corrupt += producers[i].corrupt;
+    }
+
+    // Wait for the writer to account for every queued frame
+    oni_writer_stats_t stats;
+    do {
+        size_t len = sizeof(stats);
+        rc = oni_get_opt(ctx, ONI_OPT_WRITERSTATS, &stats, &len);
+        assert(rc == ONI_ESUCCESS);
+    } while (stats.written + stats.dropped + stats.failed < (uint64_t)queued);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    timespec_t dt = timediff(start, end);
+    double secs = dt.tv_sec + dt.tv_nsec / 1e9;
+
+    printf("%-12s queued %-9ld rejected %-9ld written %-9lu dropped %-9lu failed %-6lu corrupt %-6ld %.2f Mframes/s\n",
+           policy_names[policy],
+           queued,
+           rejected,
+           (unsigned long)stats.written,
+           (unsigned long)stats.dropped,
+           (unsigned long)stats.failed,
+           corrupt,
+           (double)NUM_PRODUCERS * frames_per_producer / secs / 1e6);
+
+    int failed = corrupt != 0 || stats.failed != 0
+                 || stats.written + stats.dropped != (uint64_t)queued
+                 || queued + rejected != NUM_PRODUCERS * frames_per_producer;
+
+    // Each policy only loses frames in its own way
+    switch (policy) {
+        case ONI_WRITER_BLOCK:
+            failed |= rejected != 0 || stats.dropped != 0;
+            break;
+        case ONI_WRITER_DROPOLDEST:
+            failed |= rejected != 0;
+            break;
+        case ONI_WRITER_FAIL:
+            failed |= stats.dropped != 0;
+            break;
+    }
+
+    oni_destroy_ctx(ctx);
+
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    long frames_per_producer = argc > 1 ? atol(argv[1]) : 100000;
+
+    printf("%d producers, %ld frames each, writer queue depth %d\n",
+           NUM_PRODUCERS, frames_per_producer, WRITER_DEPTH);
+
+    int failed = 0;
+    failed |= run(ONI_WRITER_BLOCK, frames_per_producer);
+    failed |= run(ONI_WRITER_DROPOLDEST, frames_per_producer);
+    failed |= run(ONI_WRITER_FAIL, frames_per_producer);
+
+    printf(failed ? "Failed.\n" : "Success.\n");
+
+    return failed;
+}